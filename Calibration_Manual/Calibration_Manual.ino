@@ -41,7 +41,7 @@
 // PCA9685
 #define PCA1_ADRESS 0x40
 #define PCA2_ADRESS 0x41
-#define PWM_CHANNELS_PER_DRIVER 15
+#define PWM_CHANNELS_PER_DRIVER 16  // Même répartition que les sketches : servos 0-15 sur PCA1, 16-31 sur PCA2
 
 // Servos
 #define SERVO_MIN_ANGLE 0
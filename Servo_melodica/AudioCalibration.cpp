@@ -110,6 +110,7 @@ uint16_t AudioCalibration::testServoAngle(uint8_t servoNum, uint16_t angle) {
 
   // Trigger note (position fixe, pas de vélocité)
   servoController.noteOn(servoNum);
+  servoController.flush();
 
   // Wait for sound to develop
   delay(150);
@@ -119,6 +120,7 @@ uint16_t AudioCalibration::testServoAngle(uint8_t servoNum, uint16_t angle) {
 
   // Stop note
   servoController.noteOff(servoNum);
+  servoController.flush();
 
   // Wait for sound to decay
   delay(200);
@@ -202,8 +204,10 @@ bool AudioCalibration::calibrateServo(uint8_t servoNum) {
   Serial.println("\nTesting final calibration...");
   delay(500);
   servoController.noteOn(servoNum);
+  servoController.flush();
   delay(1000);
   servoController.noteOff(servoNum);
+  servoController.flush();
   delay(500);
 
   Serial.println("Calibration complete!");
@@ -0,0 +1,96 @@
+#include "DinMidiInput.h"
+
+static volatile uint16_t rxOverflowCount = 0;
+static volatile uint8_t rxHighWaterMark = 0;
+
+#if defined(UCSR1B)
+// Written by the RX interrupt (head) and read by the loop (tail), free-running 8-bit indices
+static volatile uint8_t rxBuffer[DIN_RX_BUFFER_SIZE];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+#endif
+
+#if DIN_MIDI_ENABLED && defined(UCSR1B)
+static inline void storeByte(uint8_t data) {
+  uint8_t h = rxHead;
+  uint8_t used = (uint8_t)(h - rxTail);
+
+  if (used >= DIN_RX_BUFFER_SIZE) {
+    rxOverflowCount++;
+    return;
+  }
+
+  rxBuffer[h & (DIN_RX_BUFFER_SIZE - 1)] = data;
+  rxHead = h + 1;
+
+  if (used + 1 > rxHighWaterMark) {
+    rxHighWaterMark = used + 1;
+  }
+}
+
+// ATmega32u4 USART1: status must be read before UDR1, which clears the error flags
+ISR(USART1_RX_vect) {
+  uint8_t status = UCSR1A;
+  uint8_t data = UDR1;
+
+  if (status & (1 << DOR1)) {
+    rxOverflowCount++; // byte lost in the hardware before this one
+  }
+  if (status & (1 << FE1)) {
+    return; // noise or unplugged cable, not a MIDI byte
+  }
+  storeByte(data);
+}
+#endif
+
+void DinMidiInput::begin() {
+#if defined(UCSR1B)
+  pinMode(0, INPUT_PULLUP); // RX au repos (niveau haut) sans câble branché
+
+  uint16_t ubrr = (F_CPU / 16UL / DIN_MIDI_BAUD) - 1; // 16 MHz : 31, 31250 bauds exacts
+  UBRR1H = ubrr >> 8;
+  UBRR1L = ubrr & 0xFF;
+  UCSR1A = 0;
+  UCSR1C = (1 << UCSZ11) | (1 << UCSZ10);  // 8N1
+  UCSR1B = (1 << RXEN1) | (1 << RXCIE1);   // receive only, interrupt per byte
+#else
+  Serial1.begin(DIN_MIDI_BAUD); // Autres cartes : file de réception du core, vidée par read()
+#endif
+}
+
+bool DinMidiInput::read(uint8_t& data) {
+#if defined(UCSR1B)
+  uint8_t t = rxTail;
+  if (t == rxHead) {
+    return false;
+  }
+
+  data = rxBuffer[t & (DIN_RX_BUFFER_SIZE - 1)];
+  rxTail = t + 1;
+  return true;
+#else
+  if (Serial1.available() <= 0) {
+    return false;
+  }
+  data = Serial1.read();
+  return true;
+#endif
+}
+
+uint16_t DinMidiInput::getOverflowCount() {
+  noInterrupts();
+  uint16_t count = rxOverflowCount; // 16-bit read, not atomic on AVR
+  interrupts();
+  return count;
+}
+
+uint8_t DinMidiInput::getHighWaterMark() {
+  return rxHighWaterMark;
+}
+
+void DinMidiInput::resetStats() {
+  noInterrupts();
+  rxOverflowCount = 0;
+  rxHighWaterMark = 0;
+  interrupts();
+}
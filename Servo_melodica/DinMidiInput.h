@@ -0,0 +1,37 @@
+#ifndef DINMIDIINPUT_H
+#define DINMIDIINPUT_H
+
+#include <Arduino.h>
+#include "settings.h"
+/***********************************************************************************************
+----------------------------    DinMidiInput.h   ----------------------------------------
+************************************************************************************************
+
+Réception MIDI DIN 5 broches sur l'UART matériel (Serial1, RX = pin 0 du Leonardo)
+
+L'interruption de réception ne fait que déposer l'octet dans une file circulaire,
+MidiHandler::readMidi() la vide et passe les octets à MidiStreamParser.
+- 31250 bauds : un octet toutes les 320 µs, la file de DIN_RX_BUFFER_SIZE octets laisse
+  DIN_RX_BUFFER_SIZE x 320 µs à la boucle pour repasser (20 ms pour 64 octets)
+- plus long que ça à plein débit (sauvegarde de la calibration en EEPROM : jusqu'à ~0,8 s,
+  bloc SysEx : ~53 ms) : les octets en trop sont perdus et comptés (getOverflowCount) ;
+  un flux de notes ordinaire (quelques messages par 20 ms) passe, pas un flux continu
+- DIN_MIDI_ENABLED 0 par défaut : à mettre à 1 dans settings.h quand la prise est câblée
+- l'ISR remplace celle de Serial1 : ne pas utiliser Serial1 dans le sketch avec DIN_MIDI_ENABLED
+- un seul UART, une seule instance
+
+************************************************************************************************/
+
+static_assert((DIN_RX_BUFFER_SIZE & (DIN_RX_BUFFER_SIZE - 1)) == 0, "DIN_RX_BUFFER_SIZE must be a power of 2");
+static_assert(DIN_RX_BUFFER_SIZE <= 128, "DIN_RX_BUFFER_SIZE must fit 8-bit indices");
+
+class DinMidiInput {
+public:
+  void begin();                // Configure l'UART et active l'interruption de réception
+  bool read(uint8_t& data);    // Consumer side, false if no byte waiting
+  uint16_t getOverflowCount(); // Bytes lost (ring full or UART overrun)
+  uint8_t getHighWaterMark();  // Max bytes waiting at once
+  void resetStats();
+};
+
+#endif // DINMIDIINPUT_H
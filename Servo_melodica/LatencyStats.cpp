@@ -0,0 +1,135 @@
+#include "LatencyStats.h"
+
+LatencyStats latencyStats;
+
+#if LATENCY_STATS
+
+static const char* const stageNames[LATENCY_STAGE_COUNT] = {"queue", "actuation", "total"};
+
+LatencyStats::LatencyStats() {
+  reset();
+}
+
+void LatencyStats::record(uint8_t transport, uint8_t stage, uint16_t ticks) {
+  if (transport >= LATENCY_TRANSPORT_COUNT) {
+    return;
+  }
+  LatencyHistogram::add(counts[transport][stage], (uint32_t)ticks << LATENCY_TICK_SHIFT);
+}
+
+void LatencyStats::dispatch(uint8_t transport, uint16_t received) {
+  current.received = received;
+  current.dispatched = now();
+  current.transport = transport;
+  dispatching = true;
+  record(transport, LATENCY_QUEUE, current.dispatched - received);
+}
+
+void LatencyStats::resume(const LatencyReceipt& receipt) {
+  current = receipt;
+  current.dispatched = now(); // Intentional wait (air, fixed delay) counted in the total only
+  dispatching = true;
+}
+
+void LatencyStats::release() {
+  dispatching = false;
+}
+
+const LatencyReceipt& LatencyStats::receipt() {
+  return current;
+}
+
+void LatencyStats::keyCommanded() {
+  if (!dispatching) {
+    return; // Homing, release overshoot, allNotesOff...: not a MIDI event
+  }
+  if (pendingCount >= LATENCY_PENDING_WRITES) {
+    missedWrites++;
+    return;
+  }
+  pending[pendingCount++] = current;
+}
+
+void LatencyStats::busWritten() {
+  if (pendingCount == 0) {
+    return;
+  }
+  uint16_t written = now();
+  for (uint8_t i = 0; i < pendingCount; i++) {
+    record(pending[i].transport, LATENCY_ACTUATION, written - pending[i].dispatched);
+    record(pending[i].transport, LATENCY_TOTAL, written - pending[i].received);
+  }
+  pendingCount = 0;
+}
+
+uint16_t LatencyStats::getCount(uint8_t transport, uint8_t stage, uint8_t bucket) {
+  return counts[transport][stage][bucket];
+}
+
+uint8_t LatencyStats::percentileBucket(uint8_t transport, uint8_t stage, uint16_t permille) {
+  return LatencyHistogram::percentile(counts[transport][stage], permille);
+}
+
+uint16_t LatencyStats::getMissedWrites() {
+  return missedWrites;
+}
+
+void LatencyStats::reset() {
+  memset(counts, 0, sizeof(counts));
+  dispatching = false;
+  pendingCount = 0;
+  missedWrites = 0;
+}
+
+void LatencyStats::print(Print& out) {
+  for (uint8_t t = 0; t < LATENCY_TRANSPORT_COUNT; t++) {
+    for (uint8_t s = 0; s < LATENCY_STAGE_COUNT; s++) {
+      uint32_t total = LatencyHistogram::total(counts[t][s]);
+      if (total == 0) {
+        continue;
+      }
+      out.print(latencyTransportNames[t]);
+      out.print(' ');
+      out.print(stageNames[s]);
+      out.print(": n ");
+      out.print(total);
+      out.print(" p50 ");
+      LatencyHistogram::printBucket(out, percentileBucket(t, s, 500));
+      out.print(" p99 ");
+      LatencyHistogram::printBucket(out, percentileBucket(t, s, 990));
+      out.print(" us |");
+      for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+        out.print(' ');
+        out.print(counts[t][s][b]);
+      }
+      out.println();
+    }
+  }
+  out.print("buckets <");
+  out.print(LatencyHistogram::edge(0));
+  out.print(" us, x2 each, last ");
+  LatencyHistogram::printBucket(out, LATENCY_BUCKETS - 1);
+  out.print(" us; missed writes ");
+  out.println(missedWrites);
+}
+
+uint16_t LatencyStats::imageSize() {
+  return 4 + sizeof(counts);
+}
+
+uint8_t LatencyStats::readImage(uint16_t offset) {
+  switch (offset) {
+    case 0: return LATENCY_TRANSPORT_COUNT;
+    case 1: return LATENCY_STAGE_COUNT;
+    case 2: return LATENCY_BUCKETS;
+    case 3: return LATENCY_FIRST_BUCKET_SHIFT;
+  }
+  offset -= 4;
+  if (offset >= sizeof(counts)) {
+    return 0;
+  }
+  uint16_t count = (&counts[0][0][0])[offset / 2];
+  return (offset & 1) ? count >> 8 : count & 0xFF;
+}
+
+#endif // LATENCY_STATS
@@ -0,0 +1,103 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <Arduino.h>
+#include "settings.h"
+#include "LogHistogram.h"
+/***********************************************************************************************
+----------------------------    LatencyStats.h   ----------------------------------------
+************************************************************************************************
+
+Histogrammes de latence des notes, de la lecture MIDI à l'écriture I2C de la touche
+
+Trois instants par événement :
+- réception : MidiEventRing::push(), appelé par le lecteur du transport (USB, DIN, BLE, RTP)
+- dispatch  : sortie de la file dans Instrument::update() (ou échéance d'une note planifiée)
+- écriture  : touche sur le bus (fin du flush de ServoController, setPWM() sur ESP32)
+Trois histogrammes par transport : réception -> dispatch, dispatch -> écriture, réception ->
+écriture. Seaux fixes en µs : < 256, puis un seau par doublement, le dernier sans limite.
+- horodatage en 16 µs sur 16 bits : une note attend au plus ~1 s (au-delà, valeur fausse)
+- compteurs 16 bits bloqués à 65535 jusqu'à la remise à zéro
+- histogrammes mis à jour par le seul consommateur des files (boucle, ou tâche des servos sur
+  ESP32), jamais en interruption ; un reset() depuis une autre tâche peut perdre un échantillon
+- LATENCY_STATS 0 : classe vide, appels supprimés à la compilation, événements inchangés
+Lecture : print() (commande série 'l'), ou image binaire pour SysEx (Leonardo, table 1)
+
+************************************************************************************************/
+
+#define LATENCY_BUCKETS 12
+#define LATENCY_FIRST_BUCKET_SHIFT 8  // First bucket: below 1 << 8 = 256 µs
+#define LATENCY_TICK_SHIFT 4          // Timestamps in micros() >> 4
+
+typedef LogHistogram<LATENCY_BUCKETS, LATENCY_FIRST_BUCKET_SHIFT> LatencyHistogram;
+
+enum LatencyStage : uint8_t {
+  LATENCY_QUEUE,      // Réception -> dispatch
+  LATENCY_ACTUATION,  // Dispatch -> écriture sur le bus
+  LATENCY_TOTAL,      // Réception -> écriture sur le bus
+  LATENCY_STAGE_COUNT
+};
+
+// Où en est un événement : copié dans les notes planifiées
+struct LatencyReceipt {
+  uint16_t received;     // LatencyStats::now() at reception
+  uint16_t dispatched;   // LatencyStats::now() when the instrument handled it
+  uint8_t transport;     // LATENCY_TRANSPORT_...
+};
+
+#if LATENCY_STATS
+
+class LatencyStats {
+private:
+  uint16_t counts[LATENCY_TRANSPORT_COUNT][LATENCY_STAGE_COUNT][LATENCY_BUCKETS];
+  LatencyReceipt current;               // Event being handled by an instrument
+  bool dispatching;
+  LatencyReceipt pending[LATENCY_PENDING_WRITES]; // Key writes waiting for the flush
+  uint8_t pendingCount;
+  uint16_t missedWrites;                // Key writes not recorded (pending full)
+  void record(uint8_t transport, uint8_t stage, uint16_t ticks);
+
+public:
+  LatencyStats();
+  static uint16_t now() { return (uint16_t)(micros() >> LATENCY_TICK_SHIFT); }
+  void dispatch(uint8_t transport, uint16_t received); // Sortie de la file : échantillon réception -> dispatch
+  void resume(const LatencyReceipt& receipt);          // Note planifiée échue : mêmes instants, pas d'échantillon
+  void release();                                      // Fin du traitement de l'événement
+  const LatencyReceipt& receipt();                     // Événement en cours, pour NoteScheduler
+  void keyCommanded();                                 // Touche commandée par l'événement en cours
+  void busWritten();                                   // Flush terminé : touches commandées écrites
+
+  uint16_t getCount(uint8_t transport, uint8_t stage, uint8_t bucket);
+  uint8_t percentileBucket(uint8_t transport, uint8_t stage, uint16_t permille); // LOG_HISTOGRAM_NO_BUCKET if empty
+  uint16_t getMissedWrites();
+  void reset();
+  void print(Print& out);
+
+  // Image for SysEx: transport count, stage count, bucket count, first bucket shift,
+  // then the counts (16 bits, little-endian) by transport, stage, bucket
+  uint16_t imageSize();
+  uint8_t readImage(uint16_t offset);
+};
+
+#else
+
+class LatencyStats {
+public:
+  static uint16_t now() { return 0; }
+  void dispatch(uint8_t, uint16_t) {}
+  void resume(const LatencyReceipt&) {}
+  void release() {}
+  const LatencyReceipt& receipt() { static const LatencyReceipt none = {0, 0, 0}; return none; }
+  void keyCommanded() {}
+  void busWritten() {}
+  void reset() {}
+  void print(Print& out) { out.println("latency stats disabled (LATENCY_STATS 0)"); }
+  uint16_t imageSize() { return 0; }
+  uint8_t readImage(uint16_t) { return 0; }
+};
+
+#endif // LATENCY_STATS
+
+extern LatencyStats latencyStats; // Une seule instance, partagée par le transport, les instruments et le bus
+
+#endif // LATENCYSTATS_H
@@ -0,0 +1,77 @@
+#ifndef LOGHISTOGRAM_H
+#define LOGHISTOGRAM_H
+
+#include <Arduino.h>
+/***********************************************************************************************
+----------------------------    LogHistogram.h   ----------------------------------------
+************************************************************************************************
+
+Histogramme à seaux fixes par doublement, commun à LatencyStats et LoopProfiler
+
+- BUCKETS seaux : < 1 << FIRST_SHIFT, puis un seau par doublement, le dernier sans limite
+- les compteurs (16 bits, bloqués à 65535) restent dans la classe qui les utilise : ici
+  seulement le calcul du seau, le percentile et l'affichage d'une borne
+
+************************************************************************************************/
+
+#define LOG_HISTOGRAM_NO_BUCKET 0xFF
+
+template <uint8_t BUCKETS, uint8_t FIRST_SHIFT>
+struct LogHistogram {
+  static void add(uint16_t* counts, uint32_t value) {
+    uint32_t edge = 1UL << FIRST_SHIFT;
+    uint8_t bucket = 0;
+    while (bucket < BUCKETS - 1 && value >= edge) {
+      edge <<= 1;
+      bucket++;
+    }
+    if (counts[bucket] != 0xFFFF) {
+      counts[bucket]++;
+    }
+  }
+
+  static uint32_t total(const uint16_t* counts) {
+    uint32_t sum = 0;
+    for (uint8_t b = 0; b < BUCKETS; b++) {
+      sum += counts[b];
+    }
+    return sum;
+  }
+
+  // Smallest bucket holding at least permille / 1000 of the samples, LOG_HISTOGRAM_NO_BUCKET if empty
+  static uint8_t percentile(const uint16_t* counts, uint16_t permille) {
+    uint32_t samples = total(counts);
+    if (samples == 0) {
+      return LOG_HISTOGRAM_NO_BUCKET;
+    }
+    uint32_t rank = (samples * permille + 999) / 1000;
+    uint32_t seen = 0;
+    uint8_t b = 0;
+    while (b < BUCKETS - 1) {
+      seen += counts[b];
+      if (seen >= rank) {
+        break;
+      }
+      b++;
+    }
+    return b;
+  }
+
+  // Upper edge (µs), except the last bucket
+  static uint32_t edge(uint8_t bucket) {
+    return 1UL << (FIRST_SHIFT + bucket);
+  }
+
+  // "<edge", or ">=edge" for the last bucket
+  static void printBucket(Print& out, uint8_t bucket) {
+    if (bucket < BUCKETS - 1) {
+      out.print('<');
+      out.print(edge(bucket));
+    } else {
+      out.print(">=");
+      out.print(edge(bucket - 1));
+    }
+  }
+};
+
+#endif // LOGHISTOGRAM_H
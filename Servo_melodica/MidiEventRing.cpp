@@ -0,0 +1,63 @@
+#include "MidiEventRing.h"
+
+MidiEventRing::MidiEventRing() : head(0), tail(0), overflowCount(0), highWaterMark(0) {
+}
+
+bool MidiEventRing::push(uint8_t status, uint8_t data1, uint8_t data2, uint8_t transport) {
+  uint8_t h = head;
+  uint8_t used = (uint8_t)(h - tail);
+
+  if (used >= MIDI_RING_CAPACITY) {
+    overflowCount++;
+    return false;
+  }
+
+  MidiEvent& event = events[h & (MIDI_RING_CAPACITY - 1)];
+  event.status = status;
+  event.data1 = data1;
+  event.data2 = data2;
+  event.timestamp = (uint16_t)millis();
+#if LATENCY_STATS
+  event.transport = transport;
+  event.received = LatencyStats::now();
+#endif
+
+  MIDI_RING_BARRIER(); // event written before it is published
+  head = h + 1;
+
+  if (used + 1 > highWaterMark) {
+    highWaterMark = used + 1;
+  }
+  return true;
+}
+
+bool MidiEventRing::pop(MidiEvent& event) {
+  uint8_t t = tail;
+  if (t == head) {
+    return false;
+  }
+
+  MIDI_RING_BARRIER(); // head read before the event
+  event = events[t & (MIDI_RING_CAPACITY - 1)];
+
+  MIDI_RING_BARRIER(); // event copied before the slot is released
+  tail = t + 1;
+  return true;
+}
+
+uint8_t MidiEventRing::size() {
+  return (uint8_t)(head - tail);
+}
+
+uint16_t MidiEventRing::getOverflowCount() {
+  return overflowCount;
+}
+
+uint8_t MidiEventRing::getHighWaterMark() {
+  return highWaterMark;
+}
+
+void MidiEventRing::resetStats() {
+  overflowCount = 0;
+  highWaterMark = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef MIDIEVENTRING_H
+#define MIDIEVENTRING_H
+
+#include <Arduino.h>
+#include "settings.h"
+#include "LatencyStats.h"
+/***********************************************************************************************
+----------------------------    MidiEventRing.h   ----------------------------------------
+************************************************************************************************
+
+File circulaire sans verrou, un seul producteur / un seul consommateur
+
+Le transport MIDI (USB, BLE, WiFi) ne fait que déposer des événements de 5 octets,
+l'instrument les consomme dans update() et fait les écritures I2C.
+Taille fixe (puissance de 2), aucune allocation.
+- head n'est écrit que par le producteur, tail que par le consommateur
+- un événement n'est publié (head) qu'après avoir été entièrement écrit
+
+************************************************************************************************/
+
+#if defined(ARDUINO_ARCH_ESP32)
+#define MIDI_RING_BARRIER() __sync_synchronize()              // producteur et consommateur sur deux coeurs
+#else
+#define MIDI_RING_BARRIER() asm volatile("" ::: "memory")     // un seul coeur : barrière compilateur
+#endif
+
+static_assert((MIDI_RING_CAPACITY & (MIDI_RING_CAPACITY - 1)) == 0, "MIDI_RING_CAPACITY must be a power of 2");
+static_assert(MIDI_RING_CAPACITY <= 128, "MIDI_RING_CAPACITY must fit 8-bit indices");
+
+struct MidiEvent {
+  uint8_t status;     // Message type | channel (0x80, 0x90, 0xB0, 0xE0...)
+  uint8_t data1;      // Note / controller / pitch bend LSB
+  uint8_t data2;      // Velocity / value / pitch bend MSB
+  uint16_t timestamp; // millis() & 0xFFFF at reception (an EEPROM save or a homing can last > 256 ms)
+#if LATENCY_STATS
+  uint8_t transport;  // LATENCY_TRANSPORT_... of the reader that queued it
+  uint16_t received;  // LatencyStats::now() at reception
+#endif
+};
+
+class MidiEventRing {
+private:
+  MidiEvent events[MIDI_RING_CAPACITY];
+  volatile uint8_t head;            // Next slot to write (producer)
+  volatile uint8_t tail;            // Next slot to read (consumer)
+  volatile uint16_t overflowCount;  // Events dropped because the ring was full (producer)
+  volatile uint8_t highWaterMark;   // Max events waiting at once (producer)
+
+public:
+  MidiEventRing();
+  bool push(uint8_t status, uint8_t data1, uint8_t data2, uint8_t transport = 0); // Producer side, false if full
+  bool pop(MidiEvent& event);                              // Consumer side, false if empty
+  uint8_t size();
+  uint16_t getOverflowCount();
+  uint8_t getHighWaterMark();
+  void resetStats();
+};
+
+#endif // MIDIEVENTRING_H
@@ -1,9 +1,17 @@
  #include "midiHandler.h"
 
-MidiHandler::MidiHandler(Instrument &instrument) : _instrument(instrument) {
+MidiHandler::MidiHandler(Instrument* instruments[INSTRUMENT_COUNT], ServoController& servoController)
+  : _sysEx(servoController) {
   if (DEBUG) {
     Serial.println("DEBUG : midiHandler--creation");
   } 
+  for (uint8_t channel = 0; channel < 16; channel++) {
+    uint8_t target = channelInstrument[channel];
+    _channelRoutes[channel] = (target < INSTRUMENT_COUNT) ? instruments[target] : nullptr;
+  }
+  if (DIN_MIDI_ENABLED) {
+    _dinInput.begin();
+  }
 }
 
 void MidiHandler::readMidi() {
@@ -11,33 +19,39 @@ void MidiHandler::readMidi() {
   do {
     midiEvent = MidiUSB.read();
     if (midiEvent.header != 0) {
-      processMidiEvent(midiEvent);
+      processMidiEvent(midiEvent, LATENCY_TRANSPORT_USB);
     }
   } while (midiEvent.header != 0);
+
+  // Everything the RX interrupt queued since the last loop
+  if (DIN_MIDI_ENABLED) {
+    uint8_t value;
+    while (_dinInput.read(value)) {
+      if (_dinParser.parse(value, midiEvent)) {
+        processMidiEvent(midiEvent, LATENCY_TRANSPORT_DIN);
+      }
+    }
+  }
 }
 
-void MidiHandler::processMidiEvent(midiEventPacket_t midiEvent) {
+void MidiHandler::processMidiEvent(midiEventPacket_t midiEvent, uint8_t transport) {
+  uint8_t cin = midiEvent.header & 0x0F;
+  if (cin >= 0x4 && cin <= 0x7) { // SysEx start/continue/end (0x5 also carries 1-byte system common)
+    _sysEx.receive(midiEvent);
+    return;
+  }
+
   byte messageType = midiEvent.byte1 & 0xF0;
-  byte channel = midiEvent.byte1 & 0x0F;
-  byte note = midiEvent.byte2;
-  byte velocity = midiEvent.byte3;
+  Instrument* target = _channelRoutes[midiEvent.byte1 & 0x0F];
 
   switch (messageType) {
     case 0x90: // Note On
-      if (velocity > 0) {
-        _instrument.noteOn(note, velocity);
-      } else {
-        // Note Off
-        _instrument.noteOff(note);
-      }
-      break;
     case 0x80: // Note Off
-      _instrument.noteOff(note);
-      break;
+    case 0xB0: // Control Change
     case 0xE0: // Pitch Bend
-      {
-        int16_t pitchBendValue = ((midiEvent.byte3 << 7) | midiEvent.byte2) - 8192;
-        _instrument.pitchBend(pitchBendValue);
+      // Queued as is for the channel's instrument, decoded by Instrument::update()
+      if (target != nullptr) {
+        target->eventRing().push(midiEvent.byte1, midiEvent.byte2, midiEvent.byte3, transport);
       }
       break;
     case 0xA0: // Channel Pressure (Aftertouch)
@@ -48,9 +62,6 @@ void MidiHandler::processMidiEvent(midiEventPacket_t midiEvent) {
       // Polyphonic aftertouch
       // Not implemented for melodica
       break;
-    case 0xB0: // Control Change
-      processControlChange(note, velocity);
-      break;
     case 0xF0: // System Common or System Real-Time
       // Add logic for handling System Common and System Real-Time messages
       break;
@@ -60,38 +71,3 @@ void MidiHandler::processMidiEvent(midiEventPacket_t midiEvent) {
     // Add more cases as needed for other message types
   }
 }
-/*------------------------------------------------------------------
---------------        process Control Change             ----------
-------------------------------------------------------------------*/
-void MidiHandler::processControlChange(byte controller, byte value) {
-  // Handle Control Change messages
-  switch (controller) {
-    case 1:   // Modulation wheel
-    case 91:  // Reverb depth
-    case 92:  // Tremolo depth
-    case 94:  // Detune depth
-      _instrument.modulationWheel(value);
-      break;
-    case 0x07: // Volume (CC 7)
-      _instrument.volumeControl(value);
-      break;
-    case 121: // Reset all controllers
-      _instrument.reset();
-      break;
-    case 123: // All notes off
-      _instrument.allNotesOff();
-      break;
-    case 120: // All sound off (similar to all notes off)
-      _instrument.allNotesOff();
-      break;
-    // Add more cases as needed for other control changes
-    default:
-      if (DEBUG) {
-        Serial.print("Unhandled CC: ");
-        Serial.print(controller);
-        Serial.print(" Value: ");
-        Serial.println(value);
-      }
-      break;
-  }
-}
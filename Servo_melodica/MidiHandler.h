@@ -3,6 +3,9 @@
 
 #include <MIDIUSB.h>
 #include "instrument.h"
+#include "DinMidiInput.h"
+#include "MidiStreamParser.h"
+#include "SysExCalibration.h"
 /***********************************************************************************************
 ----------------------------    MIDI message handler    ----------------------------------------
 ************************************************************************************************
@@ -18,15 +21,21 @@ l'objectif est d'etre le plus complet au niveau de la selection des messages qui
 -Message de System Exclusive (SysEx) : Utilisé pour transmettre des données spécifiques au fabricant et aux modèles d'équipements MIDI. Ces messages peuvent être très variés et personnalisés.
 ------------------------------------------------------------------------------------------------
 Chaque fonction qui peut etre utilisé doit etre decommenté et déclaré dans instrument.h 
+Les messages de canal sont déposés dans la file de l'instrument du canal (channelInstrument,
+aucune écriture I2C ici), l'instrument les décode et les joue dans update()
+Avec DIN_MIDI_ENABLED, les octets reçus sur la prise DIN sont remis en paquets USB-MIDI
+par MidiStreamParser et suivent le même chemin
 ************************************************************************************************/
 
 class MidiHandler {
   private:
-    Instrument& _instrument;
-    void processMidiEvent(midiEventPacket_t midiEvent);
-    void processControlChange( byte controller, byte value);
+    Instrument* _channelRoutes[16]; // Instrument de chaque canal MIDI, nullptr = ignoré
+    DinMidiInput _dinInput;
+    MidiStreamParser _dinParser;
+    SysExCalibration _sysEx;        // Calibration dump/load, SysEx of both transports
+    void processMidiEvent(midiEventPacket_t midiEvent, uint8_t transport); // LATENCY_TRANSPORT_USB or _DIN
   public:
-    MidiHandler(Instrument &instrument);
+    MidiHandler(Instrument* instruments[INSTRUMENT_COUNT], ServoController& servoController);
     void readMidi();
 };
 
@@ -0,0 +1,109 @@
+#include "MidiStreamParser.h"
+
+MidiStreamParser::MidiStreamParser() {
+  reset();
+}
+
+void MidiStreamParser::reset() {
+  status = 0;
+  dataExpected = 0;
+  dataCount = 0;
+  inSysEx = false;
+  sysExCount = 0;
+}
+
+// Data bytes following a status byte
+static uint8_t dataLength(uint8_t status) {
+  switch (status & 0xF0) {
+    case 0xC0: // Program Change
+    case 0xD0: // Channel Pressure
+      return 1;
+    case 0xF0:
+      if (status == 0xF1 || status == 0xF3) { // MTC quarter frame, Song Select
+        return 1;
+      }
+      return (status == 0xF2) ? 2 : 0;      // Song Position, Tune Request
+    default:
+      return 2;
+  }
+}
+
+bool MidiStreamParser::parse(uint8_t value, midiEventPacket_t& packet) {
+  // Real-time: may appear anywhere, including between the bytes of another message
+  if (value >= 0xF8) {
+    packet = {0x0F, value, 0, 0};
+    return true;
+  }
+
+  if (value & 0x80) {
+    if (inSysEx) {
+      inSysEx = false;
+      if (value == 0xF7) {
+        sysExBytes[sysExCount++] = value;
+        packet = {(uint8_t)(0x04 + sysExCount), sysExBytes[0], 0, 0}; // CIN 0x5, 0x6 or 0x7
+        if (sysExCount > 1) {
+          packet.byte2 = sysExBytes[1];
+        }
+        if (sysExCount > 2) {
+          packet.byte3 = sysExBytes[2];
+        }
+        sysExCount = 0;
+        return true;
+      }
+      sysExCount = 0; // Unterminated SysEx dropped, the new status is handled below
+    }
+
+    dataCount = 0;
+    if (value == 0xF0) {
+      status = 0;
+      inSysEx = true;
+      sysExBytes[0] = value;
+      sysExCount = 1;
+      return false;
+    }
+    if (value == 0xF7 || value == 0xF4 || value == 0xF5) {
+      status = 0; // Stray end of SysEx or undefined status
+      return false;
+    }
+
+    status = value;
+    dataExpected = dataLength(value);
+    if (dataExpected == 0) { // Tune Request
+      status = 0;
+      packet = {0x05, value, 0, 0};
+      return true;
+    }
+    return false;
+  }
+
+  // Data byte
+  if (inSysEx) {
+    sysExBytes[sysExCount++] = value;
+    if (sysExCount < 3) {
+      return false;
+    }
+    packet = {0x04, sysExBytes[0], sysExBytes[1], sysExBytes[2]};
+    sysExCount = 0;
+    return true;
+  }
+  if (status == 0) {
+    return false; // No status to run on (power-up, cable plugged mid-message)
+  }
+
+  data[dataCount++] = value;
+  if (dataCount < dataExpected) {
+    return false;
+  }
+
+  if (status >= 0xF0) {
+    packet = {(uint8_t)(dataExpected + 1), status, data[0], 0}; // CIN 0x2 or 0x3
+    status = 0;                                                  // System common: no running status
+  } else {
+    packet = {(uint8_t)(status >> 4), status, data[0], 0};
+  }
+  if (dataExpected == 2) {
+    packet.byte3 = data[1];
+  }
+  dataCount = 0;
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef MIDISTREAMPARSER_H
+#define MIDISTREAMPARSER_H
+
+#include <MIDIUSB.h>
+/***********************************************************************************************
+----------------------------    MidiStreamParser.h   ----------------------------------------
+************************************************************************************************
+
+Découpe un flux MIDI octet par octet (DIN, série) en paquets USB-MIDI de 4 octets,
+les mêmes que MidiUSB.read() : MidiHandler les traite sans savoir d'où ils viennent.
+- running status : les octets de données sans statut réutilisent le dernier statut de canal
+- temps réel (0xF8-0xFF) : un paquet immédiat, même au milieu d'un message ou d'un SysEx,
+  sans toucher au message en cours
+- system common (0xF1-0xF6) et SysEx annulent le running status
+- SysEx : paquets de 3 octets CIN 0x4, le dernier en CIN 0x5/0x6/0x7 avec le 0xF7 ;
+  un statut reçu avant le 0xF7 termine le SysEx sans paquet de fin
+- au plus un paquet par octet reçu
+
+************************************************************************************************/
+
+class MidiStreamParser {
+private:
+  uint8_t status;        // Message being assembled, kept after a channel message (running status)
+  uint8_t dataExpected;  // Data bytes of this status (0, 1 or 2)
+  uint8_t dataCount;     // Data bytes received so far
+  uint8_t data[2];
+  bool inSysEx;
+  uint8_t sysExBytes[3]; // Pending SysEx bytes, sent 3 at a time
+  uint8_t sysExCount;
+
+public:
+  MidiStreamParser();
+  bool parse(uint8_t value, midiEventPacket_t& packet); // true when packet holds a complete message
+  void reset();
+};
+
+#endif // MIDISTREAMPARSER_H
@@ -0,0 +1,9 @@
+#include "NoteRouting.h"
+
+#define ROUTE_4(n) routeNote(n), routeNote(n + 1), routeNote(n + 2), routeNote(n + 3)
+#define ROUTE_16(n) ROUTE_4(n), ROUTE_4(n + 4), ROUTE_4(n + 8), ROUTE_4(n + 12)
+
+const uint8_t noteRouting[128] PROGMEM = {
+  ROUTE_16(0), ROUTE_16(16), ROUTE_16(32), ROUTE_16(48),
+  ROUTE_16(64), ROUTE_16(80), ROUTE_16(96), ROUTE_16(112)
+};
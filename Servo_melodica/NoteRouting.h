@@ -0,0 +1,52 @@
+#ifndef NOTEROUTING_H
+#define NOTEROUTING_H
+
+#include <Arduino.h>
+#include "settings.h"
+/***********************************************************************************************
+----------------------------    NoteRouting.h   ----------------------------------------
+************************************************************************************************
+
+Table note MIDI -> servo générée à la compilation depuis settings.h
+(FIRST_MIDI_NOTE, TRANSPOSE, OCTAVE_FOLDING, keyLayout)
+
+Une entrée par note MIDI, NO_SERVO si la note ne peut pas être jouée :
+la recherche est une simple lecture indexée en flash.
+
+************************************************************************************************/
+
+static_assert(NUMBER_OF_KEYS >= 12 || !OCTAVE_FOLDING, "OCTAVE_FOLDING needs at least one octave of keys");
+
+// Touche jouée pour une position relative à FIRST_MIDI_NOTE, -1 si hors tessiture
+constexpr int foldKey(int key) {
+  return (key >= 0 && key < NUMBER_OF_KEYS) ? key
+       : !OCTAVE_FOLDING ? -1
+       : (key < 0) ? foldKey(key + 12)
+       : foldKey(key - 12);
+}
+
+constexpr uint8_t keyServo(int key) {
+  return key < 0 ? NO_SERVO : keyLayout[key];
+}
+
+constexpr uint8_t routeNote(int midiNote) {
+  return keyServo(foldKey(midiNote + TRANSPOSE - FIRST_MIDI_NOTE));
+}
+
+// keyLayout check: every servo exists and drives a single key
+constexpr bool layoutServoUsedAfter(int key, int other) {
+  return other < NUMBER_OF_KEYS
+       && ((keyLayout[other] == keyLayout[key] && keyLayout[key] != NO_SERVO) || layoutServoUsedAfter(key, other + 1));
+}
+
+constexpr bool layoutValidFrom(int key) {
+  return key >= NUMBER_OF_KEYS
+       || ((keyLayout[key] < NUMBER_OF_NOTES || keyLayout[key] == NO_SERVO)
+           && !layoutServoUsedAfter(key, key + 1) && layoutValidFrom(key + 1));
+}
+
+static_assert(layoutValidFrom(0), "keyLayout: servo out of range or used by two keys");
+
+extern const uint8_t noteRouting[128] PROGMEM;
+
+#endif // NOTEROUTING_H
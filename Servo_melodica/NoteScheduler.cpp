@@ -0,0 +1,78 @@
+#include "NoteScheduler.h"
+
+NoteScheduler::NoteScheduler() : count(0), overflowCount(0) {
+}
+
+bool NoteScheduler::schedule(unsigned long fireTime, uint8_t servo, uint8_t velocity) {
+  if (count >= SCHEDULER_CAPACITY) {
+    overflowCount++;
+    return false;
+  }
+
+  // Insert after every event due at or before fireTime (keeps on/off order for a key)
+  uint8_t pos = count;
+  while (pos > 0 && (long)(events[pos - 1].fireTime - fireTime) > 0) {
+    events[pos] = events[pos - 1];
+    pos--;
+  }
+
+  events[pos].fireTime = fireTime;
+  events[pos].servo = servo;
+  events[pos].velocity = velocity;
+#if LATENCY_STATS
+  events[pos].latency = latencyStats.receipt(); // Scheduled while its MIDI event is handled
+#endif
+  count++;
+  return true;
+}
+
+bool NoteScheduler::hasPending(uint8_t servo) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (events[i].servo == servo) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool NoteScheduler::cancelPress(uint8_t servo) {
+  // Only the latest event of the key: an earlier press keeps its own release
+  uint8_t i = count;
+  while (i > 0 && events[i - 1].servo != servo) {
+    i--;
+  }
+  if (i == 0 || events[i - 1].velocity == 0) {
+    return false;
+  }
+
+  count--;
+  for (i = i - 1; i < count; i++) {
+    events[i] = events[i + 1];
+  }
+  return true;
+}
+
+bool NoteScheduler::popDue(unsigned long now, ScheduledNote& event) {
+  if (count == 0 || (long)(now - events[0].fireTime) < 0) {
+    return false;
+  }
+
+  event = events[0];
+  count--;
+  for (uint8_t i = 0; i < count; i++) {
+    events[i] = events[i + 1];
+  }
+  return true;
+}
+
+void NoteScheduler::clear() {
+  count = 0;
+}
+
+uint8_t NoteScheduler::size() {
+  return count;
+}
+
+uint16_t NoteScheduler::getOverflowCount() {
+  return overflowCount;
+}
@@ -0,0 +1,45 @@
+#ifndef NOTESCHEDULER_H
+#define NOTESCHEDULER_H
+
+#include <Arduino.h>
+#include "settings.h"
+#include "LatencyStats.h"
+/***********************************************************************************************
+----------------------------    NoteScheduler.h   ----------------------------------------
+************************************************************************************************
+
+File d'attente des noteOn/noteOff datés (mode délai fixe)
+
+Chaque événement est rangé par instant de déclenchement (ordre stable pour des instants égaux),
+l'instrument vide les événements échus dans update() sans jamais bloquer.
+Taille fixe, pas d'allocation dynamique.
+
+************************************************************************************************/
+
+struct ScheduledNote {
+  unsigned long fireTime;   // millis() at which the servo must be commanded
+  uint8_t servo;            // Servo number
+  uint8_t velocity;         // Scaled velocity, 0 = note off
+#if LATENCY_STATS
+  LatencyReceipt latency;   // Reception of the MIDI event, for the latency histograms
+#endif
+};
+
+class NoteScheduler {
+private:
+  ScheduledNote events[SCHEDULER_CAPACITY];  // Sorted by fireTime
+  uint8_t count;
+  uint16_t overflowCount;   // Events refused because the queue was full
+
+public:
+  NoteScheduler();
+  bool schedule(unsigned long fireTime, uint8_t servo, uint8_t velocity); // false if full
+  bool hasPending(uint8_t servo);   // An event is still queued for this servo
+  bool cancelPress(uint8_t servo);  // Drops the servo's last queued event if it is a press
+  bool popDue(unsigned long now, ScheduledNote& event); // Oldest due event, false if none
+  void clear();
+  uint8_t size();
+  uint16_t getOverflowCount();
+};
+
+#endif // NOTESCHEDULER_H
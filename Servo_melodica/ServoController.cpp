@@ -1,9 +1,66 @@
 #include "ServoController.h"
 #include "settings.h"
+#include "LatencyStats.h"
 
-ServoController::ServoController() : isInitialized(false) {
-  pwm1 = Adafruit_PWMServoDriver(PCA1_ADRESS);
-  pwm2 = Adafruit_PWMServoDriver(PCA2_ADRESS);
+// Servo -> PCA9685 slot (board * PCA_CHANNEL_COUNT + channel), generated at compile time:
+// servo n takes the n-th slot, in board order, that is not an air valve channel
+constexpr bool airSlot(int slot, int instrument) {
+  return AIR_ON_PCA && instrument < INSTRUMENT_COUNT
+      && (AIR_PCA_BOARD * PCA_CHANNEL_COUNT + instrumentAirChannel[instrument] == slot || airSlot(slot, instrument + 1));
+}
+constexpr uint8_t servoSlotFrom(int servo, int slot) {
+  return slot >= PCA_BOARD_COUNT * PCA_CHANNEL_COUNT ? NO_SLOT
+       : airSlot(slot, 0) ? servoSlotFrom(servo, slot + 1)
+       : servo == 0 ? slot
+       : servoSlotFrom(servo - 1, slot + 1);
+}
+constexpr uint8_t servoSlot(int servo) {
+  return servo < NUMBER_OF_NOTES ? servoSlotFrom(servo, 0) : NO_SLOT;
+}
+
+// Air valve channels: on an existing board, one per instrument
+constexpr bool airChannelUsedAfter(int instrument, int other) {
+  return other < INSTRUMENT_COUNT
+      && (instrumentAirChannel[other] == instrumentAirChannel[instrument] || airChannelUsedAfter(instrument, other + 1));
+}
+constexpr bool airChannelsValidFrom(int instrument) {
+  return instrument >= INSTRUMENT_COUNT
+      || (instrumentAirChannel[instrument] < PCA_CHANNEL_COUNT && !airChannelUsedAfter(instrument, instrument + 1)
+          && airChannelsValidFrom(instrument + 1));
+}
+static_assert(!AIR_ON_PCA || AIR_PCA_BOARD < PCA_BOARD_COUNT, "AIR_PCA_BOARD out of range");
+static_assert(!AIR_ON_PCA || airChannelsValidFrom(0), "instrumentAirChannel out of range or shared by two instruments");
+static_assert(servoSlot(NUMBER_OF_NOTES - 1) != NO_SLOT,
+              "Not enough PCA9685 channels for NUMBER_OF_NOTES servos and the air valves: raise PCA_BOARD_COUNT");
+
+#define SLOT_4(n) servoSlot(n), servoSlot(n + 1), servoSlot(n + 2), servoSlot(n + 3)
+#define SLOT_16(n) SLOT_4(n), SLOT_4(n + 4), SLOT_4(n + 8), SLOT_4(n + 12)
+const uint8_t SettingsServoTables::slots[MAX_SERVOS] PROGMEM = {
+  SLOT_16(0), SLOT_16(16), SLOT_16(32), SLOT_16(48)
+};
+
+// Configuration checked once, at compile time, instead of on every note (board and servo
+// counts: ServoConfig)
+static_assert(SERVO_MIN_ANGLE < SERVO_MAX_ANGLE && SERVO_PULSE_MIN < SERVO_PULSE_MAX, "Invalid servo range");
+static_assert(HOMING_GROUP_SIZE > 0, "HOMING_GROUP_SIZE must move at least one servo");
+static_assert(I2C_TX_BUFFER_SIZE >= 5, "A burst needs the register byte and 4 bytes for one channel");
+static_assert(PWM_PERIOD_TICKS == 4096, "The PCA9685 period is 4096 ticks");
+
+template <class Config>
+ServoControllerT<Config>::ServoControllerT()
+  : isInitialized(false), homedMask(0), homingGroupMask(0), pressedMask(0), homingNext(0),
+    homingStepTime(0), lastActivityTime(0), parkSaved(false), settleMask(0),
+    holdMask(0), statsWindowStart(0), statsWindowAvoided(0), activeBank(NO_BANK),
+    activeSequence(0), imageBank(0) {
+  for (uint8_t b = 0; b < boardCount; b++) {
+    pwm[b] = Adafruit_PWMServoDriver(Tables::address(b));
+    dirtyChannels[b] = 0;
+    for (uint8_t c = 0; c < PCA_CHANNEL_COUNT; c++) {
+      frameTicks[b][c] = 0;
+      writtenTicks[b][c] = 0;
+    }
+  }
+  resetBusStats();
 
   // Try to load calibration from EEPROM, otherwise use defaults
   if (!loadCalibration()) {
@@ -14,55 +71,46 @@ ServoController::ServoController() : isInitialized(false) {
   }
 }
 
-bool ServoController::begin() {
-  // Initialize first PWM driver
-  if (!pwm1.begin()) {
-    Serial.println("ERROR: PCA1 (0x40) I2C communication failed!");
-    Serial.println("Check wiring and I2C address.");
-    return false;
+template <class Config>
+bool ServoControllerT<Config>::begin() {
+  // Shared by every instrument: initialized once
+  if (isInitialized) {
+    return true;
   }
-  pwm1.setOscillatorFrequency(27000000);
-  pwm1.setPWMFreq(SERVO_FREQUENCY);
 
-  // Initialize second PWM driver
-  if (!pwm2.begin()) {
-    Serial.println("ERROR: PCA2 (0x41) I2C communication failed!");
-    Serial.println("Check wiring and I2C address.");
-    return false;
+  // Initialize every PWM driver
+  for (uint8_t b = 0; b < boardCount; b++) {
+    if (!pwm[b].begin()) {
+      Serial.print("ERROR: PCA");
+      Serial.print(b + 1);
+      Serial.print(" (0x");
+      Serial.print(Tables::address(b), HEX);
+      Serial.println(") I2C communication failed!");
+      Serial.println("Check wiring and I2C address.");
+      return false;
+    }
+    pwm[b].setOscillatorFrequency(27000000);
+    pwm[b].setPWMFreq(SERVO_FREQUENCY);
   }
-  pwm2.setOscillatorFrequency(27000000);
-  pwm2.setPWMFreq(SERVO_FREQUENCY);
 
   isInitialized = true;
-  Serial.println("ServoController: Both PWM drivers initialized successfully");
+  Serial.print("ServoController: ");
+  Serial.print(boardCount);
+  Serial.println(" PWM drivers initialized successfully");
 
-  resetServosPosition();
+  startHoming();
   return true;
 }
 
-bool ServoController::isReady() {
+template <class Config>
+bool ServoControllerT<Config>::isReady() {
   return isInitialized;
 }
 
-void ServoController::setServoAngle(uint8_t servoNum, uint16_t angle) {
-  // Validate parameters
-  if (!isInitialized) {
-    if (DEBUG) {
-      Serial.println("ERROR: ServoController not initialized!");
-    }
-    return;
-  }
-
-  if (servoNum >= NUMBER_OF_NOTES) {
-    if (DEBUG) {
-      Serial.print("ERROR: Invalid servo number: ");
-      Serial.println(servoNum);
-    }
-    return;
-  }
-
+template <class Config>
+uint16_t ServoControllerT<Config>::angleToTicks(int16_t angle) {
   if (angle < SERVO_MIN_ANGLE || angle > SERVO_MAX_ANGLE) {
-    if (DEBUG) {
+    if (verbose) {
       Serial.print("WARNING: Angle ");
       Serial.print(angle);
       Serial.println(" out of range, clamping");
@@ -75,160 +123,568 @@ void ServoController::setServoAngle(uint8_t servoNum, uint16_t angle) {
 
   // Optimized calculation without float conversion
   // analog_value = (pulsation * SERVO_FREQUENCY * 4096) / MICROSECONDS_PER_SECOND
-  uint32_t analog_value = ((uint32_t)pulsation * SERVO_FREQUENCY * 4096UL) / MICROSECONDS_PER_SECOND;
+  return ((uint32_t)pulsation * SERVO_FREQUENCY * 4096UL) / MICROSECONDS_PER_SECOND;
+}
 
-  // Select the appropriate PWM driver
-  if (servoNum < PWM_CHANNELS_PER_DRIVER) {
-    pwm1.setPWM(servoNum, 0, analog_value);
-  } else {
-    pwm2.setPWM(servoNum - PWM_CHANNELS_PER_DRIVER, 0, analog_value);
-  }
+template <class Config>
+void ServoControllerT<Config>::updateServoTicks(uint8_t servoNum) {
+  // sensRot détermine le sens de rotation (+1 ou -1)
+  int16_t restAngle = currentAngles[servoNum];
+  int8_t direction = currentDirections[servoNum];
+  int16_t hoverAngle = restAngle - hoverOffsets[servoNum] * direction;
+  pressTicks[servoNum] = angleToTicks(restAngle - pressTravels[servoNum] * direction);
+  releaseTicks[servoNum] = angleToTicks(hoverAngle);
+  overshootTicks[servoNum] = angleToTicks(hoverAngle + releaseOvershoots[servoNum] * direction);
 }
 
-void ServoController::resetServosPosition() {
-  // Utilisé au démarrage pour déplacer tout les servos en position initiale
+template <class Config>
+bool ServoControllerT<Config>::checkServo(uint8_t servoNum, const char* caller) {
   if (!isInitialized) {
-    Serial.println("ERROR: Cannot reset servos - controller not initialized!");
+    Serial.println("ERROR: ServoController not initialized!");
+    return false;
+  }
+  if (servoNum >= noteCount) {
+    Serial.print("ERROR: Invalid servo number in ");
+    Serial.print(caller);
+    Serial.print(": ");
+    Serial.println(servoNum);
+    return false;
+  }
+  return true;
+}
+
+template <class Config>
+void ServoControllerT<Config>::setAirAngle(uint8_t channel, uint8_t angle) {
+  if (!isInitialized || !AIR_ON_PCA) {
     return;
   }
+  setChannelTicks(AIR_PCA_BOARD, channel, angleToTicks(angle));
+}
+
+template <class Config>
+uint16_t ServoControllerT<Config>::phaseOffset(uint8_t board, uint8_t channel) {
+  if (!PWM_PHASE_MODE) {
+    return 0;
+  }
+  return (Tables::phaseBase(board) + channel * Tables::phaseStep(board)) % PWM_PERIOD_TICKS;
+}
 
-  Serial.println("Resetting all servos to initial positions...");
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; ++i) {
-    setServoAngle(i, currentAngles[i]);
-    delay(SERVO_RESET_DELAY_MS); // délai pour laisser les servos se déplacer
+template <class Config>
+uint8_t ServoControllerT<Config>::writeChannelBurst(uint8_t board, uint8_t firstChannel, uint8_t count) {
+  // One transaction: start, address, LEDn_ON_L register, then 4 bytes per channel.
+  // The PCA9685 auto-increments the register pointer (MODE1.AI, set by setPWMFreq()).
+  Wire.beginTransmission(Tables::address(board));
+  Wire.write(PCA9685_LED0_ON_L + 4 * firstChannel);
+  for (uint8_t c = firstChannel; c < firstChannel + count; c++) {
+    // The PCA9685 wraps OFF past the end of the period, so ON can be anywhere
+    uint16_t on = phaseOffset(board, c);
+    uint16_t off = (on + frameTicks[board][c]) % PWM_PERIOD_TICKS;
+    Wire.write(on & 0xFF);    // ON_L
+    Wire.write(on >> 8);      // ON_H
+    Wire.write(off & 0xFF);   // OFF_L
+    Wire.write(off >> 8);     // OFF_H
+    writtenTicks[board][c] = frameTicks[board][c];
   }
-  Serial.println("All servos reset complete");
+  Wire.endTransmission();
+
+  return 2 + 4 * count; // address + register + data
 }
 
-// Active la note avec le servo (position fixe noteOn)
-void ServoController::noteOn(uint8_t servoNum) {
+template <class Config>
+void ServoControllerT<Config>::flush() {
   if (!isInitialized) {
-    if (DEBUG) {
-      Serial.println("ERROR: ServoController not initialized!");
-    }
     return;
   }
 
-  if (servoNum >= NUMBER_OF_NOTES) {
-    if (DEBUG) {
-      Serial.print("ERROR: Invalid servo number in noteOn: ");
-      Serial.println(servoNum);
+  // Channels per transaction limited by the Wire buffer (register byte + 4 bytes per channel)
+  const uint8_t maxBurst = (I2C_TX_BUFFER_SIZE - 1) / 4;
+  uint16_t bytes = 0;
+  uint8_t transactions = 0;
+
+  for (uint8_t b = 0; b < boardCount; b++) {
+    uint16_t mask = dirtyChannels[b];
+
+    // Write suppression: the PCA9685 already holds this value
+    for (uint8_t c = 0; c < PCA_CHANNEL_COUNT; c++) {
+      if ((mask & (1U << c)) && frameTicks[b][c] == writtenTicks[b][c]) {
+        mask &= ~(1U << c);
+        busStats.suppressedWrites++;
+      }
     }
+
+    uint8_t c = 0;
+    while (mask != 0) {
+      // Skip to the next dirty channel
+      while (!(mask & (1U << c))) {
+        c++;
+      }
+      // Extend the run over contiguous dirty channels
+      uint8_t count = 0;
+      while (c + count < PCA_CHANNEL_COUNT && (mask & (1U << (c + count))) && count < maxBurst) {
+        mask &= ~(1U << (c + count));
+        count++;
+      }
+      bytes += writeChannelBurst(b, c, count);
+      transactions++;
+      c += count;
+    }
+    dirtyChannels[b] = 0;
+  }
+
+  // Keys commanded since the last flush are on the bus now (or already were)
+  latencyStats.busWritten();
+
+  if (transactions == 0) {
     return;
   }
 
-  // Position fixe pour appuyer sur la touche
-  // sensRot détermine le sens de rotation (+1 ou -1)
-  setServoAngle(servoNum, currentAngles[servoNum] - ANGLE_NOTE_ON * currentDirections[servoNum]);
+  busStats.lastFlushBytes = bytes;
+  busStats.lastFlushTransactions = transactions;
+  busStats.totalBytes += bytes;
+  busStats.totalTransactions += transactions;
+  busStats.flushCount++;
+
+  if (verbose) {
+    Serial.print("Flush: ");
+    Serial.print(bytes);
+    Serial.print(" bytes, ");
+    Serial.print(transactions);
+    Serial.println(" transactions");
+  }
+}
+
+template <class Config>
+const BusStats& ServoControllerT<Config>::getBusStats() {
+  return busStats;
+}
+
+template <class Config>
+void ServoControllerT<Config>::resetBusStats() {
+  busStats.lastFlushBytes = 0;
+  busStats.lastFlushTransactions = 0;
+  busStats.totalBytes = 0;
+  busStats.totalTransactions = 0;
+  busStats.flushCount = 0;
+  busStats.suppressedWrites = 0;
+  busStats.coalescedWrites = 0;
+  busStats.savedBytesPerSecond = 0;
+  statsWindowStart = millis();
+  statsWindowAvoided = 0;
 }
 
-// Desactive la note avec le servo
-void ServoController::noteOff(uint8_t servoNum) {
+template <class Config>
+void ServoControllerT<Config>::startHoming() {
+  // Utilisé au démarrage pour déplacer tout les servos en position initiale
   if (!isInitialized) {
-    if (DEBUG) {
-      Serial.println("ERROR: ServoController not initialized!");
+    Serial.println("ERROR: Cannot reset servos - controller not initialized!");
+    return;
+  }
+
+  // Servos parked at shutdown are already at rest: drive them without waiting
+  ParkRecord<Mask> park;
+  EEPROM.get(parkAddress(), park);
+  if (park.valid == EEPROM_PARK_MAGIC) {
+    for (uint8_t i = 0; i < noteCount; i++) {
+      if (park.restMask & ((Mask)1 << i)) {
+        setServoTicks(i, releaseTicks[i]);
+      }
+    }
+    homedMask = park.restMask;
+    parkSaved = true;
+    Serial.print("Parked servos restored: 0x");
+    Serial.println(park.restMask, HEX);
+    if (homedMask != 0) {
+      Serial.print("First note playable at ");
+      Serial.print(millis());
+      Serial.println(" ms");
     }
+  }
+
+  homingNext = 0;
+  homingGroupMask = 0;
+  homingStepTime = millis() - SERVO_RESET_DELAY_MS; // first group right away
+  lastActivityTime = millis();
+
+  Serial.println("Homing servos in the background...");
+  updateHoming(millis());
+}
+
+template <class Config>
+void ServoControllerT<Config>::updateHoming(unsigned long now) {
+  if (homingNext >= noteCount && homingGroupMask == 0) {
     return;
   }
+  if (now - homingStepTime < SERVO_RESET_DELAY_MS) {
+    return; // laisser le groupe précédent finir son déplacement
+  }
+
+  // The previous group has had time to move: its notes become playable
+  if (homingGroupMask != 0) {
+    if (homedMask == 0) {
+      Serial.print("First note playable at ");
+      Serial.print(now);
+      Serial.println(" ms");
+    }
+    homedMask |= homingGroupMask;
+    homingGroupMask = 0;
+  }
 
-  if (servoNum >= NUMBER_OF_NOTES) {
-    if (DEBUG) {
-      Serial.print("ERROR: Invalid servo number in noteOff: ");
-      Serial.println(servoNum);
+  // Next group, skipping servos already at rest
+  uint8_t count = 0;
+  while (homingNext < noteCount && count < HOMING_GROUP_SIZE) {
+    Mask bit = (Mask)1 << homingNext;
+    if (!(homedMask & bit)) {
+      setServoTicks(homingNext, releaseTicks[homingNext]);
+      homingGroupMask |= bit;
+      count++;
     }
+    homingNext++;
+  }
+  homingStepTime = now;
+
+  if (homingNext >= noteCount && homingGroupMask == 0) {
+    Serial.print("All servos homed at ");
+    Serial.print(now);
+    Serial.println(" ms");
+    Serial.print("Peak concurrent servo pulses: ");
+    Serial.println(peakConcurrentPulses());
+  }
+}
+
+template <class Config>
+bool ServoControllerT<Config>::isHomingComplete() {
+  return homingNext >= noteCount && homingGroupMask == 0;
+}
+
+template <class Config>
+void ServoControllerT<Config>::update() {
+  if (!isInitialized) {
+    return;
+  }
+  unsigned long now = millis();
+  updateHoming(now);
+  updateTimers(now);
+
+  // Key changes of this loop iteration go out before any EEPROM bookkeeping
+  flush();
+
+  // Bus bytes avoided per second, each avoided write being a stand-alone setPWM() (6 bytes)
+  if (now - statsWindowStart >= 1000) {
+    uint32_t avoided = busStats.suppressedWrites + busStats.coalescedWrites;
+    busStats.savedBytesPerSecond = (avoided - statsWindowAvoided) * 6UL * 1000UL / (now - statsWindowStart);
+    statsWindowAvoided = avoided;
+    statsWindowStart = now;
+  }
+
+  // A key is down: the saved rest positions no longer hold
+  if (parkSaved && pressedMask != 0) {
+    clearParkedState();
+  }
+
+  // Idle long enough: remember which servos are at rest for the next boot
+  if (!parkSaved && pressedMask == 0 && isHomingComplete()
+      && now - lastActivityTime > PARK_SAVE_IDLE_MS) {
+    saveParkedState();
+  }
+}
+
+template <class Config>
+void ServoControllerT<Config>::updateTimers(unsigned long now) {
+  if ((settleMask | holdMask) == 0) {
     return;
   }
+  for (uint8_t i = 0; i < noteCount; i++) {
+    Mask bit = (Mask)1 << i;
+    uint16_t elapsed = (uint16_t)now - timerStarts[i];
+
+    // Key down long enough to sound: the deferred release can go
+    if ((holdMask & bit) && elapsed >= MIN_NOTE_HOLD_MS) {
+      holdMask &= ~bit;
+      releaseServo(i, now);
+    } else if ((settleMask & bit) && elapsed >= RELEASE_OVERSHOOT_MS) {
+      setServoTicks(i, releaseTicks[i]);
+      settleMask &= ~bit;
+    }
+  }
+}
+
+template <class Config>
+void ServoControllerT<Config>::saveParkedState() {
+  ParkRecord<Mask> park;
+  park.valid = EEPROM_PARK_MAGIC;
+  park.restMask = homedMask & ~pressedMask;
+  EEPROM.put(parkAddress(), park); // put() only rewrites bytes that changed
+  parkSaved = true;
 
-  setServoAngle(servoNum, currentAngles[servoNum]);
+  if (verbose) {
+    Serial.println("DEBUG: Rest positions saved to EEPROM");
+  }
+}
+
+template <class Config>
+void ServoControllerT<Config>::clearParkedState() {
+  EEPROM.update(parkAddress() + offsetof(ParkRecord<Mask>, valid), 0);
+  parkSaved = false;
+}
+
+template <class Config>
+uint8_t ServoControllerT<Config>::peakConcurrentPulses() {
+  // The overlap count is maximal at the start of one of the pulses:
+  // for each pulse start, count the pulses (itself included) that are high on that tick
+  uint8_t peak = 0;
+
+  for (uint8_t bi = 0; bi < boardCount; bi++) {
+    for (uint8_t ci = 0; ci < PCA_CHANNEL_COUNT; ci++) {
+      if (frameTicks[bi][ci] == 0) {
+        continue;
+      }
+      uint16_t start = phaseOffset(bi, ci);
+      uint8_t count = 0;
+
+      for (uint8_t bj = 0; bj < boardCount; bj++) {
+        for (uint8_t cj = 0; cj < PCA_CHANNEL_COUNT; cj++) {
+          uint16_t width = frameTicks[bj][cj];
+          uint16_t elapsed = (start + PWM_PERIOD_TICKS - phaseOffset(bj, cj)) % PWM_PERIOD_TICKS;
+          if (width != 0 && elapsed < width) {
+            count++;
+          }
+        }
+      }
+
+      if (count > peak) {
+        peak = count;
+      }
+    }
+  }
+
+  return peak;
 }
 
 // ========== CALIBRATION FUNCTIONS ==========
 
-uint16_t ServoController::calculateChecksum(const CalibrationData& data) {
-  uint16_t sum = 0;
-  sum += data.magicNumber;
-  sum += data.version;
+// CRC-16/CCITT (polynomial 0x1021, init 0xFFFF), one byte at a time
+static uint16_t crc16Update(uint16_t crc, uint8_t data) {
+  crc ^= (uint16_t)data << 8;
+  for (uint8_t b = 0; b < 8; b++) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
 
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
-    sum += data.servoAngles[i];
-    sum += (uint8_t)data.servoDirections[i];
+// Writes only the bytes that differ (EEPROM wear), folding each one into the CRC
+static uint16_t writeBankBytes(uint16_t address, const void* data, uint16_t length, uint16_t crc, uint16_t& written) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (uint16_t i = 0; i < length; i++) {
+    if (EEPROM.read(address + i) != bytes[i]) {
+      EEPROM.write(address + i, bytes[i]);
+      written++;
+    }
+    crc = crc16Update(crc, bytes[i]);
   }
+  return crc;
+}
 
-  return sum;
+template <class Config>
+uint16_t ServoControllerT<Config>::bankAddress(uint8_t bank) {
+  return EEPROM_START_ADDRESS + bank * sizeof(Calibration);
 }
 
-bool ServoController::saveCalibration() {
-  CalibrationData data;
+template <class Config>
+uint16_t ServoControllerT<Config>::parkAddress() {
+  static_assert(offsetof(Calibration, crc) == 4 + 7 * noteCount,
+                "CalibrationRecord must have no padding: the CRC covers its bytes in order");
+#if defined(E2END)
+  static_assert(EEPROM_START_ADDRESS + 2 * sizeof(Calibration) + sizeof(ParkRecord<Mask>) <= E2END + 1,
+                "Calibration banks do not fit in EEPROM");
+#endif
+  return EEPROM_START_ADDRESS + 2 * sizeof(Calibration);
+}
 
-  data.magicNumber = EEPROM_MAGIC_NUMBER;
-  data.version = EEPROM_VERSION;
+template <class Config>
+bool ServoControllerT<Config>::readBankSequence(uint8_t bank, uint8_t& sequence) {
+  uint16_t address = bankAddress(bank);
+  uint16_t magic;
+  EEPROM.get(address + offsetof(Calibration, magicNumber), magic);
+  if (magic != EEPROM_MAGIC_NUMBER || EEPROM.read(address + offsetof(Calibration, version)) != EEPROM_VERSION) {
+    return false;
+  }
 
-  // Copy current calibration
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
-    data.servoAngles[i] = currentAngles[i];
-    data.servoDirections[i] = currentDirections[i];
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < offsetof(Calibration, crc); i++) {
+    crc = crc16Update(crc, EEPROM.read(address + i));
   }
+  uint16_t storedCrc;
+  EEPROM.get(address + offsetof(Calibration, crc), storedCrc);
+  if (crc != storedCrc) {
+    Serial.print("ERROR: EEPROM bank ");
+    Serial.print(bank ? "B" : "A");
+    Serial.println(" CRC mismatch - data corrupted!");
+    return false;
+  }
+
+  sequence = EEPROM.read(address + offsetof(Calibration, sequence));
+  return true;
+}
 
-  // Calculate and store checksum
-  data.checksum = calculateChecksum(data);
+template <class Config>
+void ServoControllerT<Config>::loadBank(uint8_t bank) {
+  // Straight into the working tables, one field at a time
+  uint16_t address = bankAddress(bank);
+  EEPROM.get(address + offsetof(Calibration, servoAngles), currentAngles);
+  EEPROM.get(address + offsetof(Calibration, servoDirections), currentDirections);
+  EEPROM.get(address + offsetof(Calibration, hoverOffsets), hoverOffsets);
+  EEPROM.get(address + offsetof(Calibration, pressTravels), pressTravels);
+  EEPROM.get(address + offsetof(Calibration, releaseOvershoots), releaseOvershoots);
+  EEPROM.get(address + offsetof(Calibration, travelTimes), travelTimes);
+  for (uint8_t i = 0; i < noteCount; i++) {
+    updateServoTicks(i);
+  }
+
+  activeBank = bank;
+  activeSequence = EEPROM.read(address + offsetof(Calibration, sequence));
+}
 
-  // Write to EEPROM
-  EEPROM.put(EEPROM_START_ADDRESS, data);
+template <class Config>
+void ServoControllerT<Config>::sealBank(uint8_t bank, uint8_t sequence) {
+  uint16_t address = bankAddress(bank);
+  EEPROM.update(address + offsetof(Calibration, sequence), sequence);
+
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < offsetof(Calibration, crc); i++) {
+    crc = crc16Update(crc, EEPROM.read(address + i));
+  }
+  EEPROM.put(address + offsetof(Calibration, crc), crc);
+}
 
-  Serial.println("Calibration saved to EEPROM");
+template <class Config>
+bool ServoControllerT<Config>::saveCalibration() {
+  // Always to the bank not in use: after a power cut mid-write the previous bank is still
+  // valid, and the CRC (written last) rejects the half-written one at the next boot
+  uint8_t bank = (activeBank == 0) ? 1 : 0;
+  uint16_t address = bankAddress(bank);
+  uint16_t magic = EEPROM_MAGIC_NUMBER;
+  uint8_t version = EEPROM_VERSION;
+  uint8_t sequence = activeSequence + 1;
+  uint16_t written = 0;
+  uint16_t crc = 0xFFFF;
+
+  // Fields in declaration order: the CRC covers the bytes as they lie in EEPROM
+  crc = writeBankBytes(address + offsetof(Calibration, magicNumber), &magic, sizeof(magic), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, version), &version, sizeof(version), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, sequence), &sequence, sizeof(sequence), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, servoAngles), currentAngles, sizeof(currentAngles), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, servoDirections), currentDirections, sizeof(currentDirections), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, hoverOffsets), hoverOffsets, sizeof(hoverOffsets), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, pressTravels), pressTravels, sizeof(pressTravels), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, releaseOvershoots), releaseOvershoots, sizeof(releaseOvershoots), crc, written);
+  crc = writeBankBytes(address + offsetof(Calibration, travelTimes), travelTimes, sizeof(travelTimes), crc, written);
+  writeBankBytes(address + offsetof(Calibration, crc), &crc, sizeof(crc), 0, written);
+
+  activeBank = bank;
+  activeSequence = sequence;
+
+  Serial.print("Calibration saved to EEPROM bank ");
+  Serial.print(bank ? "B (" : "A (");
+  Serial.print(written);
+  Serial.println(" bytes written)");
   return true;
 }
 
-bool ServoController::loadCalibration() {
-  CalibrationData data;
+template <class Config>
+bool ServoControllerT<Config>::loadCalibration() {
+  // One CRC pass per bank, the newest valid one is loaded
+  uint8_t sequenceA = 0;
+  uint8_t sequenceB = 0;
+  bool validA = readBankSequence(0, sequenceA);
+  bool validB = readBankSequence(1, sequenceB);
+
+  if (validA && (!validB || (int8_t)(sequenceA - sequenceB) > 0)) {
+    loadBank(0);
+  } else if (validB) {
+    loadBank(1);
+  } else {
+    activeBank = NO_BANK;
+    activeSequence = 0;
+    return migrateLegacyCalibration();
+  }
 
-  // Read from EEPROM
-  EEPROM.get(EEPROM_START_ADDRESS, data);
+  if (verbose) {
+    Serial.print("DEBUG: EEPROM bank ");
+    Serial.print(activeBank ? "B" : "A");
+    Serial.print(" sequence ");
+    Serial.println(activeSequence);
+  }
+  return true;
+}
 
-  // Validate magic number
-  if (data.magicNumber != EEPROM_MAGIC_NUMBER) {
-    if (DEBUG) {
-      Serial.println("DEBUG: Invalid magic number in EEPROM");
+// Versions 1 to 3: one block at EEPROM_START_ADDRESS, a table appended at each version
+// (1 = angles + directions, 2 = + motion profiles, 3 = + travel times), additive checksum
+template <class Config>
+bool ServoControllerT<Config>::migrateLegacyCalibration() {
+  uint16_t address = EEPROM_START_ADDRESS;
+  uint16_t magic;
+  EEPROM.get(address, magic);
+  uint8_t version = EEPROM.read(address + 2);
+  if (magic != EEPROM_MAGIC_NUMBER || version < 1 || version >= EEPROM_VERSION) {
+    if (verbose) {
+      Serial.println("DEBUG: No calibration in EEPROM");
     }
     return false;
   }
 
-  // Validate version
-  if (data.version != EEPROM_VERSION) {
-    Serial.print("WARNING: EEPROM version mismatch (expected ");
-    Serial.print(EEPROM_VERSION);
-    Serial.print(", got ");
-    Serial.print(data.version);
-    Serial.println(")");
-    return false;
+  // Checksum straight from EEPROM: the working tables only change for a valid block
+  uint8_t byteTables = (version >= 3) ? 5 : (version >= 2) ? 4 : 1; // uint8_t tables after the angles
+  uint16_t first = address + 3;
+  uint16_t bytesStart = first + 2 * noteCount;
+  uint16_t end = bytesStart + byteTables * noteCount;
+  uint16_t sum = magic + version;
+  for (uint16_t a = first; a < bytesStart; a += 2) {
+    uint16_t angle;
+    EEPROM.get(a, angle);
+    sum += angle;
   }
-
-  // Validate checksum
-  uint16_t calculatedChecksum = calculateChecksum(data);
-  if (calculatedChecksum != data.checksum) {
+  for (uint16_t a = bytesStart; a < end; a++) {
+    sum += EEPROM.read(a);
+  }
+  uint16_t checksum;
+  EEPROM.get(end, checksum);
+  if (sum != checksum) {
     Serial.println("ERROR: EEPROM checksum mismatch - data corrupted!");
     return false;
   }
 
-  // Load calibration
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
-    currentAngles[i] = data.servoAngles[i];
-    currentDirections[i] = data.servoDirections[i];
+  // Tables the old version did not have keep their defaults
+  EEPROM.get(first, currentAngles);
+  for (uint8_t i = 0; i < noteCount; i++) {
+    currentDirections[i] = (int8_t)EEPROM.read(bytesStart + i);
+    hoverOffsets[i] = (version >= 2) ? EEPROM.read(bytesStart + noteCount + i) : DEFAULT_HOVER_OFFSET;
+    pressTravels[i] = (version >= 2) ? EEPROM.read(bytesStart + 2 * noteCount + i) : ANGLE_NOTE_ON;
+    releaseOvershoots[i] = (version >= 2) ? EEPROM.read(bytesStart + 3 * noteCount + i) : DEFAULT_RELEASE_OVERSHOOT;
+    updateServoTicks(i);
+    travelTimes[i] = (version >= 3) ? EEPROM.read(bytesStart + 4 * noteCount + i)
+                                    : min(estimatePressMs(i), (uint16_t)255);
   }
 
-  return true;
+  Serial.print("Migrating calibration from EEPROM version ");
+  Serial.println(version);
+  // The old block lies where bank A starts: the first save goes to bank B
+  activeBank = 0;
+  activeSequence = 0;
+  return saveCalibration();
 }
 
-void ServoController::setServoCalibration(uint8_t servoNum, uint16_t angle, int8_t direction) {
-  if (servoNum >= NUMBER_OF_NOTES) {
+template <class Config>
+void ServoControllerT<Config>::setServoCalibration(uint8_t servoNum, uint16_t angle, int8_t direction) {
+  if (servoNum >= noteCount) {
     Serial.println("ERROR: Invalid servo number for calibration");
     return;
   }
 
   currentAngles[servoNum] = angle;
   currentDirections[servoNum] = direction;
+  updateServoTicks(servoNum);
 
-  if (DEBUG) {
+  if (verbose) {
     Serial.print("Servo ");
     Serial.print(servoNum);
     Serial.print(" calibrated: angle=");
@@ -238,28 +694,166 @@ void ServoController::setServoCalibration(uint8_t servoNum, uint16_t angle, int8
   }
 }
 
-void ServoController::resetToDefaultCalibration() {
+template <class Config>
+void ServoControllerT<Config>::resetToDefaultCalibration() {
   // Load default values from settings.h
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+  for (uint8_t i = 0; i < noteCount; i++) {
     currentAngles[i] = initialAngles[i];
     currentDirections[i] = sensRot[i];
+    hoverOffsets[i] = DEFAULT_HOVER_OFFSET;
+    pressTravels[i] = ANGLE_NOTE_ON;
+    releaseOvershoots[i] = DEFAULT_RELEASE_OVERSHOOT;
+    updateServoTicks(i);
+    // Until measured, the kinematic model gives the travel time
+    travelTimes[i] = min(estimatePressMs(i), (uint16_t)255);
   }
 
   Serial.println("Calibration reset to defaults");
 }
 
-bool ServoController::isCalibrationValid() {
-  CalibrationData data;
-  EEPROM.get(EEPROM_START_ADDRESS, data);
+template <class Config>
+void ServoControllerT<Config>::setMotionProfile(uint8_t servoNum, uint8_t hoverOffset, uint8_t pressTravel, uint8_t releaseOvershoot) {
+  if (servoNum >= noteCount) {
+    Serial.println("ERROR: Invalid servo number for motion profile");
+    return;
+  }
+  if (hoverOffset >= pressTravel) {
+    Serial.println("ERROR: Hover position must stay above the key (hover < press)");
+    return;
+  }
 
-  if (data.magicNumber != EEPROM_MAGIC_NUMBER) {
-    return false;
+  hoverOffsets[servoNum] = hoverOffset;
+  pressTravels[servoNum] = pressTravel;
+  releaseOvershoots[servoNum] = releaseOvershoot;
+  updateServoTicks(servoNum);
+
+  if (verbose) {
+    Serial.print("Servo ");
+    Serial.print(servoNum);
+    Serial.print(" profile: hover=");
+    Serial.print(hoverOffset);
+    Serial.print(" press=");
+    Serial.print(pressTravel);
+    Serial.print(" overshoot=");
+    Serial.println(releaseOvershoot);
+  }
+}
+
+template <class Config>
+void ServoControllerT<Config>::setTravelTime(uint8_t servoNum, uint8_t ms) {
+  if (servoNum >= noteCount) {
+    Serial.println("ERROR: Invalid servo number for travel time");
+    return;
+  }
+  travelTimes[servoNum] = ms;
+}
+
+template <class Config>
+uint8_t ServoControllerT<Config>::getTravelTime(uint8_t servoNum) {
+  return travelTimes[servoNum];
+}
+
+template <class Config>
+uint16_t ServoControllerT<Config>::estimateTravelMs(uint8_t distance, uint8_t targetDistance) {
+  // SG90 model: full speed while the position error is above SERVO_DECEL_ZONE_DEG,
+  // then speed proportional to the error (exponential approach of the target).
+  // Returns the time needed to cover `distance` degrees toward a target `targetDistance` away.
+  const float msPerDegree = SERVO_MS_PER_DEGREE_X10 / 10.0;
+  float errorStart = targetDistance;
+  float errorEnd = (distance >= targetDistance) ? 1.0 : (float)(targetDistance - distance); // 1° = "arrived"
+  float ms = 0;
+
+  if (errorStart > SERVO_DECEL_ZONE_DEG) {
+    float fastEnd = (errorEnd > SERVO_DECEL_ZONE_DEG) ? errorEnd : SERVO_DECEL_ZONE_DEG;
+    ms += (errorStart - fastEnd) * msPerDegree;
+    errorStart = fastEnd;
+  }
+  if (errorEnd < errorStart) {
+    ms += SERVO_DECEL_ZONE_DEG * msPerDegree * log(errorStart / errorEnd);
+  }
+  return (uint16_t)ms;
+}
+
+template <class Config>
+uint16_t ServoControllerT<Config>::estimatePressMs(uint8_t servoNum) {
+  uint8_t travel = pressTravels[servoNum] - hoverOffsets[servoNum];
+  return estimateTravelMs(travel, travel);
+}
+
+template <class Config>
+uint16_t ServoControllerT<Config>::estimateReleaseMs(uint8_t servoNum) {
+  // The key is free once the servo is back at the hover (contact) position
+  uint8_t travel = pressTravels[servoNum] - hoverOffsets[servoNum];
+  return estimateTravelMs(travel, travel + releaseOvershoots[servoNum]);
+}
+
+template <class Config>
+void ServoControllerT<Config>::printMotionProfiles() {
+  uint16_t basePress = estimateTravelMs(ANGLE_NOTE_ON, ANGLE_NOTE_ON);
+
+  Serial.println("Servo | press ms | release ms | saved ms (plain travel: press=release)");
+  for (uint8_t i = 0; i < noteCount; i++) {
+    uint16_t press = estimatePressMs(i);
+    uint16_t release = estimateReleaseMs(i);
+    Serial.print(i);
+    Serial.print(" | ");
+    Serial.print(press);
+    Serial.print(" | ");
+    Serial.print(release);
+    Serial.print(" | ");
+    Serial.println((int16_t)(2 * basePress - press - release));
+  }
+}
+
+template <class Config>
+uint16_t ServoControllerT<Config>::calibrationImageSize() {
+  return sizeof(Calibration);
+}
+
+template <class Config>
+uint8_t ServoControllerT<Config>::readCalibrationImage(uint16_t offset) {
+  return EEPROM.read(bankAddress(activeBank == NO_BANK ? 0 : activeBank) + offset);
+}
+
+template <class Config>
+void ServoControllerT<Config>::beginCalibrationImage() {
+  // The bank in use is never touched: a transfer cut short leaves it in place
+  imageBank = (activeBank == 0) ? 1 : 0;
+  uint16_t invalid = 0;
+  EEPROM.put(bankAddress(imageBank) + offsetof(Calibration, magicNumber), invalid);
+}
+
+template <class Config>
+void ServoControllerT<Config>::writeCalibrationImage(uint16_t offset, uint8_t value) {
+  if (offset < offsetof(Calibration, version)) {
+    return; // Magic number written by commitCalibrationImage() only
   }
+  EEPROM.update(bankAddress(imageBank) + offset, value);
+}
 
-  if (data.version != EEPROM_VERSION) {
+template <class Config>
+bool ServoControllerT<Config>::commitCalibrationImage() {
+  uint16_t magic = EEPROM_MAGIC_NUMBER;
+  uint8_t sequence;
+  EEPROM.put(bankAddress(imageBank) + offsetof(Calibration, magicNumber), magic);
+  if (!readBankSequence(imageBank, sequence)) {
+    // Version or CRC of the received image rejected
+    uint16_t invalid = 0;
+    EEPROM.put(bankAddress(imageBank) + offsetof(Calibration, magicNumber), invalid);
     return false;
   }
 
-  uint16_t calculatedChecksum = calculateChecksum(data);
-  return (calculatedChecksum == data.checksum);
-}
\ No newline at end of file
+  // Newer than the bank in use, whatever sequence number the image came with
+  sealBank(imageBank, activeSequence + 1);
+  loadBank(imageBank);
+  Serial.println("Calibration received");
+  return true;
+}
+
+template <class Config>
+bool ServoControllerT<Config>::isCalibrationValid() {
+  return activeBank != NO_BANK;
+}
+
+// The configuration of this sketch (settings.h)
+template class ServoControllerT<SettingsServoConfig>;
@@ -5,40 +5,283 @@
 #include <EEPROM.h>
 #include "settings.h"
 
-// Structure to store calibration data in EEPROM
-struct CalibrationData {
+// Structure to store calibration data in EEPROM, twice (banks A and B, see saveCalibration)
+template <uint8_t NOTES>
+struct CalibrationRecord {
   uint16_t magicNumber;       // Magic number for validation
   uint8_t version;            // Data structure version
-  uint16_t servoAngles[NUMBER_OF_NOTES];  // Initial angles for each servo
-  int8_t servoDirections[NUMBER_OF_NOTES]; // Rotation direction for each servo
-  uint16_t checksum;          // Simple checksum for data integrity
+  uint8_t sequence;           // +1 at each save, the newest valid bank is loaded
+  uint16_t servoAngles[NOTES];  // Initial angles for each servo
+  int8_t servoDirections[NOTES]; // Rotation direction for each servo
+  uint8_t hoverOffsets[NOTES];   // Rest -> hover distance (degrees)
+  uint8_t pressTravels[NOTES];   // Rest -> press distance (degrees)
+  uint8_t releaseOvershoots[NOTES]; // Overshoot past hover on release (degrees)
+  uint8_t travelTimes[NOTES];    // Command -> sound delay (ms), latency compensation
+  uint16_t crc;               // CRC-16/CCITT of every byte above
 };
+typedef CalibrationRecord<NUMBER_OF_NOTES> CalibrationData; // Image stored by this sketch
+#define NO_BANK 0xFF
+
+// One bit per servo
+#define MAX_SERVOS 64
+template <bool WIDE> struct ServoMaskType { typedef uint32_t type; };
+template <> struct ServoMaskType<true> { typedef uint64_t type; };
+typedef ServoMaskType<(NUMBER_OF_NOTES > 32)>::type ServoMask;
+static_assert(NUMBER_OF_NOTES <= MAX_SERVOS, "ServoMask holds at most 64 servos");
+
+// Position de repos mémorisée : les servos de restMask n'ont pas besoin de homing au démarrage
+template <class Mask>
+struct ParkRecord {
+  uint8_t valid;              // EEPROM_PARK_MAGIC if restMask is up to date
+  Mask restMask;              // Bit i set = servo i was last commanded to its rest position
+};
+
+// I2C traffic counters, updated by flush()
+struct BusStats {
+  uint16_t lastFlushBytes;         // Bytes on the bus during the last flush (address byte included)
+  uint8_t lastFlushTransactions;   // I2C transactions during the last flush
+  uint32_t totalBytes;             // Bytes since last reset
+  uint32_t totalTransactions;      // Transactions since last reset
+  uint32_t flushCount;             // Flushes that wrote at least one channel
+  uint32_t suppressedWrites;       // Channel writes skipped: value already on the PCA9685
+  uint32_t coalescedWrites;        // Channel values replaced before being sent
+  uint16_t savedBytesPerSecond;    // Bus bytes avoided by the two above, last 1 s window
+};
+
+// Niveau de debug (SERVO_DEBUG_LEVEL), paramètre de ServoConfig : rien ne reste du niveau
+// non choisi dans le code compilé
+#define SERVO_DEBUG_OFF 0      // Chemin des notes sans test
+#define SERVO_DEBUG_CHECKS 1   // + numéro de servo et initialisation vérifiés à chaque note
+#define SERVO_DEBUG_VERBOSE 2  // + messages série
+
+// Servo -> PCA9685 slot (board * PCA_CHANNEL_COUNT + channel)
+#define NO_SLOT 0xFF
+
+// Tables de câblage de settings.h, générées et vérifiées à la compilation (ServoController.cpp)
+struct SettingsServoTables {
+  static const uint8_t boardCount = PCA_BOARD_COUNT;
+  static const uint8_t noteCount = NUMBER_OF_NOTES;
+  static const uint8_t slots[MAX_SERVOS] PROGMEM; // Servo n = n-th free channel, air valves skipped
+  static uint8_t address(uint8_t board) { return pcaAddresses[board]; }
+  static uint16_t phaseBase(uint8_t board) { return pwmPhaseBase[board]; }   // ON tick of channel 0
+  static uint16_t phaseStep(uint8_t board) { return pwmPhaseStep[board]; }   // Ticks between channels
+};
+
+/***********************************************************************************************
+Configuration d'un ServoController (et des instruments qui le partagent), vérifiée une fois à
+la compilation : une configuration invalide ne compile pas, le chemin des notes ne teste rien
+- BOARDS : cartes PCA9685, NOTES : servos de touches
+- TABLES : slot de chaque servo, adresses et phases des cartes (SettingsServoTables)
+- DEBUG_LEVEL : SERVO_DEBUG_OFF, SERVO_DEBUG_CHECKS ou SERVO_DEBUG_VERBOSE
+************************************************************************************************/
+template <uint8_t BOARDS, uint8_t NOTES, class TABLES, uint8_t DEBUG_LEVEL>
+struct ServoConfig {
+  static_assert(NOTES > 0 && BOARDS > 0, "Empty servo configuration");
+  static_assert(NOTES <= MAX_SERVOS, "ServoMask holds at most 64 servos");
+  static_assert(NOTES <= BOARDS * PCA_CHANNEL_COUNT, "Not enough PCA9685 channels for NOTES servos");
+  static_assert(BOARDS * PCA_CHANNEL_COUNT < NO_SLOT, "Too many PCA9685 boards for the slot map");
+  static_assert(BOARDS == TABLES::boardCount && NOTES <= TABLES::noteCount,
+                "Wiring tables do not cover BOARDS boards and NOTES servos");
+  static_assert(DEBUG_LEVEL <= SERVO_DEBUG_VERBOSE, "Unknown debug level");
+
+  static const uint8_t boardCount = BOARDS;
+  static const uint8_t noteCount = NOTES;
+  static const uint8_t debugLevel = DEBUG_LEVEL;
+  typedef TABLES Tables;
+  typedef typename ServoMaskType<(NOTES > 32)>::type Mask;
+};
+
+template <class Config>
+class ServoControllerT {
+public:
+  static const uint8_t boardCount = Config::boardCount;
+  static const uint8_t noteCount = Config::noteCount;
+  static const uint8_t debugLevel = Config::debugLevel;
+  typedef typename Config::Mask Mask;
+  typedef CalibrationRecord<Config::noteCount> Calibration;
 
-class ServoController {
 private:
-  Adafruit_PWMServoDriver pwm1;
-  Adafruit_PWMServoDriver pwm2;
+  typedef typename Config::Tables Tables;
+  static const bool argChecks = debugLevel >= SERVO_DEBUG_CHECKS;
+  static const bool verbose = debugLevel >= SERVO_DEBUG_VERBOSE;
+
+  Adafruit_PWMServoDriver pwm[boardCount]; // Une carte par adresse de la table
   bool isInitialized;
-  uint16_t currentAngles[NUMBER_OF_NOTES];     // Current servo angles
-  int8_t currentDirections[NUMBER_OF_NOTES];   // Current servo directions
-  void setServoAngle(uint8_t servoNum, uint16_t angle);
-  void resetServosPosition();// utilisé au demarrage pour deplacer les servos en position init-angle
-  uint16_t calculateChecksum(const CalibrationData& data);
+  uint16_t currentAngles[noteCount];     // Current servo angles
+  int8_t currentDirections[noteCount];   // Current servo directions
+  uint8_t hoverOffsets[noteCount];       // Motion profile: rest -> hover (degrees)
+  uint8_t pressTravels[noteCount];       // Motion profile: rest -> press (degrees)
+  uint8_t releaseOvershoots[noteCount];  // Motion profile: overshoot past hover on release
+  uint8_t travelTimes[noteCount];        // Command -> sound delay (ms)
+  uint16_t pressTicks[noteCount];        // Precomputed PCA9685 ticks, key pressed
+  uint16_t releaseTicks[noteCount];      // Precomputed PCA9685 ticks, key released (hover)
+  uint16_t overshootTicks[noteCount];    // Precomputed PCA9685 ticks, release overshoot
+  uint16_t timerStarts[noteCount];       // millis() (low 16 bits): press time (hold) or release time (overshoot)
+  uint16_t frameTicks[boardCount][PCA_CHANNEL_COUNT]; // Pulse widths waiting to be sent (PCA9685 ticks)
+  uint16_t writtenTicks[boardCount][PCA_CHANNEL_COUNT]; // Shadow of what the PCA9685 holds (0 = unknown)
+  uint16_t dirtyChannels[boardCount];     // Bit n set = channel n changed since last flush
+  BusStats busStats;
+  Mask homedMask;        // Servos at a known position, playable
+  Mask homingGroupMask;  // Servos commanded by the current homing step
+  Mask pressedMask;      // Servos last commanded to press their key
+  uint8_t homingNext;         // Next servo to home
+  unsigned long homingStepTime;
+  unsigned long lastActivityTime;
+  bool parkSaved;             // ParkRecord in EEPROM currently valid
+  Mask settleMask;       // Servos in release overshoot, waiting to settle on hover
+  Mask holdMask;         // Servos released before MIN_NOTE_HOLD_MS, release deferred
+  unsigned long statsWindowStart;
+  uint32_t statsWindowAvoided;  // suppressed + coalesced writes at the start of the window
+  void setServoTicks(uint8_t servoNum, uint16_t ticks); // Sans vérification : servoNum < noteCount
+  bool checkServo(uint8_t servoNum, const char* caller); // SERVO_DEBUG_CHECKS et au-delà
+  void setChannelTicks(uint8_t board, uint8_t channel, uint16_t ticks); // Tampon de trame, écrit par flush()
+  uint16_t angleToTicks(int16_t angle); // constrain + map + conversion, hors du chemin des notes
+  void updateServoTicks(uint8_t servoNum); // À appeler à chaque changement de calibration
+  uint16_t phaseOffset(uint8_t board, uint8_t channel); // Tick de début d'impulsion du canal
+  uint8_t writeChannelBurst(uint8_t board, uint8_t firstChannel, uint8_t count); // returns bytes sent
+  void startHoming();  // utilisé au demarrage pour deplacer les servos en position init-angle
+  void updateHoming(unsigned long now); // Étape suivante du homing, non bloquant
+  void saveParkedState();
+  void clearParkedState();
+  void updateTimers(unsigned long now); // Relâchements différés et fin des dépassements
+  void releaseServo(uint8_t servoNum, unsigned long now);
+  uint16_t estimateTravelMs(uint8_t distance, uint8_t targetDistance); // Modèle cinématique
+  uint8_t activeBank;         // Bank loaded at boot or last saved, NO_BANK = defaults only
+  uint8_t activeSequence;
+  uint8_t imageBank;          // Bank written by the SysEx image transfer
+  static uint16_t bankAddress(uint8_t bank);
+  static uint16_t parkAddress(); // The park record lives right after the two calibration banks
+  bool readBankSequence(uint8_t bank, uint8_t& sequence); // Magic, version and CRC, no copy in RAM
+  void loadBank(uint8_t bank);
+  void sealBank(uint8_t bank, uint8_t sequence); // Writes the sequence number, then the CRC
+  bool migrateLegacyCalibration(); // EEPROM_VERSION 1 to 3: single block, additive checksum
 
 public:
-  ServoController(); //initialise toutles servomoteurs a l'angle de depart
+  ServoControllerT(); //initialise toutles servomoteurs a l'angle de depart
   bool begin(); // Initialize PWM drivers, returns true on success
   bool isReady(); // Check if controllers are properly initialized
-  void noteOff(uint8_t servoNum); // Relâche la touche (position repos)
+  // servoNum < noteCount, vérifié seulement à partir de SERVO_DEBUG_CHECKS (Instrument ne route que des servos valides)
+  void noteOff(uint8_t servoNum, bool immediate = false); // Relâche la touche (position repos), immediate : sans MIN_NOTE_HOLD_MS
   void noteOn(uint8_t servoNum);  // Appuie sur la touche (position fixe)
+  void setAirAngle(uint8_t channel, uint8_t angle); // Valve d'air sur la carte AIR_PCA_BOARD (AIR_ON_PCA), écrite au prochain flush
+  void update(); // Homing et mémorisation du repos, à appeler depuis Instrument::update()
+  bool isHomingComplete();
+  void flush(); // Écrit les canaux modifiés, une rafale I2C par groupe de canaux contigus
+  const BusStats& getBusStats(); // Bytes/transactions per flush and totals
+  void resetBusStats();
+  uint8_t peakConcurrentPulses(); // Max number of pulses high on the same tick, current positions
 
   // Calibration functions
-  bool saveCalibration(); // Save current calibration to EEPROM
-  bool loadCalibration(); // Load calibration from EEPROM
+  bool saveCalibration(); // Save current calibration to the other EEPROM bank
+  bool loadCalibration(); // Load the newest valid bank (or migrate an older layout)
   void setServoCalibration(uint8_t servoNum, uint16_t angle, int8_t direction);
   void resetToDefaultCalibration(); // Reset to factory defaults
-  bool isCalibrationValid(); // Check if EEPROM contains valid data
+  void setMotionProfile(uint8_t servoNum, uint8_t hoverOffset, uint8_t pressTravel, uint8_t releaseOvershoot);
+  void setTravelTime(uint8_t servoNum, uint8_t ms); // Measured command -> sound delay
+  uint8_t getTravelTime(uint8_t servoNum);
+  uint16_t estimatePressMs(uint8_t servoNum);   // Hover -> key down, from the kinematic model
+  uint16_t estimateReleaseMs(uint8_t servoNum); // Key down -> back past the contact point
+  void printMotionProfiles(); // Estimated press/release times per servo vs. the plain 20° travel
+  bool isCalibrationValid(); // A valid bank was found at boot or written since
+
+  // Image de la calibration en EEPROM, octet par octet (transfert SysEx, jamais copiée en RAM)
+  uint16_t calibrationImageSize();
+  uint8_t readCalibrationImage(uint16_t offset);
+  void beginCalibrationImage(); // Écrit dans la banque inactive, invalide jusqu'au commit
+  void writeCalibrationImage(uint16_t offset, uint8_t value); // Seuls les octets modifiés sont écrits
+  bool commitCalibrationImage(); // Valide et charge l'image, sinon la banque active reste en place
 };
 
-#endif // SERVOCONTROLLER_H
+// Chemin des notes, dans l'en-tête pour être intégré à l'appelant (Instrument) : un test du
+// masque de homing, une lecture de table (slot), l'écriture dans le tampon de trame
+
+template <class Config>
+inline void ServoControllerT<Config>::setServoTicks(uint8_t servoNum, uint16_t ticks) {
+  // Internal callers only pass valid servos; before begin() the value just
+  // waits in the shadow table (flush() does nothing until initialized)
+  uint8_t slot = pgm_read_byte(&Tables::slots[servoNum]);
+  setChannelTicks(slot / PCA_CHANNEL_COUNT, slot % PCA_CHANNEL_COUNT, ticks);
+}
+
+template <class Config>
+inline void ServoControllerT<Config>::setChannelTicks(uint8_t board, uint8_t channel, uint16_t ticks) {
+  // A value still waiting for the flush is replaced: one write less on the bus
+  if (dirtyChannels[board] & (1U << channel)) {
+    busStats.coalescedWrites++;
+  }
+  frameTicks[board][channel] = ticks;
+  dirtyChannels[board] |= (1U << channel);
+
+  if (!SERVO_FRAME_MODE) {
+    flush();
+  }
+}
+
+// Active la note avec le servo (position fixe noteOn)
+template <class Config>
+inline void ServoControllerT<Config>::noteOn(uint8_t servoNum) {
+  if (argChecks && !checkServo(servoNum, "noteOn")) {
+    return;
+  }
+
+  // Servo pas encore initialisé par le homing (aucun avant begin())
+  Mask bit = (Mask)1 << servoNum;
+  if (!(homedMask & bit)) {
+    return;
+  }
+
+  // Position fixe pour appuyer sur la touche (table calculée à la calibration)
+  setServoTicks(servoNum, pressTicks[servoNum]);
+  pressedMask |= bit;
+  settleMask &= ~bit;
+  holdMask &= ~bit;
+  lastActivityTime = millis();
+  timerStarts[servoNum] = (uint16_t)lastActivityTime;
+}
+
+// Desactive la note avec le servo
+template <class Config>
+inline void ServoControllerT<Config>::noteOff(uint8_t servoNum, bool immediate) {
+  if (argChecks && !checkServo(servoNum, "noteOff")) {
+    return;
+  }
 
+  // Servo pas encore initialisé par le homing (aucun avant begin())
+  Mask bit = (Mask)1 << servoNum;
+  if (!(homedMask & bit)) {
+    return;
+  }
+
+  lastActivityTime = millis();
+
+  // Pressed too recently: release later so the key has time to sound.
+  // Not for a stolen voice: its current already went to the new note
+  if (!immediate && (pressedMask & bit) && (uint16_t)((uint16_t)lastActivityTime - timerStarts[servoNum]) < MIN_NOTE_HOLD_MS) {
+    holdMask |= bit;
+    return;
+  }
+
+  holdMask &= ~bit;
+  releaseServo(servoNum, lastActivityTime);
+}
+
+template <class Config>
+inline void ServoControllerT<Config>::releaseServo(uint8_t servoNum, unsigned long now) {
+  Mask bit = (Mask)1 << servoNum;
+  pressedMask &= ~bit;
+
+  // Bref dépassement au-delà du survol pour quitter la touche plus vite
+  if (releaseOvershoots[servoNum] != 0) {
+    setServoTicks(servoNum, overshootTicks[servoNum]);
+    timerStarts[servoNum] = (uint16_t)now;
+    settleMask |= bit;
+  } else {
+    setServoTicks(servoNum, releaseTicks[servoNum]);
+  }
+}
+
+// Configuration de settings.h, instanciée dans ServoController.cpp
+typedef ServoConfig<PCA_BOARD_COUNT, NUMBER_OF_NOTES, SettingsServoTables, SERVO_DEBUG_LEVEL> SettingsServoConfig;
+typedef ServoControllerT<SettingsServoConfig> ServoController;
+
+#endif // SERVOCONTROLLER_H
@@ -18,9 +18,12 @@ il va peut etre falloir ajouter un systeme pour attendre le deplacement des serv
 #include <MIDIUSB.h>
 #include "Instrument.h"
 #include "MidiHandler.h"
+#include "LatencyStats.h"
+#include "LoopProfiler.h"
 #include "Arduino.h"
 
-Instrument* instrument= nullptr;
+ServoController* servoController= nullptr;
+Instrument* instruments[INSTRUMENT_COUNT];
 MidiHandler* midiHandler= nullptr;
 
 void setup() {
@@ -29,12 +32,60 @@ void setup() {
   //  delay(10); // Attendre que la connexion série soit établie
   //}
   Serial.println("init");
-  instrument= new Instrument();
-  midiHandler = new MidiHandler(*instrument);
+  // Un seul contrôleur de servos (bus I2C) partagé par les instruments
+  servoController= new ServoController();
+  if (!servoController->begin()) {
+    Serial.println("ERROR: Failed to initialize ServoController!");
+  }
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    instruments[i]= new Instrument(*servoController, i);
+    if (!instruments[i]->begin()) {
+      Serial.println("ERROR: Instrument initialization failed!");
+    }
+  }
+  // Le homing des servos se poursuit dans servoController->update(), le MIDI est lu dès maintenant
+  midiHandler = new MidiHandler(instruments, *servoController);
   Serial.println("fin init");
 }
 
+// Moniteur série : 'l' = histogrammes de latence, 's' = profil de loop(), majuscule = remise à zéro
+void readSerialCommand() {
+  if (!Serial.available()) {
+    return;
+  }
+  switch (Serial.read()) {
+    case 'l':
+      latencyStats.print(Serial);
+      break;
+    case 'L':
+      latencyStats.reset();
+      Serial.println("latency stats reset");
+      break;
+    case 's':
+      loopProfiler.print(Serial);
+      break;
+    case 'S':
+      loopProfiler.reset();
+      Serial.println("loop profiler reset");
+      break;
+  }
+}
+
 void loop() {
+  loopProfiler.begin();
   midiHandler->readMidi();
-  instrument->update();
+  loopProfiler.lap(LOOP_READ);
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    instruments[i]->update();
+  }
+  loopProfiler.lap(LOOP_DISPATCH);
+  // Background homing, release overshoots, then every key change of this
+  // loop iteration (all instruments) sent in as few I2C bursts as possible
+  servoController->update();
+  loopProfiler.lap(LOOP_FLUSH);
+  loopProfiler.end(); // Printing a report is not part of the iteration
+
+  if (LATENCY_STATS || LOOP_PROFILER) {
+    readSerialCommand();
+  }
 }
@@ -0,0 +1,256 @@
+#include "SysExCalibration.h"
+
+SysExCalibration::SysExCalibration(ServoController& controller)
+  : servoController(controller), rxLength(0), rxActive(false), rxOverflow(false),
+    loading(false), nextOffset(0), txCount(0), txTable(SYSEX_TABLE_CALIBRATION) {
+}
+
+void SysExCalibration::receive(midiEventPacket_t packet) {
+  uint8_t count = 3; // CIN 0x4: three bytes, message continues
+  switch (packet.header & 0x0F) {
+    case 0x5: count = 1; break;
+    case 0x6: count = 2; break;
+  }
+  receiveByte(packet.byte1);
+  if (count > 1) {
+    receiveByte(packet.byte2);
+  }
+  if (count > 2) {
+    receiveByte(packet.byte3);
+  }
+}
+
+void SysExCalibration::receiveByte(uint8_t value) {
+  if (value == 0xF0) {
+    rxActive = true;
+    rxOverflow = false;
+    rxLength = 0;
+    return;
+  }
+  if (!rxActive) {
+    return; // Single-byte system common (CIN 0x5), or the rest of a message we dropped
+  }
+  if (value == 0xF7) {
+    rxActive = false;
+    if (!rxOverflow) {
+      handleMessage();
+    }
+    return;
+  }
+  if (value & 0x80) {
+    rxActive = false; // Status byte inside SysEx: message aborted
+    return;
+  }
+  if (rxLength >= SYSEX_BUFFER_SIZE) {
+    rxOverflow = true;
+    return;
+  }
+  rxBuffer[rxLength++] = value;
+}
+
+void SysExCalibration::handleMessage() {
+  if (rxLength < 4 || rxBuffer[0] != SYSEX_MANUFACTURER_ID) {
+    return;
+  }
+  if (rxBuffer[1] != SYSEX_DEVICE_ID && rxBuffer[1] != SYSEX_ALL_DEVICES) {
+    return;
+  }
+
+  uint8_t command = rxBuffer[2];
+  txTable = rxBuffer[3];
+  if (txTable == SYSEX_TABLE_LATENCY) {
+    handleLatency(command);
+    return;
+  }
+  if (txTable != SYSEX_TABLE_CALIBRATION) {
+    sendNak(command, SYSEX_ERROR_TABLE);
+    return;
+  }
+
+  switch (command) {
+    case SYSEX_DUMP:
+      if (loading) {
+        // Saving the defaults for the dump would write the bank being loaded
+        sendNak(command, SYSEX_ERROR_BUSY);
+      } else {
+        sendDump();
+      }
+      break;
+    case SYSEX_BEGIN:
+      if (rxLength != 6) {
+        sendNak(command, SYSEX_ERROR_FORMAT);
+      } else if (((uint16_t)rxBuffer[4] << 7 | rxBuffer[5]) != servoController.calibrationImageSize()) {
+        sendNak(command, SYSEX_ERROR_TABLE); // Built for another NUMBER_OF_NOTES or version
+      } else {
+        servoController.beginCalibrationImage();
+        loading = true;
+        nextOffset = 0;
+        sendAck(command);
+      }
+      break;
+    case SYSEX_DATA:
+      handleData();
+      break;
+    case SYSEX_END:
+      if (!loading || nextOffset != servoController.calibrationImageSize()) {
+        sendNak(command, SYSEX_ERROR_SEQUENCE);
+      } else {
+        loading = false;
+        if (servoController.commitCalibrationImage()) {
+          sendAck(command);
+        } else {
+          sendNak(command, SYSEX_ERROR_INVALID);
+        }
+      }
+      break;
+  }
+}
+
+void SysExCalibration::handleData() {
+  if (rxLength < 8) {
+    sendNak(SYSEX_DATA, SYSEX_ERROR_FORMAT);
+    return;
+  }
+
+  uint8_t count = rxBuffer[6];
+  if (count == 0 || count > SYSEX_CHUNK_SIZE || rxLength != 8 + 2 * count) {
+    sendNak(SYSEX_DATA, SYSEX_ERROR_FORMAT);
+    return;
+  }
+
+  uint16_t offset = (uint16_t)rxBuffer[4] << 7 | rxBuffer[5];
+  if (!loading || offset != nextOffset || offset + count > servoController.calibrationImageSize()) {
+    sendNak(SYSEX_DATA, SYSEX_ERROR_SEQUENCE);
+    return;
+  }
+
+  // Offset, count, nibbles and checksum add up to a multiple of 128
+  uint8_t sum = 0;
+  for (uint8_t i = 4; i < rxLength; i++) {
+    sum += rxBuffer[i];
+  }
+  if (sum & 0x7F) {
+    sendNak(SYSEX_DATA, SYSEX_ERROR_CHECKSUM);
+    return;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t value = (rxBuffer[7 + 2 * i] << 4) | (rxBuffer[8 + 2 * i] & 0x0F);
+    servoController.writeCalibrationImage(offset + i, value);
+  }
+  nextOffset = offset + count;
+  sendAck(SYSEX_DATA);
+}
+
+// Read-only table: dumped like the calibration, nothing to load
+void SysExCalibration::handleLatency(uint8_t command) {
+  if (latencyStats.imageSize() == 0) {
+    sendNak(command, SYSEX_ERROR_TABLE); // Built with LATENCY_STATS 0
+    return;
+  }
+  switch (command) {
+    case SYSEX_DUMP:
+      sendDump();
+      break;
+    case SYSEX_RESET:
+      latencyStats.reset();
+      sendAck(command); // Offset field: that of a calibration load in progress, if any
+      break;
+    default:
+      sendNak(command, SYSEX_ERROR_TABLE);
+      break;
+  }
+}
+
+uint16_t SysExCalibration::tableSize() {
+  if (txTable == SYSEX_TABLE_LATENCY) {
+    return latencyStats.imageSize();
+  }
+  return servoController.calibrationImageSize();
+}
+
+uint8_t SysExCalibration::readTable(uint16_t offset) {
+  if (txTable == SYSEX_TABLE_LATENCY) {
+    return latencyStats.readImage(offset);
+  }
+  return servoController.readCalibrationImage(offset);
+}
+
+void SysExCalibration::sendDump() {
+  uint16_t size = tableSize();
+  if (txTable == SYSEX_TABLE_CALIBRATION && !servoController.isCalibrationValid()) {
+    servoController.saveCalibration(); // Defaults in use: stored first so the dump matches them
+  }
+
+  // Same messages as a load, read from EEPROM one chunk at a time
+  sendHeader(SYSEX_BEGIN);
+  sendByte(size >> 7);
+  sendByte(size & 0x7F);
+  sendByte(0xF7);
+
+  for (uint16_t offset = 0; offset < size; offset += SYSEX_CHUNK_SIZE) {
+    uint8_t count = min((uint16_t)SYSEX_CHUNK_SIZE, (uint16_t)(size - offset));
+    uint8_t sum = (offset >> 7) + (offset & 0x7F) + count;
+
+    sendHeader(SYSEX_DATA);
+    sendByte(offset >> 7);
+    sendByte(offset & 0x7F);
+    sendByte(count);
+    for (uint8_t i = 0; i < count; i++) {
+      uint8_t value = readTable(offset + i);
+      sendByte(value >> 4);
+      sendByte(value & 0x0F);
+      sum += (value >> 4) + (value & 0x0F);
+    }
+    sendByte((128 - (sum & 0x7F)) & 0x7F);
+    sendByte(0xF7);
+  }
+
+  sendHeader(SYSEX_END);
+  sendByte(0xF7);
+  MidiUSB.flush();
+}
+
+// Packs the reply into USB-MIDI SysEx packets: CIN 0x4, then 0x5 to 0x7 with the F7
+void SysExCalibration::sendByte(uint8_t value) {
+  txBytes[txCount++] = value;
+  bool last = (value == 0xF7);
+  if (txCount < 3 && !last) {
+    return;
+  }
+
+  midiEventPacket_t packet = {(uint8_t)(last ? 0x04 + txCount : 0x04), txBytes[0], 0, 0};
+  if (txCount > 1) {
+    packet.byte2 = txBytes[1];
+  }
+  if (txCount > 2) {
+    packet.byte3 = txBytes[2];
+  }
+  MidiUSB.sendMIDI(packet);
+  txCount = 0;
+}
+
+void SysExCalibration::sendHeader(uint8_t command) {
+  sendByte(0xF0);
+  sendByte(SYSEX_MANUFACTURER_ID);
+  sendByte(SYSEX_DEVICE_ID);
+  sendByte(command);
+  sendByte(txTable);
+}
+
+void SysExCalibration::sendAck(uint8_t command) {
+  sendHeader(SYSEX_ACK);
+  sendByte(command);
+  sendByte(nextOffset >> 7);
+  sendByte(nextOffset & 0x7F);
+  sendByte(0xF7);
+  MidiUSB.flush();
+}
+
+void SysExCalibration::sendNak(uint8_t command, uint8_t reason) {
+  sendHeader(SYSEX_NAK);
+  sendByte(command);
+  sendByte(reason);
+  sendByte(0xF7);
+  MidiUSB.flush();
+}
@@ -0,0 +1,93 @@
+#ifndef SYSEXCALIBRATION_H
+#define SYSEXCALIBRATION_H
+
+#include <MIDIUSB.h>
+#include "settings.h"
+#include "ServoController.h"
+#include "LatencyStats.h"
+/***********************************************************************************************
+----------------------------    SysExCalibration.h   ----------------------------------------
+************************************************************************************************
+
+Lecture et écriture de la calibration en SysEx, depuis le DAW, sans reflasher
+
+Messages : F0 7D <appareil> <commande> <table> ... F7
+- 7D : identifiant non commercial, appareil = SYSEX_DEVICE_ID (0x7F = tous)
+- table 0 = CalibrationData telle que stockée en EEPROM (octets bruts, little-endian),
+  les prochaines tables par servo prendront les numéros suivants
+- table 1 = histogrammes de latence (LatencyStats::readImage), lecture seule : DUMP et RESET
+Commandes (hôte -> mélodica) :
+- 01 DUMP    : le mélodica renvoie BEGIN, les DATA et END, rejouables tels quels pour recharger
+             (refusé pendant un chargement : finir par END ou recommencer par BEGIN)
+- 02 BEGIN   <taille 2x7 bits> : ouvre un chargement dans la banque EEPROM inactive
+- 03 DATA    <offset 2x7 bits> <n> <n octets en 2 quartets, poids fort d'abord> <somme>
+             offsets consécutifs, n <= SYSEX_CHUNK_SIZE, somme = complément à 128 des
+             octets depuis l'offset : chaque bloc est vérifié puis écrit aussitôt en EEPROM
+- 04 END     : vérifie version et CRC-16 de CalibrationData, puis l'applique (le numéro
+             de séquence reçu est remplacé pour que cette banque devienne la plus récente)
+- 05 RESET   : table 1, remet les histogrammes à zéro
+Réponses (USB) : 7E ACK <commande> <offset suivant 2x7 bits>, 7F NAK <commande> <raison>
+Un DATA refusé (NAK) peut être renvoyé, un nouveau BEGIN recommence le chargement ; un
+chargement abandonné ou refusé laisse la banque active en place (la RAM n'est modifiée
+qu'au END). Seul un bloc DATA est en RAM. Attendre l'ACK avant le bloc suivant (écriture EEPROM jusqu'à
+~55 ms par bloc) ; sur la prise DIN, qui ne répond pas, espacer les messages d'au moins 60 ms
+
+************************************************************************************************/
+
+#define SYSEX_MANUFACTURER_ID 0x7D
+#define SYSEX_ALL_DEVICES 0x7F
+#define SYSEX_TABLE_CALIBRATION 0
+#define SYSEX_TABLE_LATENCY 1
+
+#define SYSEX_DUMP 0x01
+#define SYSEX_BEGIN 0x02
+#define SYSEX_DATA 0x03
+#define SYSEX_END 0x04
+#define SYSEX_RESET 0x05
+#define SYSEX_ACK 0x7E
+#define SYSEX_NAK 0x7F
+
+// NAK reasons
+#define SYSEX_ERROR_FORMAT 1     // Wrong length or byte count
+#define SYSEX_ERROR_TABLE 2      // Unknown table or size
+#define SYSEX_ERROR_SEQUENCE 3   // No BEGIN, or offset not the next expected one
+#define SYSEX_ERROR_CHECKSUM 4
+#define SYSEX_ERROR_INVALID 5    // Complete image rejected (version, CRC), previous calibration kept
+#define SYSEX_ERROR_BUSY 6       // Calibration DUMP while a load is open (BEGIN without END)
+
+// Manufacturer, device, command, table, offset (2), count, data nibbles, checksum
+#define SYSEX_BUFFER_SIZE (8 + 2 * SYSEX_CHUNK_SIZE)
+
+static_assert(SYSEX_CHUNK_SIZE > 0 && SYSEX_CHUNK_SIZE <= 64, "SYSEX_CHUNK_SIZE must be 1..64");
+
+class SysExCalibration {
+private:
+  ServoController& servoController;
+  uint8_t rxBuffer[SYSEX_BUFFER_SIZE]; // Message after F0, without F7
+  uint8_t rxLength;
+  bool rxActive;                       // Inside a message addressed to anyone
+  bool rxOverflow;                     // Message longer than any valid one, ignored
+  bool loading;                        // Between BEGIN and END
+  uint16_t nextOffset;                 // Next DATA offset expected
+  uint8_t txBytes[3];                  // Reply bytes waiting for a USB-MIDI packet
+  uint8_t txCount;
+  uint8_t txTable;                     // Table of the message being answered
+
+  void receiveByte(uint8_t value);
+  void handleMessage();
+  void handleData();
+  void handleLatency(uint8_t command);
+  uint16_t tableSize();
+  uint8_t readTable(uint16_t offset);
+  void sendDump();
+  void sendByte(uint8_t value);
+  void sendHeader(uint8_t command);
+  void sendAck(uint8_t command);
+  void sendNak(uint8_t command, uint8_t reason);
+
+public:
+  SysExCalibration(ServoController& controller);
+  void receive(midiEventPacket_t packet); // SysEx packets (CIN 0x4 to 0x7), USB or DIN
+};
+
+#endif // SYSEXCALIBRATION_H
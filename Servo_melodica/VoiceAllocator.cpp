@@ -0,0 +1,96 @@
+#include "VoiceAllocator.h"
+
+VoiceAllocator::VoiceAllocator(uint16_t budgetMa) : heldMask(0), budgetMa(budgetMa) {
+  resetStats();
+}
+
+uint16_t VoiceAllocator::drawMa(unsigned long now) {
+  uint16_t draw = 0;
+  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+    if (heldMask & ((ServoMask)1 << i)) {
+      bool moving = now - pressTimes[i] < pressTravels[i];
+      draw += moving ? SERVO_MOVE_MA : SERVO_HOLD_MA;
+    }
+  }
+  return draw;
+}
+
+uint8_t VoiceAllocator::pickVictim(unsigned long now) {
+  uint8_t victim = VOICE_REJECTED;
+  unsigned long victimAge = 0;
+
+  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+    if (!(heldMask & ((ServoMask)1 << i))) {
+      continue;
+    }
+    unsigned long age = now - pressTimes[i];
+    bool better;
+    if (victim == VOICE_REJECTED) {
+      better = true;
+    } else if (VOICE_STEAL_MODE == 2 && velocities[i] != velocities[victim]) {
+      better = velocities[i] < velocities[victim];
+    } else {
+      better = age > victimAge; // oldest, also the tie-break for equal velocities
+    }
+    if (better) {
+      victim = i;
+      victimAge = age;
+    }
+  }
+  return victim;
+}
+
+uint8_t VoiceAllocator::allocate(uint8_t servo, uint8_t velocity, uint16_t travelMs, unsigned long now) {
+  ServoMask bit = (ServoMask)1 << servo;
+
+  // Key already down (re-press): no movement, nothing more to draw
+  if (heldMask & bit) {
+    velocities[servo] = velocity;
+    return VOICE_ADMITTED;
+  }
+
+  uint16_t draw = drawMa(now) + SERVO_MOVE_MA;
+  // Budget 0: no limit, the draw is still measured (peakDrawMa)
+  if (budgetMa > 0 && draw > budgetMa) {
+    uint8_t victim = VOICE_REJECTED;
+    if (VOICE_STEAL_MODE != 0 && SERVO_MOVE_MA <= budgetMa) {
+      victim = pickVictim(now);
+    }
+    if (victim == VOICE_REJECTED) {
+      stats.rejectedNotes++;
+      return VOICE_REJECTED;
+    }
+    stats.stolenNotes++;
+    return victim;
+  }
+
+  if (draw > stats.peakDrawMa) {
+    stats.peakDrawMa = draw;
+  }
+  stats.admittedNotes++;
+
+  heldMask |= bit;
+  pressTimes[servo] = now;
+  pressTravels[servo] = min(travelMs, (uint16_t)255);
+  velocities[servo] = velocity;
+  return VOICE_ADMITTED;
+}
+
+void VoiceAllocator::release(uint8_t servo) {
+  heldMask &= ~((ServoMask)1 << servo);
+}
+
+void VoiceAllocator::clear() {
+  heldMask = 0;
+}
+
+const VoiceStats& VoiceAllocator::getStats() {
+  return stats;
+}
+
+void VoiceAllocator::resetStats() {
+  stats.admittedNotes = 0;
+  stats.rejectedNotes = 0;
+  stats.stolenNotes = 0;
+  stats.peakDrawMa = 0;
+}
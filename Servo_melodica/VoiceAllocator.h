@@ -0,0 +1,52 @@
+#ifndef VOICEALLOCATOR_H
+#define VOICEALLOCATOR_H
+
+#include <Arduino.h>
+#include "settings.h"
+#include "ServoController.h"
+/***********************************************************************************************
+----------------------------    VoiceAllocator.h   ----------------------------------------
+************************************************************************************************
+
+Budget de courant des servos de touches d'un instrument (part de POWER_BUDGET_MA)
+
+Chaque touche tenue coûte SERVO_MOVE_MA pendant sa course puis SERVO_HOLD_MA tant qu'elle
+reste enfoncée. Le retour au repos, aidé par le ressort de la touche, n'est pas compté.
+Si une nouvelle note dépasse le budget, elle est refusée ou une voix est volée
+(la plus ancienne ou la plus douce, VOICE_STEAL_MODE).
+
+************************************************************************************************/
+
+#define VOICE_ADMITTED 0xFE   // allocate(): la note peut être jouée
+#define VOICE_REJECTED 0xFF   // allocate(): budget dépassé, note refusée
+
+// Counters to size the supply from real repertoire
+struct VoiceStats {
+  uint32_t admittedNotes;   // Notes played within the budget
+  uint32_t rejectedNotes;   // Notes dropped (VOICE_STEAL_MODE 0, or nothing left to steal)
+  uint32_t stolenNotes;     // Held notes released early to make room
+  uint16_t peakDrawMa;      // Highest estimated draw, new note included
+};
+
+class VoiceAllocator {
+private:
+  ServoMask heldMask;                         // Keys counted in the budget
+  unsigned long pressTimes[NUMBER_OF_NOTES];  // millis() at press, oldest = longest held (a drone too)
+  uint8_t pressTravels[NUMBER_OF_NOTES];      // Estimated press time (ms), moving cost until then
+  uint8_t velocities[NUMBER_OF_NOTES];        // For VOICE_STEAL_MODE 2
+  VoiceStats stats;
+  uint16_t budgetMa;                          // 0 = no limit
+  uint16_t drawMa(unsigned long now);         // Estimated current of the held keys
+  uint8_t pickVictim(unsigned long now);      // Voice to steal, VOICE_REJECTED if none
+
+public:
+  VoiceAllocator(uint16_t budgetMa);
+  // VOICE_ADMITTED (servo now counted), VOICE_REJECTED, or the servo to release before retrying
+  uint8_t allocate(uint8_t servo, uint8_t velocity, uint16_t travelMs, unsigned long now);
+  void release(uint8_t servo);
+  void clear();
+  const VoiceStats& getStats();
+  void resetStats();
+};
+
+#endif // VOICEALLOCATOR_H
@@ -1,41 +1,92 @@
 #include "Instrument.h"
+#include "LoopProfiler.h"
+
+// Index of the highest set bit, constant time without a CLZ instruction (AVR)
+static uint8_t highestBit(uint32_t mask) {
+  static const uint8_t nibbleHighest[16] = {0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3};
+  uint8_t bit = 0;
+  if (mask & 0xFFFF0000UL) { bit += 16; mask >>= 16; }
+  if (mask & 0xFF00) { bit += 8; mask >>= 8; }
+  if (mask & 0xF0) { bit += 4; mask >>= 4; }
+  return bit + nibbleHighest[mask & 0x0F];
+}
+
+// Air angle of a velocity bucket, from its lower edge: 1-3 -> AIR_MIN_ANGLE, 124-127 -> AIR_MAX_ANGLE.
+// Same value for the first note (openAir) and the held notes (updateAirFlow)
+static uint8_t bucketAirAngle(uint8_t bucket) {
+  return map(bucket << VELOCITY_BUCKET_SHIFT, 0, 128 - (1 << VELOCITY_BUCKET_SHIFT), AIR_MIN_ANGLE, AIR_MAX_ANGLE);
+}
 
-Instrument::Instrument() : servoController(), activeNotesCount(0), currentVolume(127), currentAirAngle(AIR_CLOSED_ANGLE) {
-  if (DEBUG) {
+// Servo ranges must exist and not overlap
+constexpr bool rangeFree(int instrument, int other) {
+  return other >= INSTRUMENT_COUNT
+      || ((instrumentFirstServo[other] >= instrumentFirstServo[instrument] + instrumentServoCount[instrument]
+           || instrumentFirstServo[instrument] >= instrumentFirstServo[other] + instrumentServoCount[other])
+          && rangeFree(instrument, other + 1));
+}
+constexpr bool rangesValidFrom(int instrument, int notes) {
+  return instrument >= INSTRUMENT_COUNT
+      || (instrumentFirstServo[instrument] + instrumentServoCount[instrument] <= notes
+          && rangeFree(instrument, instrument + 1) && rangesValidFrom(instrument + 1, notes));
+}
+
+template <class Servos>
+InstrumentT<Servos>::InstrumentT(Servos& controller, uint8_t instrumentIndex)
+  : servoController(controller), index(instrumentIndex), voices(POWER_BUDGET_MA / INSTRUMENT_COUNT),
+    activeNotesCount(0), velocityBucketMask(0), currentVolume(127), currentAirAngle(AIR_CLOSED_ANGLE),
+    airReadyTime(0), airCloseTime(0), airClosePending(false), lastOnsetLatency(0) {
+  static_assert(rangesValidFrom(0, noteCount), "instrument servo ranges out of range or overlapping");
+  if (verbose) {
     Serial.println("DEBUG: Instrument--creation");
   }
 
-  // Initialize air servo
-  airServo.attach(AIR_SERVO_PIN);
-  closeAir();
+  // Initialize air servo (on the PCA9685, the valve is closed in begin())
+  if (!AIR_ON_PCA) {
+    airServo.attach(instrumentAirPin[index]);
+    closeAir();
+  }
 
   // Initialize active notes array
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+  for (uint8_t i = 0; i < noteCount; i++) {
     activeNotes[i] = false;
   }
+  for (uint8_t b = 0; b < VELOCITY_BUCKETS; b++) {
+    velocityBucketCounts[b] = 0;
+  }
 }
 
-bool Instrument::begin() {
+template <class Servos>
+bool InstrumentT<Servos>::begin() {
   Serial.println("Initializing Instrument...");
 
-  // Initialize servo controller
-  if (!servoController.begin()) {
-    Serial.println("ERROR: Failed to initialize ServoController!");
+  // The servo controller is shared, the sketch begins it first
+  if (!servoController.isReady()) {
+    Serial.println("ERROR: ServoController not initialized!");
     return false;
   }
 
+  if (AIR_ON_PCA) {
+    closeAir();
+  }
+
   Serial.println("Instrument initialized successfully");
   return true;
 }
 
-int Instrument::getServo(uint8_t midiNote) {
-  // Returns the servo number (0 to NUMBER_OF_NOTES-1) for the given MIDI note
+template <class Servos>
+int InstrumentT<Servos>::getServo(uint8_t midiNote) {
+  // Returns the servo number (0 to noteCount-1) for the given MIDI note
   // Returns -1 if the note is not playable
-  if ((midiNote >= FIRST_MIDI_NOTE) && (midiNote < (FIRST_MIDI_NOTE + NUMBER_OF_NOTES))) {
-    int servoAJouer = midiNote - FIRST_MIDI_NOTE;
-    return servoAJouer;
+  // Transposition, octave folding and key layout are precomputed in noteRouting,
+  // the key is then placed in this instrument's servo range
+  int16_t note = midiNote + instrumentTranspose[index];
+  if (note >= 0 && note <= 127) {
+    uint8_t key = pgm_read_byte(&noteRouting[note]);
+    if (key != NO_SERVO && key < instrumentServoCount[index]) {
+      return instrumentFirstServo[index] + key;
+    }
   }
-  if (DEBUG) {
+  if (verbose) {
     Serial.print("DEBUG: MIDI note ");
     Serial.print(midiNote);
     Serial.println(" not playable");
@@ -43,61 +94,200 @@ int Instrument::getServo(uint8_t midiNote) {
   return -1;
 }
 
-void Instrument::noteOn(uint8_t midiNote, uint8_t velocity) {
+template <class Servos>
+void InstrumentT<Servos>::noteOn(uint8_t midiNote, uint8_t velocity) {
+  noteOnAt(midiNote, velocity, millis());
+}
+
+template <class Servos>
+void InstrumentT<Servos>::noteOff(uint8_t midiNote) {
+  noteOffAt(midiNote, millis());
+}
+
+template <class Servos>
+void InstrumentT<Servos>::noteOnAt(uint8_t midiNote, uint8_t velocity, unsigned long arrivalTime) {
   int servo = getServo(midiNote);
   if (servo != -1) {
     // Apply volume scaling to velocity (for air servo only)
     uint8_t scaledVelocity = (velocity * currentVolume) / 127;
+    if (scaledVelocity == 0) {
+      scaledVelocity = 1; // 0 means note off in the scheduler
+    }
+    unsigned long now = millis();
+    unsigned long fireTime = arrivalTime;
 
-    // Appuie sur la touche (position fixe, pas de vélocité)
-    servoController.noteOn(servo);
+    // Servo lent => commandé plus tôt, toutes les notes sonnent à réception + NOTE_FIXED_DELAY_MS
+    if (NOTE_FIXED_DELAY_MS > 0) {
+      fireTime = arrivalTime + NOTE_FIXED_DELAY_MS - servoController.getTravelTime(servo);
+    }
 
-    // Track active notes
-    if (!activeNotes[servo]) {
-      activeNotes[servo] = true;
-      activeNotesCount++;
+    // Après un silence l'air part en premier, la touche attend que la valve soit ouverte
+    airClosePending = false;
+    if (currentAirAngle == AIR_CLOSED_ANGLE) {
+      openAir(midiNote, scaledVelocity);
+      airReadyTime = now + AIR_ANTICIPATION_MS;
     }
+    fireTime = afterAirReady(fireTime, now);
 
-    // Vélocité gérée uniquement par le servo d'air
-    openAir(midiNote, scaledVelocity);
+    lastOnsetLatency = ((long)(fireTime - arrivalTime) > 0) ? fireTime - arrivalTime : 0;
+    dispatchKey(servo, scaledVelocity, fireTime, now);
   }
 }
 
-void Instrument::noteOff(uint8_t midiNote) {
+template <class Servos>
+void InstrumentT<Servos>::noteOffAt(uint8_t midiNote, unsigned long arrivalTime) {
   int servo = getServo(midiNote);
   if (servo != -1) {
-    // Remet le servo à sa position initiale
-    servoController.noteOff(servo);
-
-    // Track active notes
-    if (activeNotes[servo]) {
-      activeNotes[servo] = false;
-      if (activeNotesCount > 0) {
-        activeNotesCount--;
+    unsigned long now = millis();
+    unsigned long fireTime = arrivalTime;
+
+    // Same offset as the press: the note keeps its duration
+    if (NOTE_FIXED_DELAY_MS > 0) {
+      fireTime = arrivalTime + NOTE_FIXED_DELAY_MS - servoController.getTravelTime(servo);
+    }
+
+    // Never before a press still waiting for the air
+    dispatchKey(servo, 0, afterAirReady(fireTime, now), now);
+  }
+}
+
+template <class Servos>
+unsigned long InstrumentT<Servos>::afterAirReady(unsigned long fireTime, unsigned long now) {
+  if ((long)(airReadyTime - now) > 0 && (long)(fireTime - airReadyTime) < 0) {
+    return airReadyTime;
+  }
+  return fireTime;
+}
+
+template <class Servos>
+void InstrumentT<Servos>::dispatchKey(uint8_t servo, uint8_t velocity, unsigned long fireTime, unsigned long now) {
+  if ((long)(fireTime - now) > 0) {
+    if (scheduler.schedule(fireTime, servo, velocity)) {
+      return;
+    }
+
+    // File pleine : jamais avant un événement encore en attente pour cette touche.
+    // Un relâchement annule l'appui en attente (la note ne sonne pas), un appui est abandonné.
+    if (scheduler.hasPending(servo)) {
+      if (velocity == 0 && scheduler.cancelPress(servo) && activeNotesCount == 0 && scheduler.size() == 0) {
+        airClosePending = true; // Nothing left to press: the valve opened for this note closes
+        airCloseTime = now + AIR_HANG_MS;
       }
+      return;
     }
+  }
 
-    // Close air if no more notes are playing
-    if (activeNotesCount == 0) {
+  // Due now, or queue full with nothing queued for this key
+  if (velocity > 0) {
+    pressKey(servo, velocity);
+  } else {
+    releaseKey(servo);
+  }
+}
+
+template <class Servos>
+void InstrumentT<Servos>::pressKey(uint8_t servo, uint8_t velocity) {
+  // Budget de courant : relâche des voix jusqu'à ce que la note tienne, ou la refuse
+  uint8_t voice;
+  while ((voice = voices.allocate(servo, velocity, servoController.estimatePressMs(servo), millis())) != VOICE_ADMITTED) {
+    if (voice == VOICE_REJECTED) {
+      if (verbose) {
+        Serial.print("Power budget: note rejected, servo ");
+        Serial.println(servo);
+      }
+      return;
+    }
+    if (verbose) {
+      Serial.print("Power budget: servo ");
+      Serial.print(voice);
+      Serial.print(" stolen for servo ");
+      Serial.println(servo);
+    }
+    releaseKey(voice, true);
+  }
+
+  // Appuie sur la touche (position fixe, pas de vélocité)
+  latencyStats.keyCommanded();
+  servoController.noteOn(servo);
+
+  // Track active notes
+  if (!activeNotes[servo]) {
+    activeNotes[servo] = true;
+    activeNotesCount++;
+  } else {
+    removeHeldVelocity(servo); // re-pressed with a new velocity
+  }
+  addHeldVelocity(servo, velocity);
+
+  // Vélocité gérée uniquement par le servo d'air : niveau de la note tenue la plus forte
+  airClosePending = false;
+  updateAirFlow();
+}
+
+template <class Servos>
+void InstrumentT<Servos>::addHeldVelocity(uint8_t servo, uint8_t velocity) {
+  uint8_t bucket = velocity >> VELOCITY_BUCKET_SHIFT;
+  noteVelocities[servo] = velocity;
+  velocityBucketCounts[bucket]++;
+  velocityBucketMask |= (1UL << bucket);
+}
+
+template <class Servos>
+void InstrumentT<Servos>::removeHeldVelocity(uint8_t servo) {
+  uint8_t bucket = noteVelocities[servo] >> VELOCITY_BUCKET_SHIFT;
+  if (velocityBucketCounts[bucket] > 0 && --velocityBucketCounts[bucket] == 0) {
+    velocityBucketMask &= ~(1UL << bucket);
+  }
+}
+
+template <class Servos>
+void InstrumentT<Servos>::releaseKey(uint8_t servo, bool stolen) {
+  // Remet le servo à sa position initiale
+  latencyStats.keyCommanded();
+  servoController.noteOff(servo, stolen);
+  voices.release(servo);
+
+  // Track active notes
+  if (activeNotes[servo]) {
+    activeNotes[servo] = false;
+    removeHeldVelocity(servo);
+    if (activeNotesCount > 0) {
+      activeNotesCount--;
+    }
+  }
+
+  // Loudest note released: follow the remaining ones down
+  if (activeNotesCount > 0) {
+    updateAirFlow();
+  }
+
+  // Close air if no more notes are playing, after the hang time
+  if (activeNotesCount == 0) {
+    if (AIR_HANG_MS == 0) {
       closeAir();
+    } else {
+      airClosePending = true;
+      airCloseTime = millis() + AIR_HANG_MS;
     }
   }
 }
 
-void Instrument::openAir(uint8_t note, uint8_t velocity) {
+template <class Servos>
+void InstrumentT<Servos>::openAir(uint8_t note, uint8_t velocity) {
   // Ouvre la valve d'air en fonction de la vélocité
   // Plus la vélocité est forte, plus l'angle d'ouverture est grand
 
-  // Map velocity (0-127) to air servo angle (AIR_MIN_ANGLE to AIR_MAX_ANGLE)
-  uint8_t targetAngle = map(velocity, 1, 127, AIR_MIN_ANGLE, AIR_MAX_ANGLE);
+  // Map velocity (0-127) to air servo angle (AIR_MIN_ANGLE to AIR_MAX_ANGLE), by bucket as
+  // updateAirFlow() does: pressKey() then finds the angle already written
+  uint8_t targetAngle = bucketAirAngle(velocity >> VELOCITY_BUCKET_SHIFT);
 
   // Si l'angle demandé est supérieur à l'angle actuel, mettre à jour
   if (targetAngle > currentAirAngle) {
     currentAirAngle = targetAngle;
-    airServo.write(currentAirAngle);
+    writeAirAngle();
   }
 
-  if (DEBUG) {
+  if (verbose) {
     Serial.print("Air opened - Note: ");
     Serial.print(note);
     Serial.print(" Velocity: ");
@@ -109,45 +299,183 @@ void Instrument::openAir(uint8_t note, uint8_t velocity) {
   }
 }
 
-void Instrument::closeAir() {
+template <class Servos>
+void InstrumentT<Servos>::closeAir() {
   // Ferme la valve d'air
+  airClosePending = false;
   currentAirAngle = AIR_CLOSED_ANGLE;
-  airServo.write(currentAirAngle);
+  writeAirAngle();
 
-  if (DEBUG) {
+  if (verbose) {
     Serial.println("Air closed - No active notes");
   }
 }
 
-void Instrument::updateAirFlow() {
+template <class Servos>
+void InstrumentT<Servos>::writeAirAngle() {
+  // Sur le PCA9685 l'angle part avec la trame des touches, sinon directement sur la pin
+  loopProfiler.lap(LOOP_DISPATCH);
+  if (AIR_ON_PCA) {
+    servoController.setAirAngle(instrumentAirChannel[index], currentAirAngle);
+  } else {
+    airServo.write(currentAirAngle);
+  }
+  loopProfiler.lap(LOOP_AIR);
+}
+
+template <class Servos>
+void InstrumentT<Servos>::updateAirFlow() {
   // Met à jour le débit d'air en fonction des notes actives
-  // Trouve la vélocité maximale parmi les notes actives
-  // et ajuste l'angle du servo en conséquence
+  // La vélocité maximale parmi les notes actives est le bit le plus haut du masque des seaux
 
-  if (activeNotesCount == 0) {
-    closeAir();
-  } else {
-    // L'angle est déjà défini par openAir() lors du noteOn
-    // Cette fonction peut être utilisée pour ajustements dynamiques
+  if (velocityBucketMask == 0) {
+    return; // plus de note tenue : la fermeture passe par le hang time
+  }
+
+  // Lower edge of the highest bucket (4-velocity buckets, ~2° of air angle)
+  uint8_t maxVelocity = highestBit(velocityBucketMask) << VELOCITY_BUCKET_SHIFT;
+  uint8_t targetAngle = bucketAirAngle(highestBit(velocityBucketMask));
+
+  if (targetAngle != currentAirAngle) {
+    currentAirAngle = targetAngle;
+    writeAirAngle();
+
+    if (verbose) {
+      Serial.print("Air level - Max velocity: ");
+      Serial.print(maxVelocity);
+      Serial.print(" Angle: ");
+      Serial.print(currentAirAngle);
+      Serial.print(" Active notes: ");
+      Serial.println(activeNotesCount);
+    }
   }
 }
 
-void Instrument::update() {
+template <class Servos>
+void InstrumentT<Servos>::update() {
   // This method can be called regularly from the main loop
   // for any time-based operations like:
   // - Envelope control
   // - Pressure management
   // - LED indicators
-  // Currently empty but ready for future enhancements
+
+  unsigned long now = millis();
+
+  // Events queued by the MIDI transport since the last call
+  MidiEvent midiEvent;
+  while (midiEvents.pop(midiEvent)) {
+    // Full arrival time rebuilt from its low 16 bits (events wait far less than 65 s)
+    unsigned long arrivalTime = now - (uint16_t)((uint16_t)now - midiEvent.timestamp);
+#if LATENCY_STATS
+    latencyStats.dispatch(midiEvent.transport, midiEvent.received);
+#endif
+    handleEvent(midiEvent, arrivalTime);
+    latencyStats.release();
+  }
+
+  // Scheduled notes whose time has come (fixed delay mode)
+  ScheduledNote event;
+  while (scheduler.popDue(now, event)) {
+#if LATENCY_STATS
+    latencyStats.resume(event.latency);
+#endif
+    if (event.velocity > 0) {
+      pressKey(event.servo, event.velocity);
+    } else {
+      releaseKey(event.servo);
+    }
+    latencyStats.release();
+  }
+
+  // Short gaps keep the valve open, a real silence closes it
+  if (airClosePending && activeNotesCount == 0 && (long)(now - airCloseTime) >= 0) {
+    closeAir();
+  }
+}
+
+template <class Servos>
+MidiEventRing& InstrumentT<Servos>::eventRing() {
+  return midiEvents;
+}
+
+template <class Servos>
+const VoiceStats& InstrumentT<Servos>::getVoiceStats() {
+  return voices.getStats();
+}
+
+template <class Servos>
+uint16_t InstrumentT<Servos>::getLastOnsetLatency() {
+  return lastOnsetLatency;
+}
+
+template <class Servos>
+void InstrumentT<Servos>::handleEvent(const MidiEvent& event, unsigned long arrivalTime) {
+  switch (event.status & 0xF0) {
+    case 0x90: // Note On
+      if (event.data2 > 0) {
+        noteOnAt(event.data1, event.data2, arrivalTime);
+      } else {
+        // Note Off
+        noteOffAt(event.data1, arrivalTime);
+      }
+      break;
+    case 0x80: // Note Off
+      noteOffAt(event.data1, arrivalTime);
+      break;
+    case 0xB0: // Control Change
+      controlChange(event.data1, event.data2);
+      break;
+    case 0xE0: // Pitch Bend
+      pitchBend(((event.data2 << 7) | event.data1) - 8192);
+      break;
+  }
 }
 
 // ========== ADDITIONAL MIDI MESSAGE HANDLERS ==========
 
-void Instrument::allNotesOff() {
+template <class Servos>
+void InstrumentT<Servos>::controlChange(uint8_t controller, uint8_t value) {
+  // Handle Control Change messages
+  switch (controller) {
+    case 1:   // Modulation wheel
+    case 91:  // Reverb depth
+    case 92:  // Tremolo depth
+    case 94:  // Detune depth
+      modulationWheel(value);
+      break;
+    case 0x07: // Volume (CC 7)
+      volumeControl(value);
+      break;
+    case 121: // Reset all controllers
+      reset();
+      break;
+    case 123: // All notes off
+      allNotesOff();
+      break;
+    case 120: // All sound off (similar to all notes off)
+      allNotesOff();
+      break;
+    // Add more cases as needed for other control changes
+    default:
+      if (verbose) {
+        Serial.print("Unhandled CC: ");
+        Serial.print(controller);
+        Serial.print(" Value: ");
+        Serial.println(value);
+      }
+      break;
+  }
+}
+
+template <class Servos>
+void InstrumentT<Servos>::allNotesOff() {
   // CC 123 - Stop all notes immediately (panic button)
   Serial.println("MIDI: All Notes Off");
 
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+  // Drop pending notes too
+  scheduler.clear();
+
+  for (uint8_t i = 0; i < noteCount; i++) {
     if (activeNotes[i]) {
       servoController.noteOff(i);
       activeNotes[i] = false;
@@ -155,10 +483,28 @@ void Instrument::allNotesOff() {
   }
 
   activeNotesCount = 0;
+  voices.clear();
+  for (uint8_t b = 0; b < VELOCITY_BUCKETS; b++) {
+    velocityBucketCounts[b] = 0;
+  }
+  velocityBucketMask = 0;
   closeAir();
+
+  // End of a piece: report what the power budget did
+  const VoiceStats& stats = voices.getStats();
+  Serial.print("Voices - admitted: ");
+  Serial.print(stats.admittedNotes);
+  Serial.print(" rejected: ");
+  Serial.print(stats.rejectedNotes);
+  Serial.print(" stolen: ");
+  Serial.print(stats.stolenNotes);
+  Serial.print(" peak draw: ");
+  Serial.print(stats.peakDrawMa);
+  Serial.println(" mA");
 }
 
-void Instrument::reset() {
+template <class Servos>
+void InstrumentT<Servos>::reset() {
   // CC 121 - Reset all controllers to default state
   Serial.println("MIDI: Reset All Controllers");
 
@@ -172,11 +518,12 @@ void Instrument::reset() {
   // servoController.resetToDefaultCalibration();
 }
 
-void Instrument::volumeControl(uint8_t value) {
+template <class Servos>
+void InstrumentT<Servos>::volumeControl(uint8_t value) {
   // CC 7 - Master volume control (0-127)
   currentVolume = value;
 
-  if (DEBUG) {
+  if (verbose) {
     Serial.print("MIDI: Volume set to ");
     Serial.println(value);
   }
@@ -185,11 +532,12 @@ void Instrument::volumeControl(uint8_t value) {
   // No need to adjust currently playing notes for melodica
 }
 
-void Instrument::modulationWheel(uint8_t value) {
+template <class Servos>
+void InstrumentT<Servos>::modulationWheel(uint8_t value) {
   // CC 1, 91, 92, 94 - Modulation/Effects
   // For melodica, could control vibrato or pressure variation
 
-  if (DEBUG) {
+  if (verbose) {
     Serial.print("MIDI: Modulation value ");
     Serial.println(value);
   }
@@ -200,12 +548,13 @@ void Instrument::modulationWheel(uint8_t value) {
   // Currently logged for future enhancement
 }
 
-void Instrument::pitchBend(int16_t value) {
+template <class Servos>
+void InstrumentT<Servos>::pitchBend(int16_t value) {
   // Pitch bend message (-8192 to +8191)
   // For melodica, this is difficult to implement mechanically
   // Could slightly adjust servo pressure for subtle pitch variation
 
-  if (DEBUG) {
+  if (verbose) {
     Serial.print("MIDI: Pitch bend value ");
     Serial.println(value);
   }
@@ -215,4 +564,7 @@ void Instrument::pitchBend(int16_t value) {
   // 2. Momentarily open/close adjacent keys (complex)
   // 3. Control air pressure (if system supports it)
   // Currently logged for future enhancement
-}
\ No newline at end of file
+}
+
+// The instruments of this sketch (settings.h)
+template class InstrumentT<ServoController>;
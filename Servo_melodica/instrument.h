@@ -3,6 +3,10 @@
 
 #include "settings.h"
 #include "ServoController.h"
+#include "NoteScheduler.h"
+#include "MidiEventRing.h"
+#include "VoiceAllocator.h"
+#include "NoteRouting.h"
 #include <Servo.h>
 /***********************************************************************************************
 ----------------------------    instrument.h   ----------------------------------------
@@ -11,27 +15,66 @@
 execute les messages noteOn et noteOff
 
 ************************************************************************************************/
-class Instrument {
+
+// Vélocités des notes tenues rangées par seaux de 4 (32 seaux, un bit par seau non vide)
+#define VELOCITY_BUCKET_SHIFT 2
+#define VELOCITY_BUCKETS (128 >> VELOCITY_BUCKET_SHIFT)
+
+// Un instrument par configuration de ServoController (ServoConfig) : même nombre de servos et
+// même niveau de debug, fixés à la compilation
+template <class Servos>
+class InstrumentT {
+  static_assert(Servos::noteCount <= NUMBER_OF_NOTES, "noteRouting and VoiceAllocator are sized for NUMBER_OF_NOTES servos");
+
+public:
+  static const uint8_t noteCount = Servos::noteCount;
+
 private:
-  ServoController servoController;
-  Servo airServo;            // Servo pour contrôle du débit d'air
+  static const bool verbose = Servos::debugLevel >= SERVO_DEBUG_VERBOSE;
+  Servos& servoController; // Partagé par tous les instruments (un seul bus I2C)
+  uint8_t index;             // Configuration de l'instrument dans settings.h (instrumentFirstServo...)
+  NoteScheduler scheduler;   // noteOn/noteOff en attente (mode délai fixe)
+  VoiceAllocator voices;     // Budget de courant des touches tenues
+  MidiEventRing midiEvents;  // Événements déposés par le transport, consommés dans update()
+  Servo airServo;            // Servo pour contrôle du débit d'air (AIR_ON_PCA 0)
   uint8_t activeNotesCount;  // Track number of active notes
-  bool activeNotes[NUMBER_OF_NOTES];  // Track which notes are active
+  bool activeNotes[noteCount];  // Track which notes are active
+  uint8_t noteVelocities[noteCount];      // Scaled velocity of each held note
+  uint8_t velocityBucketCounts[VELOCITY_BUCKETS]; // Held notes per velocity bucket
+  uint32_t velocityBucketMask;  // Bit n set = bucket n not empty, max velocity = highest bit
   uint8_t currentVolume;     // Current master volume (0-127)
   uint8_t currentAirAngle;   // Current air servo angle
-  int getServo(uint8_t midiNote); //renvoit le numero du servo de 1 a 32 et 0 si la note ne peut pas etre jouée
+  unsigned long airReadyTime; // Valve assez ouverte pour jouer (anticipation après un silence)
+  unsigned long airCloseTime; // Fermeture prévue de la valve (hang time)
+  bool airClosePending;
+  uint16_t lastOnsetLatency; // Réception -> commande de la touche du dernier noteOn (ms)
+  int getServo(uint8_t midiNote); //renvoit le numero du servo (table noteRouting) et -1 si la note ne peut pas etre jouée
   void openAir(uint8_t note, uint8_t velocity); // ouvre l'air en fonction de la note et de la velocité
   void closeAir(); // ferme les valves d'air
+  void writeAirAngle(); // Envoie currentAirAngle au PCA9685 ou au servo de la pin
   void updateAirFlow(); // Met à jour le débit d'air selon les notes actives
+  void addHeldVelocity(uint8_t servo, uint8_t velocity);
+  void removeHeldVelocity(uint8_t servo);
+  void pressKey(uint8_t servo, uint8_t velocity); // Actionne le servo et l'air, immédiatement
+  void releaseKey(uint8_t servo, bool stolen = false); // stolen : relâchée tout de suite, même juste appuyée
+  void dispatchKey(uint8_t servo, uint8_t velocity, unsigned long fireTime, unsigned long now); // Immédiat ou planifié
+  unsigned long afterAirReady(unsigned long fireTime, unsigned long now); // Pas de touche avant l'air
+  void handleEvent(const MidiEvent& event, unsigned long arrivalTime); // Décode un événement de la file
+  void noteOnAt(uint8_t midiNote, uint8_t velocity, unsigned long arrivalTime);
+  void noteOffAt(uint8_t midiNote, unsigned long arrivalTime);
 
 public:
-  Instrument();
-  bool begin(); // Initialize instrument, returns true on success
+  InstrumentT(Servos& controller, uint8_t instrumentIndex);
+  bool begin(); // Initialize instrument (controller begun by the sketch), returns true on success
   void noteOn(uint8_t midiNote, uint8_t velocity);
   void noteOff(uint8_t midiNote);
   void update();
+  MidiEventRing& eventRing(); // Côté transport : push() uniquement
+  uint16_t getLastOnsetLatency(); // ms between noteOn reception and key command
+  const VoiceStats& getVoiceStats(); // Notes admitted, rejected and stolen by the power budget
 
   // Additional MIDI message handlers
+  void controlChange(uint8_t controller, uint8_t value); // Dispatch CC messages
   void allNotesOff(); // CC 123 - Stop all notes immediately
   void reset(); // CC 121 - Reset all controllers
   void volumeControl(uint8_t value); // CC 7 - Master volume
@@ -39,4 +82,7 @@ public:
   void pitchBend(int16_t value); // Pitch bend message
 };
 
+// Instruments of this sketch, on the settings.h controller (instantiated in instrument.cpp)
+typedef InstrumentT<ServoController> Instrument;
+
 #endif // INSTRUMENT_H
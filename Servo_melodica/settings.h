@@ -6,24 +6,112 @@
 
 #include "stdint.h"
 #define DEBUG 0
+// Niveau de debug de ServoController et des instruments, paramètre de template (ServoConfig) :
+// 0 = chemin des notes sans test (les tables de routage et la configuration sont vérifiées à la
+// compilation), 1 = + vérification du numéro de servo à chaque note, 2 = + messages série
+#define SERVO_DEBUG_LEVEL (DEBUG ? 2 : 0)
 
 //------------------------------------------- EEPROM Settings ---------------------
 #define EEPROM_MAGIC_NUMBER 0xA5B7  // Magic number to verify EEPROM data validity
-#define EEPROM_VERSION 1            // Version of EEPROM data structure
-#define EEPROM_START_ADDRESS 0      // Starting address in EEPROM
+#define EEPROM_VERSION 4            // Version of EEPROM data structure (4 = A/B banks + CRC-16)
+                                    // versions 1 to 3 are migrated at boot
+#define EEPROM_START_ADDRESS 0      // Starting address in EEPROM (bank A, then bank B, then rest positions)
 
 // ------------------------------------------- MIDI -------------------------------
 #define NUMBER_OF_NOTES 32
 //note la plus grave du melodica
 #define FIRST_MIDI_NOTE 65
 
+// Routage note MIDI -> servo, calculé à la compilation (table de 128 entrées, voir NoteRouting.h)
+#define NUMBER_OF_KEYS 32         // Touches du mélodica (32, 37...), toutes n'ont pas forcément un servo
+#define TRANSPOSE 0               // Demi-tons ajoutés aux notes reçues
+#define OCTAVE_FOLDING 0          // 1 = note hors tessiture rejouée à l'octave la plus proche, 0 = ignorée
+#define NO_SERVO 0xFF             // Touche sans servo dans keyLayout
+// Servo de chaque touche, de la plus grave (FIRST_MIDI_NOTE) à la plus aiguë : à modifier pour
+// un faisceau recâblé ou un autre clavier, sans toucher au code
+constexpr uint8_t keyLayout[NUMBER_OF_KEYS] {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31};
+
+// MIDI DIN 5 broches (optocoupleur sur RX pin 0), lu en plus de l'USB
+// La file se remplit pendant que loop() est bloquée : une écriture EEPROM coûte 3,3 ms par
+// octet (calibration complète jusqu'à ~0,8 s, bloc SysEx ~53 ms). Un flux DIN plus dense que
+// la file pendant ce temps perd des octets, comptés par DinMidiInput::getOverflowCount()
+#ifndef DIN_MIDI_ENABLED
+#define DIN_MIDI_ENABLED 0        // 1 = réception sur l'UART (Serial1 indisponible pour autre chose)
+#endif
+#define DIN_MIDI_BAUD 31250
+#define DIN_RX_BUFFER_SIZE 64     // Octets (puissance de 2, max 128) : 20 ms de flux continu
+
+// Calibration par SysEx depuis le DAW (protocole dans SysExCalibration.h)
+#define SYSEX_DEVICE_ID 0x00      // Numéro de ce mélodica (0x00-0x7E), 0x7F dans un message = tous
+#define SYSEX_CHUNK_SIZE 16       // Octets de calibration par message DATA (tampon RAM : 2 x taille + 8)
+
+// File d'événements entre le transport MIDI et l'instrument (puissance de 2, max 128)
+#define MIDI_RING_CAPACITY 64
+
+// Histogrammes de latence lecture MIDI -> écriture I2C de la touche (LatencyStats.h), par
+// transport, lus par SysEx (table 1) ou la commande série 'l' ('L' = remise à zéro)
+// ~330 octets de RAM (3 par événement de la file, 5 par note planifiée) : vérifier la mémoire
+// libre du Leonardo avant d'activer. 0 = aucun horodatage, code retiré à la compilation
+#define LATENCY_STATS 0
+#define LATENCY_PENDING_WRITES 4  // Touches commandées entre deux flush, suivies jusqu'au bus
+#define LATENCY_TRANSPORT_USB 0
+#define LATENCY_TRANSPORT_DIN 1
+#define LATENCY_TRANSPORT_COUNT 2
+const char* const latencyTransportNames[LATENCY_TRANSPORT_COUNT] {"USB", "DIN"};
+
+// Durées min/moy/max et p50/p99 des étapes de loop() (LoopProfiler.h) : lecture, dispatch,
+// air, flush, commande série 's' ('S' = remise à zéro). ~260 octets de RAM : vérifier la
+// mémoire libre du Leonardo avant d'activer. 0 = code retiré à la compilation
+#define LOOP_PROFILER 0
+#define LOOP_DEADLINE_US 1000     // Itération plus longue = comptée en retard (une trame USB = 1 ms)
+
+//------------------------------------------- Note Scheduler ----------------------
+// Mode délai fixe : chaque note est jouée NOTE_FIXED_DELAY_MS après sa réception, avancée du
+// temps de course propre à chaque servo, pour que toutes les notes d'un accord sonnent ensemble.
+// Ajoute une latence constante. 0 = désactivé (servo actionné dès réception)
+#define NOTE_FIXED_DELAY_MS 0
+#define SCHEDULER_CAPACITY 16     // Nombre max de noteOn/noteOff en attente
+
 //------------------------------------------- Air Manager -------------------------
-// Servo d'air branché directement sur PWM Arduino
+// Servo d'air sur un canal libre du PCA9685 : même tampon et même flush I2C que les touches,
+// sans le timer/ISR de la librairie Servo (gigue sur le polling MIDIUSB)
+// Le canal de chaque valve est réservé, les touches passent au canal suivant : 32 touches
+// et une valve demandent une 3e carte (PCA_BOARD_COUNT 3)
+#define AIR_ON_PCA 0              // 1 = valve sur le PCA9685, 0 = servo branché sur AIR_SERVO_PIN
+#define AIR_PCA_BOARD 0           // Carte PCA9685 des valves (index dans pcaAddresses)
+#define AIR_PCA_CHANNEL 15        // Valve du premier instrument, voir instrumentAirChannel
+// Servo d'air branché directement sur PWM Arduino (AIR_ON_PCA 0)
 #define AIR_SERVO_PIN 9           // Pin PWM pour servo de valve d'air
 #define AIR_CLOSED_ANGLE 0        // Angle lorsque valve fermée (pas d'air)
 #define AIR_MIN_ANGLE 30          // Angle minimal pour notes douces
 #define AIR_MAX_ANGLE 90          // Angle maximal pour notes fortes
 #define AIR_ANTICIPATION_MS 50    // Délai d'anticipation avant noteOn (ms)
+                                  // après un silence, la valve s'ouvre et la touche attend ce délai
+#define AIR_HANG_MS 150           // La valve reste ouverte ce temps après la dernière note (0 = fermeture immédiate)
+
+//------------------------------------------- Power budget -------------------------
+// Courant estimé des servos de touches : au-delà du budget, la nouvelle note est refusée
+// ou une voix tenue est relâchée. Les compteurs (Instrument::getVoiceStats) aident à
+// dimensionner l'alimentation sur un vrai répertoire
+#define POWER_BUDGET_MA 8000      // Courant max pour les touches (mA), 0 = pas de limite (mesure seule)
+#define SERVO_HOLD_MA 200         // Servo qui maintient une touche enfoncée
+#define SERVO_MOVE_MA 650         // Servo en course vers la touche (proche du courant de blocage SG90)
+#define VOICE_STEAL_MODE 1        // 0 = refuser la note, 1 = voler la plus ancienne, 2 = voler la plus douce
+
+//------------------------------------------- Instruments -------------------------
+// Plusieurs mélodicas (ou un clavier partagé) sur le même contrôleur : chaque instrument a sa
+// plage de servos, sa valve d'air, son volume et sa file d'événements. Le budget de courant
+// est partagé à parts égales (POWER_BUDGET_MA / INSTRUMENT_COUNT)
+#define INSTRUMENT_COUNT 1
+#define NO_INSTRUMENT 0xFF        // Canal MIDI ignoré
+// Instrument joué par chaque canal MIDI (1 à 16), lu directement à la réception
+const uint8_t channelInstrument[16] {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+// Premier servo et nombre de servos de chaque instrument (keyLayout est relatif au premier servo)
+constexpr uint8_t instrumentFirstServo[INSTRUMENT_COUNT] {0};
+constexpr uint8_t instrumentServoCount[INSTRUMENT_COUNT] {NUMBER_OF_NOTES};
+const int8_t instrumentTranspose[INSTRUMENT_COUNT] {0};     // Demi-tons, en plus de TRANSPOSE
+constexpr uint8_t instrumentAirChannel[INSTRUMENT_COUNT] {AIR_PCA_CHANNEL}; // AIR_ON_PCA 1 (carte AIR_PCA_BOARD)
+const uint8_t instrumentAirPin[INSTRUMENT_COUNT] {AIR_SERVO_PIN};     // AIR_ON_PCA 0
 
 
 //------------------------------------------- Servos Manager -------------------------
@@ -40,11 +128,43 @@ const int8_t sensRot[NUMBER_OF_NOTES] {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1
 
 // Angle de course pour appuyer sur les touches (identique pour tous)
 #define ANGLE_NOTE_ON 20          // Déplacement en degrés pour appuyer
-#define SERVO_RESET_DELAY_MS 200  // Délai entre chaque servo lors du reset
-
-#define PCA1_ADRESS 0x40
-#define PCA2_ADRESS 0x41
-#define PWM_CHANNELS_PER_DRIVER 15  // Number of PWM channels per PCA9685
+#define SERVO_RESET_DELAY_MS 200  // Délai entre chaque groupe de servos lors du reset
+
+// Profils de mouvement (valeurs par défaut, réglables par servo et sauvegardées avec la calibration)
+// Survol : au repos le servo attend juste au-dessus du point de contact avec la touche
+#define DEFAULT_HOVER_OFFSET 0        // Degrés entre l'angle de repos et la position de survol
+#define DEFAULT_RELEASE_OVERSHOOT 0   // Dépassement bref au relâchement (degrés au-delà du survol)
+#define RELEASE_OVERSHOOT_MS 30       // Durée du dépassement avant de revenir au survol
+// Modèle cinématique SG90 (estimation des temps d'appui/relâchement)
+#define SERVO_MS_PER_DEGREE_X10 17    // Vitesse max : ~0.1 s pour 60° => 1.7 ms/degré
+#define SERVO_DECEL_ZONE_DEG 8        // En deçà de cette erreur le servo ralentit (asservissement P)
+
+// Homing non bloquant au démarrage, piloté par Instrument::update()
+#define HOMING_GROUP_SIZE 4       // Nombre de servos déplacés ensemble à chaque étape
+#define PARK_SAVE_IDLE_MS 30000   // Inactivité (aucune touche) avant de mémoriser la position de repos
+#define EEPROM_PARK_MAGIC 0x5A    // Marqueur de position de repos valide en EEPROM
+
+// Cartes PCA9685 sur le bus. Le servo n utilise le n-ième canal libre (16 par carte, dans
+// l'ordre des adresses, canaux des valves d'air sautés) : table générée et vérifiée à la compilation
+#define PCA_BOARD_COUNT 2           // Nombre de cartes PCA9685 sur le bus (4 cartes pour 64 servos)
+#define PCA_CHANNEL_COUNT 16        // Canaux physiques d'un PCA9685
+const uint8_t pcaAddresses[PCA_BOARD_COUNT] {0x40, 0x41};
+
+// Mode trame : noteOn/noteOff ne font que marquer le canal, l'écriture I2C est faite
+// en rafale (auto-incrément) par ServoController::flush() depuis Instrument::update()
+#define SERVO_FRAME_MODE 1          // 1 = écritures groupées, 0 = écriture immédiate
+#define I2C_TX_BUFFER_SIZE 32       // Tampon d'émission Wire (32 octets sur AVR)
+// Un noteOff arrivant moins de MIN_NOTE_HOLD_MS après le noteOn est retardé pour que la touche
+// ait le temps de descendre (sinon appui et relâchement fusionnent dans la même trame)
+#define MIN_NOTE_HOLD_MS 40
+
+// Décalage de phase : chaque canal démarre son impulsion à un instant différent de la
+// période de 20 ms (4096 ticks) pour que les servos ne tirent pas leur courant en même temps
+#define PWM_PHASE_MODE 1            // 1 = impulsions décalées, 0 = toutes au tick 0
+#define PWM_PERIOD_TICKS 4096
+// Répartition par carte : tick de départ du canal 0 et pas entre deux canaux
+const uint16_t pwmPhaseBase[PCA_BOARD_COUNT] {0, 128};
+const uint16_t pwmPhaseStep[PCA_BOARD_COUNT] {256, 256};
 
 #define PIN_PCA_OFF 5// pin pour desactiver alim des servos et reduire le bruit
 
@@ -27,51 +27,162 @@
 #include <BLEMIDI_Transport.h>
 #include <hardware/BLEMIDI_ESP32.h>
 #include "Instrument.h"
+#include "LatencyStats.h"
+#include "LoopProfiler.h"
 #include "settings.h"
 
 // BLE MIDI instance
 BLEMIDI_CREATE_INSTANCE("Servo Melodica", MIDI);
 
-Instrument* instrument = nullptr;
+ServoController* servoController = nullptr;   // Un seul bus I2C, partagé par les instruments
+Instrument* instruments[INSTRUMENT_COUNT];
+Instrument* channelRoutes[16];                 // Instrument de chaque canal MIDI, nullptr = ignoré
+
+// Set by the radio stack, forwarded by the only producer of the event ring
+volatile bool disconnectPending = false;
+
+// Per-task CPU usage, reset at each stats report
+struct TaskStats {
+  volatile uint32_t busyMicros;   // Time spent working since the last report
+};
+TaskStats networkStats = {0};
+TaskStats actuationStats = {0};
+LoopProfiler networkProfiler;  // Tâche MIDI (mode double cœur), loopProfiler suit loop() ou la tâche des servos
+unsigned long lastStatsTime = 0;
 
 // MIDI callback handlers
-void handleNoteOn(byte channel, byte note, byte velocity) {
-  if (velocity == 0) {
-    // Velocity 0 = Note Off
-    instrument->noteOff(note);
-  } else {
-    instrument->noteOn(note, velocity);
+// Les callbacks ne font que déposer l'événement (canal 1-16 => 0-15) dans la file de
+// l'instrument du canal, l'instrument le joue dans son update()
+void pushEvent(byte type, byte channel, byte data1, byte data2) {
+  Instrument* target = channelRoutes[(channel - 1) & 0x0F];
+  if (target != nullptr) {
+    target->eventRing().push(type | ((channel - 1) & 0x0F), data1, data2, LATENCY_TRANSPORT_BLE);
   }
 }
 
+void handleNoteOn(byte channel, byte note, byte velocity) {
+  pushEvent(0x90, channel, note, velocity);
+}
+
 void handleNoteOff(byte channel, byte note, byte velocity) {
-  instrument->noteOff(note);
+  pushEvent(0x80, channel, note, velocity);
 }
 
 void handleControlChange(byte channel, byte controller, byte value) {
-  switch (controller) {
-    case 7:   // Volume (CC 7)
-      instrument->volumeControl(value);
+  pushEvent(0xB0, channel, controller, value);
+}
+
+void handlePitchBend(byte channel, int bend) {
+  uint16_t value = bend + 8192; // back to the 14-bit wire format
+  pushEvent(0xE0, channel, value & 0x7F, value >> 7);
+}
+
+// Reads MIDI: the callbacks above enqueue, nothing else touches the ring head
+void readMidi() {
+  MIDI.read();
+
+  if (disconnectPending) {
+    disconnectPending = false;
+    for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+      instruments[i]->eventRing().push(0xB0, 123, 0); // All Notes Off on disconnect
+    }
+  }
+}
+
+// Core 0: parse and timestamp MIDI next to the radio stack
+void networkTask(void* parameter) {
+  for (;;) {
+    uint32_t start = micros();
+    networkProfiler.begin();
+    readMidi();
+    networkProfiler.lap(LOOP_READ);
+    networkProfiler.end();
+    networkStats.busyMicros += micros() - start;
+    vTaskDelay(1);
+  }
+}
+
+// Plays every instrument's queued events, then homing on the shared controller
+void updateInstruments() {
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    instruments[i]->update();
+  }
+  loopProfiler.lap(LOOP_DISPATCH);
+  servoController->update();
+  loopProfiler.lap(LOOP_FLUSH);
+}
+
+// Core 1: sole owner of ServoController and the air servos
+void actuationTask(void* parameter) {
+  for (;;) {
+    uint32_t start = micros();
+    loopProfiler.begin();
+    updateInstruments();
+    loopProfiler.end();
+    actuationStats.busyMicros += micros() - start;
+    vTaskDelay(1);
+  }
+}
+
+void printTaskStats() {
+  unsigned long now = millis();
+  uint32_t windowMicros = (now - lastStatsTime) * 1000UL;
+  if (windowMicros == 0) {
+    return;
+  }
+
+  Serial.print("CPU net: ");
+  Serial.print(networkStats.busyMicros * 100.0 / windowMicros, 1);
+  Serial.print("% act: ");
+  Serial.print(actuationStats.busyMicros * 100.0 / windowMicros, 1);
+  Serial.print("%");
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    MidiEventRing& ring = instruments[i]->eventRing();
+    Serial.print(" | queue ");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(ring.size());
+    Serial.print(" high-water: ");
+    Serial.print(ring.getHighWaterMark());
+    Serial.print(" overflows: ");
+    Serial.print(ring.getOverflowCount());
+  }
+  Serial.println();
+
+  networkStats.busyMicros = 0;
+  actuationStats.busyMicros = 0;
+  lastStatsTime = now;
+}
+
+// Moniteur série : 'l' = histogrammes de latence, 's' = profil des boucles, majuscule = remise à zéro
+void readSerialCommand() {
+  if (!Serial.available()) {
+    return;
+  }
+  switch (Serial.read()) {
+    case 'l':
+      latencyStats.print(Serial);
       break;
-    case 1:   // Modulation (CC 1)
-    case 91:  // Reverb (CC 91)
-    case 92:  // Tremolo (CC 92)
-    case 94:  // Detune (CC 94)
-      instrument->modulationWheel(value);
+    case 'L':
+      latencyStats.reset();
+      Serial.println("latency stats reset");
       break;
-    case 121: // Reset All Controllers (CC 121)
-      instrument->reset();
+    case 's':
+      if (DUAL_CORE_MODE) {
+        networkProfiler.print(Serial, "midi task");
+        loopProfiler.print(Serial, "servo task");
+      } else {
+        loopProfiler.print(Serial);
+      }
       break;
-    case 123: // All Notes Off (CC 123)
-      instrument->allNotesOff();
+    case 'S':
+      networkProfiler.reset();
+      loopProfiler.reset();
+      Serial.println("loop profiler reset");
       break;
   }
 }
 
-void handlePitchBend(byte channel, int bend) {
-  instrument->pitchBend(bend);
-}
-
 void setup() {
   Serial.begin(115200);
   delay(1000);
@@ -80,17 +191,32 @@ void setup() {
   Serial.println("║     SERVO MELODICA - ESP32 BLUETOOTH MIDI                ║");
   Serial.println("╚══════════════════════════════════════════════════════════╝");
 
-  // Initialize instrument
+  // Initialize instruments on the shared servo controller
   Serial.println("\nInitializing Instrument...");
-  instrument = new Instrument();
-
-  if (!instrument->begin()) {
-    Serial.println("ERROR: Instrument initialization failed!");
+  servoController = new ServoController();
+  if (!servoController->begin()) {
+    Serial.println("ERROR: Failed to initialize ServoController!");
     while (1) {
       delay(1000);
     }
   }
 
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    instruments[i] = new Instrument(*servoController, i);
+    if (!instruments[i]->begin()) {
+      Serial.println("ERROR: Instrument initialization failed!");
+      while (1) {
+        delay(1000);
+      }
+    }
+  }
+
+  // MIDI channel -> instrument, one array read per event
+  for (uint8_t channel = 0; channel < 16; channel++) {
+    uint8_t target = channelInstrument[channel];
+    channelRoutes[channel] = (target < INSTRUMENT_COUNT) ? instruments[target] : nullptr;
+  }
+
   // Initialize BLE MIDI
   Serial.println("\nInitializing BLE MIDI...");
   MIDI.begin(MIDI_CHANNEL_OMNI);
@@ -102,7 +228,7 @@ void setup() {
 
   BLEMIDI.setHandleDisconnected([]() {
     Serial.println("✗ BLE MIDI Disconnected");
-    instrument->allNotesOff(); // Stop all notes on disconnect
+    disconnectPending = true; // All Notes Off queued by the MIDI reader
   });
 
   MIDI.setHandleNoteOn(handleNoteOn);
@@ -110,6 +236,15 @@ void setup() {
   MIDI.setHandleControlChange(handleControlChange);
   MIDI.setHandlePitchBend(handlePitchBend);
 
+  if (DUAL_CORE_MODE) {
+    xTaskCreatePinnedToCore(networkTask, "midi", TASK_STACK_SIZE, nullptr,
+                            NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
+    xTaskCreatePinnedToCore(actuationTask, "servos", TASK_STACK_SIZE, nullptr,
+                            ACTUATION_TASK_PRIORITY, nullptr, ACTUATION_TASK_CORE);
+    Serial.println("✓ MIDI task on core 0, servo task on core 1");
+  }
+  lastStatsTime = millis();
+
   Serial.println("✓ BLE MIDI initialized");
   Serial.println("\n╔══════════════════════════════════════════════════════════╗");
   Serial.println("║  READY - Waiting for BLE MIDI connection...             ║");
@@ -118,9 +253,28 @@ void setup() {
 }
 
 void loop() {
+  if (DUAL_CORE_MODE) {
+    // MIDI and servos run in their pinned tasks, loop() only reports
+    if (TASK_STATS_INTERVAL_MS > 0 && millis() - lastStatsTime >= TASK_STATS_INTERVAL_MS) {
+      printTaskStats();
+    }
+    if (LATENCY_STATS || LOOP_PROFILER) {
+      readSerialCommand();
+    }
+    delay(10);
+    return;
+  }
+
   // Read and process MIDI messages
-  MIDI.read();
+  loopProfiler.begin();
+  readMidi();
+  loopProfiler.lap(LOOP_READ);
+
+  // Update instruments (for time-based operations)
+  updateInstruments();
+  loopProfiler.end(); // Printing a report is not part of the iteration
 
-  // Update instrument (for time-based operations)
-  instrument->update();
+  if (LATENCY_STATS || LOOP_PROFILER) {
+    readSerialCommand();
+  }
 }
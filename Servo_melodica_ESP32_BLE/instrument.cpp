@@ -1,29 +1,66 @@
 #include "Instrument.h"
+#include "LoopProfiler.h"
 
-Instrument::Instrument() : servoController(), activeNotesCount(0), currentVolume(127), currentAirAngle(AIR_CLOSED_ANGLE) {
+// Index of the highest set bit (mask != 0), one NSAU instruction on the ESP32
+static uint8_t highestBit(uint32_t mask) {
+  return 31 - __builtin_clz(mask);
+}
+
+// Air angle of a velocity bucket, from its lower edge: 1-3 -> AIR_MIN_ANGLE, 124-127 -> AIR_MAX_ANGLE.
+// Same value for the first note (openAir) and the held notes (updateAirFlow)
+static uint8_t bucketAirAngle(uint8_t bucket) {
+  return map(bucket << VELOCITY_BUCKET_SHIFT, 0, 128 - (1 << VELOCITY_BUCKET_SHIFT), AIR_MIN_ANGLE, AIR_MAX_ANGLE);
+}
+
+// Servo ranges must exist and not overlap
+constexpr bool rangeFree(int instrument, int other) {
+  return other >= INSTRUMENT_COUNT
+      || ((instrumentFirstServo[other] >= instrumentFirstServo[instrument] + instrumentServoCount[instrument]
+           || instrumentFirstServo[instrument] >= instrumentFirstServo[other] + instrumentServoCount[other])
+          && rangeFree(instrument, other + 1));
+}
+constexpr bool rangesValidFrom(int instrument) {
+  return instrument >= INSTRUMENT_COUNT
+      || (instrumentFirstServo[instrument] + instrumentServoCount[instrument] <= NUMBER_OF_NOTES
+          && rangeFree(instrument, instrument + 1) && rangesValidFrom(instrument + 1));
+}
+static_assert(rangesValidFrom(0), "instrument servo ranges out of range or overlapping");
+
+Instrument::Instrument(ServoController& controller, uint8_t instrumentIndex)
+  : servoController(controller), index(instrumentIndex), activeNotesCount(0), velocityBucketMask(0),
+    currentVolume(127), currentAirAngle(AIR_CLOSED_ANGLE) {
   if (DEBUG) {
     Serial.println("DEBUG: Instrument--creation");
   }
 
-  // Initialize air servo
-  airServo.attach(AIR_SERVO_PIN);
-  closeAir();
+  // Initialize air servo (on the PCA9685, the valve is closed in begin())
+  if (!AIR_ON_PCA) {
+    airServo.attach(instrumentAirPin[index]);
+    closeAir();
+  }
 
   // Initialize active notes array
   for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
     activeNotes[i] = false;
   }
+  for (uint8_t b = 0; b < VELOCITY_BUCKETS; b++) {
+    velocityBucketCounts[b] = 0;
+  }
 }
 
 bool Instrument::begin() {
   Serial.println("Initializing Instrument...");
 
-  // Initialize servo controller
-  if (!servoController.begin()) {
-    Serial.println("ERROR: Failed to initialize ServoController!");
+  // The servo controller is shared, the sketch begins it first
+  if (!servoController.isReady()) {
+    Serial.println("ERROR: ServoController not initialized!");
     return false;
   }
 
+  if (AIR_ON_PCA) {
+    closeAir();
+  }
+
   Serial.println("Instrument initialized successfully");
   return true;
 }
@@ -31,8 +68,9 @@ bool Instrument::begin() {
 int Instrument::getServo(uint8_t midiNote) {
   // Returns the servo number (0 to NUMBER_OF_NOTES-1) for the given MIDI note
   // Returns -1 if the note is not playable
-  if ((midiNote >= FIRST_MIDI_NOTE) && (midiNote < (FIRST_MIDI_NOTE + NUMBER_OF_NOTES))) {
-    int servoAJouer = midiNote - FIRST_MIDI_NOTE;
+  int16_t key = midiNote + instrumentTranspose[index] - FIRST_MIDI_NOTE;
+  if (key >= 0 && key < instrumentServoCount[index]) {
+    int servoAJouer = instrumentFirstServo[index] + key;
     return servoAJouer;
   }
   if (DEBUG) {
@@ -50,16 +88,38 @@ void Instrument::noteOn(uint8_t midiNote, uint8_t velocity) {
     uint8_t scaledVelocity = (velocity * currentVolume) / 127;
 
     // Appuie sur la touche (position fixe, pas de vélocité)
+    latencyStats.keyCommanded();
     servoController.noteOn(servo);
 
     // Track active notes
     if (!activeNotes[servo]) {
       activeNotes[servo] = true;
       activeNotesCount++;
+    } else {
+      removeHeldVelocity(servo); // re-pressed with a new velocity
+    }
+    addHeldVelocity(servo, scaledVelocity);
+
+    // Vélocité gérée uniquement par le servo d'air : niveau de la note tenue la plus forte
+    if (currentAirAngle == AIR_CLOSED_ANGLE) {
+      openAir(midiNote, scaledVelocity);
+    } else {
+      updateAirFlow();
     }
+  }
+}
+
+void Instrument::addHeldVelocity(uint8_t servo, uint8_t velocity) {
+  uint8_t bucket = velocity >> VELOCITY_BUCKET_SHIFT;
+  noteVelocities[servo] = velocity;
+  velocityBucketCounts[bucket]++;
+  velocityBucketMask |= (1UL << bucket);
+}
 
-    // Vélocité gérée uniquement par le servo d'air
-    openAir(midiNote, scaledVelocity);
+void Instrument::removeHeldVelocity(uint8_t servo) {
+  uint8_t bucket = noteVelocities[servo] >> VELOCITY_BUCKET_SHIFT;
+  if (velocityBucketCounts[bucket] > 0 && --velocityBucketCounts[bucket] == 0) {
+    velocityBucketMask &= ~(1UL << bucket);
   }
 }
 
@@ -67,20 +127,20 @@ void Instrument::noteOff(uint8_t midiNote) {
   int servo = getServo(midiNote);
   if (servo != -1) {
     // Remet le servo à sa position initiale
+    latencyStats.keyCommanded();
     servoController.noteOff(servo);
 
     // Track active notes
     if (activeNotes[servo]) {
       activeNotes[servo] = false;
+      removeHeldVelocity(servo);
       if (activeNotesCount > 0) {
         activeNotesCount--;
       }
     }
 
-    // Close air if no more notes are playing
-    if (activeNotesCount == 0) {
-      closeAir();
-    }
+    // Loudest note released: follow the remaining ones down, close air if none is left
+    updateAirFlow();
   }
 }
 
@@ -88,13 +148,14 @@ void Instrument::openAir(uint8_t note, uint8_t velocity) {
   // Ouvre la valve d'air en fonction de la vélocité
   // Plus la vélocité est forte, plus l'angle d'ouverture est grand
 
-  // Map velocity (0-127) to air servo angle (AIR_MIN_ANGLE to AIR_MAX_ANGLE)
-  uint8_t targetAngle = map(velocity, 1, 127, AIR_MIN_ANGLE, AIR_MAX_ANGLE);
+  // Map velocity (0-127) to air servo angle (AIR_MIN_ANGLE to AIR_MAX_ANGLE), by bucket as
+  // updateAirFlow() does
+  uint8_t targetAngle = bucketAirAngle(velocity >> VELOCITY_BUCKET_SHIFT);
 
   // Si l'angle demandé est supérieur à l'angle actuel, mettre à jour
   if (targetAngle > currentAirAngle) {
     currentAirAngle = targetAngle;
-    airServo.write(currentAirAngle);
+    writeAirAngle();
   }
 
   if (DEBUG) {
@@ -112,23 +173,50 @@ void Instrument::openAir(uint8_t note, uint8_t velocity) {
 void Instrument::closeAir() {
   // Ferme la valve d'air
   currentAirAngle = AIR_CLOSED_ANGLE;
-  airServo.write(currentAirAngle);
+  writeAirAngle();
 
   if (DEBUG) {
     Serial.println("Air closed - No active notes");
   }
 }
 
+void Instrument::writeAirAngle() {
+  loopProfiler.lap(LOOP_DISPATCH);
+  if (AIR_ON_PCA) {
+    servoController.setAirAngle(instrumentAirChannel[index], currentAirAngle);
+  } else {
+    airServo.write(currentAirAngle);
+  }
+  loopProfiler.lap(LOOP_AIR);
+}
+
 void Instrument::updateAirFlow() {
   // Met à jour le débit d'air en fonction des notes actives
-  // Trouve la vélocité maximale parmi les notes actives
-  // et ajuste l'angle du servo en conséquence
+  // La vélocité maximale parmi les notes actives est le bit le plus haut du masque des seaux
 
-  if (activeNotesCount == 0) {
-    closeAir();
-  } else {
-    // L'angle est déjà défini par openAir() lors du noteOn
-    // Cette fonction peut être utilisée pour ajustements dynamiques
+  if (velocityBucketMask == 0) {
+    if (currentAirAngle != AIR_CLOSED_ANGLE) {
+      closeAir();
+    }
+    return;
+  }
+
+  // Lower edge of the highest bucket (4-velocity buckets, ~2° of air angle)
+  uint8_t maxVelocity = highestBit(velocityBucketMask) << VELOCITY_BUCKET_SHIFT;
+  uint8_t targetAngle = bucketAirAngle(highestBit(velocityBucketMask));
+
+  if (targetAngle != currentAirAngle) {
+    currentAirAngle = targetAngle;
+    writeAirAngle();
+
+    if (DEBUG) {
+      Serial.print("Air level - Max velocity: ");
+      Serial.print(maxVelocity);
+      Serial.print(" Angle: ");
+      Serial.print(currentAirAngle);
+      Serial.print(" Active notes: ");
+      Serial.println(activeNotesCount);
+    }
   }
 }
 
@@ -138,11 +226,67 @@ void Instrument::update() {
   // - Envelope control
   // - Pressure management
   // - LED indicators
-  // Currently empty but ready for future enhancements
+
+  // Events queued by the MIDI transport since the last call
+  MidiEvent midiEvent;
+  while (midiEvents.pop(midiEvent)) {
+#if LATENCY_STATS
+    latencyStats.dispatch(midiEvent.transport, midiEvent.received);
+#endif
+    handleEvent(midiEvent);
+    latencyStats.release();
+  }
+}
+
+MidiEventRing& Instrument::eventRing() {
+  return midiEvents;
+}
+
+void Instrument::handleEvent(const MidiEvent& event) {
+  switch (event.status & 0xF0) {
+    case 0x90: // Note On
+      if (event.data2 > 0) {
+        noteOn(event.data1, event.data2);
+      } else {
+        // Velocity 0 = Note Off
+        noteOff(event.data1);
+      }
+      break;
+    case 0x80: // Note Off
+      noteOff(event.data1);
+      break;
+    case 0xB0: // Control Change
+      controlChange(event.data1, event.data2);
+      break;
+    case 0xE0: // Pitch Bend
+      pitchBend(((event.data2 << 7) | event.data1) - 8192);
+      break;
+  }
 }
 
 // ========== ADDITIONAL MIDI MESSAGE HANDLERS ==========
 
+void Instrument::controlChange(uint8_t controller, uint8_t value) {
+  switch (controller) {
+    case 7:   // Volume (CC 7)
+      volumeControl(value);
+      break;
+    case 1:   // Modulation (CC 1)
+    case 91:  // Reverb (CC 91)
+    case 92:  // Tremolo (CC 92)
+    case 94:  // Detune (CC 94)
+      modulationWheel(value);
+      break;
+    case 121: // Reset All Controllers (CC 121)
+      reset();
+      break;
+    case 120: // All Sound Off (CC 120)
+    case 123: // All Notes Off (CC 123)
+      allNotesOff();
+      break;
+  }
+}
+
 void Instrument::allNotesOff() {
   // CC 123 - Stop all notes immediately (panic button)
   Serial.println("MIDI: All Notes Off");
@@ -155,6 +299,10 @@ void Instrument::allNotesOff() {
   }
 
   activeNotesCount = 0;
+  for (uint8_t b = 0; b < VELOCITY_BUCKETS; b++) {
+    velocityBucketCounts[b] = 0;
+  }
+  velocityBucketMask = 0;
   closeAir();
 }
 
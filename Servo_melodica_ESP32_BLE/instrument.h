@@ -3,6 +3,7 @@
 
 #include "settings.h"
 #include "ServoController.h"
+#include "MidiEventRing.h"
 #include <ESP32Servo.h>  // ESP32Servo library instead of Servo
 /***********************************************************************************************
 ----------------------------    instrument.h   ----------------------------------------
@@ -11,27 +12,43 @@
 execute les messages noteOn et noteOff
 
 ************************************************************************************************/
+
+// Vélocités des notes tenues rangées par seaux de 4 (32 seaux, un bit par seau non vide)
+#define VELOCITY_BUCKET_SHIFT 2
+#define VELOCITY_BUCKETS (128 >> VELOCITY_BUCKET_SHIFT)
+
 class Instrument {
 private:
-  ServoController servoController;
-  Servo airServo;            // Servo pour contrôle du débit d'air
+  ServoController& servoController; // Partagé par tous les instruments (un seul bus I2C)
+  uint8_t index;             // Configuration de l'instrument dans settings.h (instrumentFirstServo...)
+  MidiEventRing midiEvents;  // Événements déposés par le transport, consommés dans update()
+  Servo airServo;            // Servo pour contrôle du débit d'air (AIR_ON_PCA 0)
   uint8_t activeNotesCount;  // Track number of active notes
   bool activeNotes[NUMBER_OF_NOTES];  // Track which notes are active
+  uint8_t noteVelocities[NUMBER_OF_NOTES];        // Scaled velocity of each held note
+  uint8_t velocityBucketCounts[VELOCITY_BUCKETS]; // Held notes per velocity bucket
+  uint32_t velocityBucketMask;  // Bit n set = bucket n not empty, max velocity = highest bit
   uint8_t currentVolume;     // Current master volume (0-127)
   uint8_t currentAirAngle;   // Current air servo angle
   int getServo(uint8_t midiNote); //renvoit le numero du servo de 1 a 32 et 0 si la note ne peut pas etre jouée
   void openAir(uint8_t note, uint8_t velocity); // ouvre l'air en fonction de la note et de la velocité
   void closeAir(); // ferme les valves d'air
+  void writeAirAngle(); // Envoie currentAirAngle au PCA9685 ou au servo de la pin
   void updateAirFlow(); // Met à jour le débit d'air selon les notes actives
+  void addHeldVelocity(uint8_t servo, uint8_t velocity);  // Note tenue comptée dans son seau
+  void removeHeldVelocity(uint8_t servo);                 // Note relâchée retirée de son seau
+  void handleEvent(const MidiEvent& event); // Décode un événement de la file
 
 public:
-  Instrument();
-  bool begin(); // Initialize instrument, returns true on success
+  Instrument(ServoController& controller, uint8_t instrumentIndex);
+  bool begin(); // Initialize instrument (controller begun by the sketch), returns true on success
   void noteOn(uint8_t midiNote, uint8_t velocity);
   void noteOff(uint8_t midiNote);
   void update();
+  MidiEventRing& eventRing(); // Côté transport : push() uniquement
 
   // Additional MIDI message handlers
+  void controlChange(uint8_t controller, uint8_t value); // Dispatch CC messages
   void allNotesOff(); // CC 123 - Stop all notes immediately
   void reset(); // CC 121 - Reset all controllers
   void volumeControl(uint8_t value); // CC 7 - Master volume
@@ -17,14 +17,61 @@
 //note la plus grave du melodica
 #define FIRST_MIDI_NOTE 65
 
+//------------------------------------------- Tâches FreeRTOS (double coeur) ------
+// Coeur 0 : lecture/horodatage MIDI à côté de la pile radio
+// Coeur 1 : tâche prioritaire qui possède ServoController et le servo d'air
+#define DUAL_CORE_MODE 1              // 0 = tout dans loop() comme avant
+#define NETWORK_TASK_CORE 0
+#define ACTUATION_TASK_CORE 1
+#define NETWORK_TASK_PRIORITY 1
+#define ACTUATION_TASK_PRIORITY 3     // Au-dessus de loop() (priorité 1)
+#define TASK_STACK_SIZE 4096
+#define TASK_STATS_INTERVAL_MS 5000   // Affichage charge CPU / file d'événements (0 = jamais)
+
+// File d'événements entre le transport MIDI et l'instrument (puissance de 2, max 128)
+#define MIDI_RING_CAPACITY 64
+
+// Histogrammes de latence callback BLE -> setPWM() de la touche (LatencyStats.h), commande
+// série 'l' ('L' = remise à zéro). 0 = aucun horodatage, code retiré à la compilation
+#define LATENCY_STATS 1
+#define LATENCY_PENDING_WRITES 4  // Touches commandées par un événement, suivies jusqu'au bus
+#define LATENCY_TRANSPORT_BLE 0
+#define LATENCY_TRANSPORT_COUNT 1
+const char* const latencyTransportNames[LATENCY_TRANSPORT_COUNT] {"BLE"};
+
+// Durées min/moy/max et p50/p99 des étapes de loop() ou des deux tâches (LoopProfiler.h) :
+// lecture, dispatch, air, flush, commande série 's' ('S' = remise à zéro). 0 = code retiré
+#define LOOP_PROFILER 1
+#define LOOP_DEADLINE_US 1000     // Itération plus longue = comptée en retard
+
 //------------------------------------------- Air Manager -------------------------
-// Servo d'air branché directement sur PWM ESP32
+// Servo d'air branché directement sur PWM ESP32 (LEDC matériel, pas d'ISR)
+// ou sur un canal libre du PCA9685, écrit par le même chemin I2C que les touches
+#define AIR_ON_PCA 0              // 1 = valve sur le PCA9685, 0 = servo branché sur AIR_SERVO_PIN
+// Le canal de chaque valve est réservé, les touches passent au canal suivant : 32 touches
+// et une valve demandent une 3e carte (PCA_BOARD_COUNT 3)
+#define AIR_PCA_BOARD 0           // Carte PCA9685 des valves (index dans pcaAddresses)
+#define AIR_PCA_CHANNEL 15        // Valve du premier instrument, voir instrumentAirChannel
 #define AIR_SERVO_PIN 25          // GPIO 25 (Pin PWM pour servo de valve d'air)
 #define AIR_CLOSED_ANGLE 0        // Angle lorsque valve fermée (pas d'air)
 #define AIR_MIN_ANGLE 30          // Angle minimal pour notes douces
 #define AIR_MAX_ANGLE 90          // Angle maximal pour notes fortes
 #define AIR_ANTICIPATION_MS 50    // Délai d'anticipation avant noteOn (ms)
 
+//------------------------------------------- Instruments -------------------------
+// Plusieurs mélodicas (ou un clavier partagé) sur le même contrôleur : chaque instrument a sa
+// plage de servos, sa valve d'air, son volume et sa file d'événements
+#define INSTRUMENT_COUNT 1
+#define NO_INSTRUMENT 0xFF        // Canal MIDI ignoré
+// Instrument joué par chaque canal MIDI (1 à 16), lu directement dans les callbacks
+const uint8_t channelInstrument[16] {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+// Premier servo et nombre de servos de chaque instrument (note FIRST_MIDI_NOTE = premier servo)
+constexpr uint8_t instrumentFirstServo[INSTRUMENT_COUNT] {0};
+constexpr uint8_t instrumentServoCount[INSTRUMENT_COUNT] {NUMBER_OF_NOTES};
+const int8_t instrumentTranspose[INSTRUMENT_COUNT] {0};     // Demi-tons ajoutés aux notes reçues
+constexpr uint8_t instrumentAirChannel[INSTRUMENT_COUNT] {AIR_PCA_CHANNEL}; // AIR_ON_PCA 1 (carte AIR_PCA_BOARD)
+const uint8_t instrumentAirPin[INSTRUMENT_COUNT] {AIR_SERVO_PIN};     // AIR_ON_PCA 0
+
 
 //------------------------------------------- Servos Manager -------------------------
 // Configuration des 30 servos pour les touches du clavier
@@ -40,11 +87,14 @@ const int8_t sensRot[NUMBER_OF_NOTES] {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1
 
 // Angle de course pour appuyer sur les touches (identique pour tous)
 #define ANGLE_NOTE_ON 20          // Déplacement en degrés pour appuyer
-#define SERVO_RESET_DELAY_MS 200  // Délai entre chaque servo lors du reset
+#define SERVO_RESET_DELAY_MS 200  // Délai entre chaque groupe de servos lors du reset
+#define HOMING_GROUP_SIZE 4       // Servos déplacés ensemble à chaque étape du homing (non bloquant)
 
-#define PCA1_ADRESS 0x40
-#define PCA2_ADRESS 0x41
-#define PWM_CHANNELS_PER_DRIVER 15  // Number of PWM channels per PCA9685
+// Cartes PCA9685 sur le bus. Le servo n utilise le n-ième canal libre (16 par carte, dans
+// l'ordre des adresses, canaux des valves d'air sautés) : table générée et vérifiée à la compilation
+#define PCA_BOARD_COUNT 2           // Nombre de cartes PCA9685 sur le bus (4 cartes pour 64 servos)
+#define PCA_CHANNEL_COUNT 16        // Canaux physiques d'un PCA9685
+const uint8_t pcaAddresses[PCA_BOARD_COUNT] {0x40, 0x41};
 
 #define PIN_PCA_OFF 26  // GPIO 26 pour désactiver alim des servos et réduire le bruit
 
@@ -0,0 +1,152 @@
+#include "LoopProfiler.h"
+
+LoopProfiler loopProfiler;
+
+#if LOOP_PROFILER
+
+static const char* const stageNames[LOOP_STAGE_COUNT] = {"read", "dispatch", "air", "flush", "loop"};
+
+LoopProfiler::LoopProfiler() {
+  reset();
+}
+
+void LoopProfiler::begin() {
+  iterationStart = micros();
+  lapStart = iterationStart;
+  memset(current, 0, sizeof(current));
+  running = true;
+}
+
+void LoopProfiler::lap(uint8_t stage) {
+  if (!running) {
+    return;
+  }
+  uint32_t now = micros();
+  current[stage] += now - lapStart;
+  lapStart = now;
+}
+
+void LoopProfiler::end() {
+  if (!running) {
+    return;
+  }
+  running = false;
+  current[LOOP_ITERATION] = micros() - iterationStart;
+  for (uint8_t s = 0; s < LOOP_STAGE_COUNT; s++) {
+    record(s, current[s]);
+  }
+  if (current[LOOP_ITERATION] > LOOP_DEADLINE_US) {
+    deadlineMisses++;
+  }
+  if (current[LOOP_ITERATION] > worst[LOOP_ITERATION]) {
+    memcpy(worst, current, sizeof(worst));
+  }
+}
+
+void LoopProfiler::record(uint8_t stage, uint32_t duration) {
+  LoopStageStats& s = stats[stage];
+  if (duration < s.min) {
+    s.min = duration;
+  }
+  if (duration > s.max) {
+    s.max = duration;
+  }
+  if (s.sum > 0xFFFFFFFFUL - duration) {
+    s.sum >>= 1;
+    s.count >>= 1;
+  }
+  s.sum += duration;
+  s.count++;
+  LoopHistogram::add(s.buckets, duration);
+}
+
+uint32_t LoopProfiler::getMin(uint8_t stage) {
+  return stats[stage].count ? stats[stage].min : 0;
+}
+
+uint32_t LoopProfiler::getAverage(uint8_t stage) {
+  return stats[stage].count ? stats[stage].sum / stats[stage].count : 0;
+}
+
+uint32_t LoopProfiler::getMax(uint8_t stage) {
+  return stats[stage].max;
+}
+
+uint32_t LoopProfiler::getCount(uint8_t stage) {
+  return stats[stage].count;
+}
+
+uint8_t LoopProfiler::percentileBucket(uint8_t stage, uint16_t permille) {
+  return LoopHistogram::percentile(stats[stage].buckets, permille);
+}
+
+uint32_t LoopProfiler::getDeadlineMisses() {
+  return deadlineMisses;
+}
+
+void LoopProfiler::reset() {
+  memset(stats, 0, sizeof(stats));
+  for (uint8_t s = 0; s < LOOP_STAGE_COUNT; s++) {
+    stats[s].min = 0xFFFFFFFFUL;
+  }
+  memset(worst, 0, sizeof(worst));
+  deadlineMisses = 0;
+  running = false; // An iteration spanning the reset is dropped
+}
+
+void LoopProfiler::print(Print& out, const char* name) {
+  if (stats[LOOP_ITERATION].count == 0) {
+    out.print(name);
+    out.println(": no iteration");
+    return;
+  }
+  // Iteration first, then the stages actually measured in this sketch
+  for (uint8_t i = 0; i < LOOP_STAGE_COUNT; i++) {
+    uint8_t s = (i == 0) ? LOOP_ITERATION : i - 1;
+    if (s != LOOP_ITERATION && stats[s].max == 0) {
+      continue;
+    }
+    if (s == LOOP_ITERATION) {
+      out.print(name);
+      out.print(": n ");
+      out.print(stats[s].count);
+    } else {
+      out.print("  ");
+      out.print(stageNames[s]);
+      out.print(':');
+    }
+    out.print(" min ");
+    out.print(getMin(s));
+    out.print(" avg ");
+    out.print(getAverage(s));
+    out.print(" max ");
+    out.print(stats[s].max);
+    out.print(" p50 ");
+    LoopHistogram::printBucket(out, percentileBucket(s, 500));
+    out.print(" p99 ");
+    LoopHistogram::printBucket(out, percentileBucket(s, 990));
+    out.print(" us");
+    if (s == LOOP_ITERATION) {
+      out.print(", over ");
+      out.print(LOOP_DEADLINE_US);
+      out.print(" us: ");
+      out.print(deadlineMisses);
+    }
+    out.println();
+  }
+  out.print("  worst ");
+  out.print(worst[LOOP_ITERATION]);
+  out.print(" us:");
+  for (uint8_t s = 0; s < LOOP_ITERATION; s++) {
+    if (stats[s].max == 0) {
+      continue;
+    }
+    out.print(' ');
+    out.print(stageNames[s]);
+    out.print(' ');
+    out.print(worst[s]);
+  }
+  out.println();
+}
+
+#endif // LOOP_PROFILER
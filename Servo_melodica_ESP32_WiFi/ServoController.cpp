@@ -1,9 +1,52 @@
 #include "ServoController.h"
 #include "settings.h"
+#include "LatencyStats.h"
 
-ServoController::ServoController() : isInitialized(false) {
-  pwm1 = Adafruit_PWMServoDriver(PCA1_ADRESS);
-  pwm2 = Adafruit_PWMServoDriver(PCA2_ADRESS);
+// Servo -> PCA9685 slot (board * PCA_CHANNEL_COUNT + channel), generated at compile time:
+// servo n takes the n-th slot, in board order, that is not an air valve channel
+#define NO_SLOT 0xFF
+static_assert(PCA_BOARD_COUNT * PCA_CHANNEL_COUNT < NO_SLOT, "Too many PCA9685 boards for the slot map");
+
+constexpr bool airSlot(int slot, int instrument) {
+  return AIR_ON_PCA && instrument < INSTRUMENT_COUNT
+      && (AIR_PCA_BOARD * PCA_CHANNEL_COUNT + instrumentAirChannel[instrument] == slot || airSlot(slot, instrument + 1));
+}
+constexpr uint8_t servoSlotFrom(int servo, int slot) {
+  return slot >= PCA_BOARD_COUNT * PCA_CHANNEL_COUNT ? NO_SLOT
+       : airSlot(slot, 0) ? servoSlotFrom(servo, slot + 1)
+       : servo == 0 ? slot
+       : servoSlotFrom(servo - 1, slot + 1);
+}
+constexpr uint8_t servoSlot(int servo) {
+  return servo < NUMBER_OF_NOTES ? servoSlotFrom(servo, 0) : NO_SLOT;
+}
+
+// Air valve channels: on an existing board, one per instrument
+constexpr bool airChannelUsedAfter(int instrument, int other) {
+  return other < INSTRUMENT_COUNT
+      && (instrumentAirChannel[other] == instrumentAirChannel[instrument] || airChannelUsedAfter(instrument, other + 1));
+}
+constexpr bool airChannelsValidFrom(int instrument) {
+  return instrument >= INSTRUMENT_COUNT
+      || (instrumentAirChannel[instrument] < PCA_CHANNEL_COUNT && !airChannelUsedAfter(instrument, instrument + 1)
+          && airChannelsValidFrom(instrument + 1));
+}
+static_assert(!AIR_ON_PCA || AIR_PCA_BOARD < PCA_BOARD_COUNT, "AIR_PCA_BOARD out of range");
+static_assert(!AIR_ON_PCA || airChannelsValidFrom(0), "instrumentAirChannel out of range or shared by two instruments");
+static_assert(servoSlot(NUMBER_OF_NOTES - 1) != NO_SLOT,
+              "Not enough PCA9685 channels for NUMBER_OF_NOTES servos and the air valves: raise PCA_BOARD_COUNT");
+
+#define SLOT_4(n) servoSlot(n), servoSlot(n + 1), servoSlot(n + 2), servoSlot(n + 3)
+#define SLOT_16(n) SLOT_4(n), SLOT_4(n + 4), SLOT_4(n + 8), SLOT_4(n + 12)
+static const uint8_t servoSlots[MAX_SERVOS] = {
+  SLOT_16(0), SLOT_16(16), SLOT_16(32), SLOT_16(48)
+};
+
+ServoController::ServoController()
+  : isInitialized(false), homedMask(0), homingGroupMask(0), homingNext(0), homingStepTime(0) {
+  for (uint8_t b = 0; b < PCA_BOARD_COUNT; b++) {
+    pwm[b] = Adafruit_PWMServoDriver(pcaAddresses[b]);
+  }
 
   // Load default values from settings.h
   for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
@@ -13,6 +56,11 @@ ServoController::ServoController() : isInitialized(false) {
 }
 
 bool ServoController::begin() {
+  // Shared by every instrument: initialized once
+  if (isInitialized) {
+    return true;
+  }
+
   // Initialize I2C with ESP32 custom pins
   Wire.begin(I2C_SDA, I2C_SCL);
   Serial.print("I2C initialized - SDA: GPIO");
@@ -20,28 +68,27 @@ bool ServoController::begin() {
   Serial.print(", SCL: GPIO");
   Serial.println(I2C_SCL);
 
-  // Initialize first PWM driver
-  if (!pwm1.begin()) {
-    Serial.println("ERROR: PCA1 (0x40) I2C communication failed!");
-    Serial.println("Check wiring and I2C address.");
-    return false;
-  }
-  pwm1.setOscillatorFrequency(27000000);
-  pwm1.setPWMFreq(SERVO_FREQUENCY);
-
-  // Initialize second PWM driver
-  if (!pwm2.begin()) {
-    Serial.println("ERROR: PCA2 (0x41) I2C communication failed!");
-    Serial.println("Check wiring and I2C address.");
-    return false;
+  // Initialize every PWM driver
+  for (uint8_t b = 0; b < PCA_BOARD_COUNT; b++) {
+    if (!pwm[b].begin()) {
+      Serial.print("ERROR: PCA");
+      Serial.print(b + 1);
+      Serial.print(" (0x");
+      Serial.print(pcaAddresses[b], HEX);
+      Serial.println(") I2C communication failed!");
+      Serial.println("Check wiring and I2C address.");
+      return false;
+    }
+    pwm[b].setOscillatorFrequency(27000000);
+    pwm[b].setPWMFreq(SERVO_FREQUENCY);
   }
-  pwm2.setOscillatorFrequency(27000000);
-  pwm2.setPWMFreq(SERVO_FREQUENCY);
 
   isInitialized = true;
-  Serial.println("ServoController: Both PWM drivers initialized successfully");
+  Serial.print("ServoController: ");
+  Serial.print(PCA_BOARD_COUNT);
+  Serial.println(" PWM drivers initialized successfully");
 
-  resetServosPosition();
+  startHoming();
   return true;
 }
 
@@ -66,6 +113,15 @@ void ServoController::setServoAngle(uint8_t servoNum, uint16_t angle) {
     return;
   }
 
+  uint16_t analog_value = angleToTicks(angle);
+
+  // Board and channel from the generated map, checked at compile time
+  uint8_t slot = servoSlots[servoNum];
+  pwm[slot / PCA_CHANNEL_COUNT].setPWM(slot % PCA_CHANNEL_COUNT, 0, analog_value);
+  latencyStats.busWritten();
+}
+
+uint16_t ServoController::angleToTicks(uint16_t angle) {
   if (angle < SERVO_MIN_ANGLE || angle > SERVO_MAX_ANGLE) {
     if (DEBUG) {
       Serial.print("WARNING: Angle ");
@@ -80,29 +136,76 @@ void ServoController::setServoAngle(uint8_t servoNum, uint16_t angle) {
 
   // Optimized calculation without float conversion
   // analog_value = (pulsation * SERVO_FREQUENCY * 4096) / MICROSECONDS_PER_SECOND
-  uint32_t analog_value = ((uint32_t)pulsation * SERVO_FREQUENCY * 4096UL) / MICROSECONDS_PER_SECOND;
+  return ((uint32_t)pulsation * SERVO_FREQUENCY * 4096UL) / MICROSECONDS_PER_SECOND;
+}
 
-  // Select the appropriate PWM driver
-  if (servoNum < PWM_CHANNELS_PER_DRIVER) {
-    pwm1.setPWM(servoNum, 0, analog_value);
-  } else {
-    pwm2.setPWM(servoNum - PWM_CHANNELS_PER_DRIVER, 0, analog_value);
+void ServoController::setAirAngle(uint8_t channel, uint8_t angle) {
+  if (!isInitialized || !AIR_ON_PCA) {
+    return;
   }
+  pwm[AIR_PCA_BOARD].setPWM(channel, 0, angleToTicks(angle));
 }
 
-void ServoController::resetServosPosition() {
+void ServoController::startHoming() {
   // Utilisé au démarrage pour déplacer tout les servos en position initiale
   if (!isInitialized) {
     Serial.println("ERROR: Cannot reset servos - controller not initialized!");
     return;
   }
 
-  Serial.println("Resetting all servos to initial positions...");
-  for (uint8_t i = 0; i < NUMBER_OF_NOTES; ++i) {
-    setServoAngle(i, currentAngles[i]);
-    delay(SERVO_RESET_DELAY_MS); // délai pour laisser les servos se déplacer
+  homingNext = 0;
+  homingGroupMask = 0;
+  homingStepTime = millis() - SERVO_RESET_DELAY_MS; // first group right away
+
+  Serial.println("Homing servos in the background...");
+  updateHoming(millis());
+}
+
+void ServoController::updateHoming(unsigned long now) {
+  if (isHomingComplete()) {
+    return;
+  }
+  if (now - homingStepTime < SERVO_RESET_DELAY_MS) {
+    return; // laisser le groupe précédent finir son déplacement
+  }
+
+  // The previous group has had time to move: its notes become playable
+  if (homingGroupMask != 0) {
+    if (homedMask == 0) {
+      Serial.print("First note playable at ");
+      Serial.print(now);
+      Serial.println(" ms");
+    }
+    homedMask |= homingGroupMask;
+    homingGroupMask = 0;
+  }
+
+  // Next group
+  uint8_t count = 0;
+  while (homingNext < NUMBER_OF_NOTES && count < HOMING_GROUP_SIZE) {
+    setServoAngle(homingNext, currentAngles[homingNext]);
+    homingGroupMask |= (ServoMask)1 << homingNext;
+    homingNext++;
+    count++;
+  }
+  homingStepTime = now;
+
+  if (isHomingComplete()) {
+    Serial.print("All servos homed at ");
+    Serial.print(now);
+    Serial.println(" ms");
+  }
+}
+
+bool ServoController::isHomingComplete() {
+  return homingNext >= NUMBER_OF_NOTES && homingGroupMask == 0;
+}
+
+void ServoController::update() {
+  if (!isInitialized) {
+    return;
   }
-  Serial.println("All servos reset complete");
+  updateHoming(millis());
 }
 
 // Active la note avec le servo (position fixe noteOn)
@@ -122,6 +225,11 @@ void ServoController::noteOn(uint8_t servoNum) {
     return;
   }
 
+  // Servo pas encore initialisé par le homing
+  if (!(homedMask & ((ServoMask)1 << servoNum))) {
+    return;
+  }
+
   // Position fixe pour appuyer sur la touche
   // sensRot détermine le sens de rotation (+1 ou -1)
   setServoAngle(servoNum, currentAngles[servoNum] - ANGLE_NOTE_ON * currentDirections[servoNum]);
@@ -144,5 +252,9 @@ void ServoController::noteOff(uint8_t servoNum) {
     return;
   }
 
+  if (!(homedMask & ((ServoMask)1 << servoNum))) {
+    return;
+  }
+
   setServoAngle(servoNum, currentAngles[servoNum]);
 }
\ No newline at end of file
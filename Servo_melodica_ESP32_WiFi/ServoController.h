@@ -4,15 +4,29 @@
 #include <Adafruit_PWMServoDriver.h>
 #include "settings.h"
 
+// One bit per servo
+#define MAX_SERVOS 64
+#if NUMBER_OF_NOTES <= 32
+typedef uint32_t ServoMask;
+#else
+typedef uint64_t ServoMask;
+#endif
+static_assert(NUMBER_OF_NOTES <= MAX_SERVOS, "ServoMask holds at most 64 servos");
+
 class ServoController {
 private:
-  Adafruit_PWMServoDriver pwm1;
-  Adafruit_PWMServoDriver pwm2;
+  Adafruit_PWMServoDriver pwm[PCA_BOARD_COUNT]; // Une carte par adresse de pcaAddresses
   bool isInitialized;
   uint16_t currentAngles[NUMBER_OF_NOTES];     // Current servo angles
   int8_t currentDirections[NUMBER_OF_NOTES];   // Current servo directions
+  ServoMask homedMask;        // Servos at a known position, playable
+  ServoMask homingGroupMask;  // Servos commanded by the current homing step
+  uint8_t homingNext;         // Next servo to home
+  unsigned long homingStepTime;
   void setServoAngle(uint8_t servoNum, uint16_t angle);
-  void resetServosPosition();// utilisé au demarrage pour deplacer les servos en position init-angle
+  uint16_t angleToTicks(uint16_t angle);
+  void startHoming();  // utilisé au demarrage pour deplacer les servos en position init-angle
+  void updateHoming(unsigned long now); // Étape suivante du homing, non bloquant
 
 public:
   ServoController(); //initialise toutles servomoteurs a l'angle de depart
@@ -20,6 +34,9 @@ public:
   bool isReady(); // Check if controllers are properly initialized
   void noteOff(uint8_t servoNum); // Relâche la touche (position repos)
   void noteOn(uint8_t servoNum);  // Appuie sur la touche (position fixe)
+  void setAirAngle(uint8_t channel, uint8_t angle); // Valve d'air sur la carte AIR_PCA_BOARD (AIR_ON_PCA)
+  void update(); // Homing en tâche de fond, à appeler depuis Instrument::update()
+  bool isHomingComplete();
 };
 
 #endif // SERVOCONTROLLER_H
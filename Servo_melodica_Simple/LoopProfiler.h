@@ -0,0 +1,97 @@
+#ifndef LOOPPROFILER_H
+#define LOOPPROFILER_H
+
+#include <Arduino.h>
+#include "settings.h"
+#include "LogHistogram.h"
+/***********************************************************************************************
+----------------------------    LoopProfiler.h   ----------------------------------------
+************************************************************************************************
+
+Durée de chaque étape de loop(), pour voir quand un appel bloquant affame la lecture MIDI
+
+Une itération = begin() ... end(), découpée par lap(étape) : le temps écoulé depuis le lap
+précédent est ajouté à l'étape (plusieurs laps d'une même étape s'additionnent, ex. un
+instrument après l'autre). À end(), chaque étape et l'itération entière sont enregistrées :
+- min / moyenne / max en µs, et p50 / p99 par seaux fixes : < 16 µs, puis un seau par
+  doublement, le dernier sans limite
+- itérations plus longues que LOOP_DEADLINE_US (MIDI non lu pendant ce temps)
+- détail par étape de la pire itération
+- étapes : lecture du transport, dispatch (instruments), air (écriture du servo d'air, prise
+  sur le dispatch), flush (homing + trames I2C) ; les étapes jamais mesurées ne sont pas
+  affichées
+- hors itération (setup(), commande série après end()), lap() ne compte rien
+- mis à jour par une seule tâche ; print() ou reset() depuis une autre (ESP32 double cœur)
+  peut lire un échantillon à moitié écrit ou en perdre un
+- LOOP_PROFILER 0 : classe vide, appels supprimés à la compilation
+Lecture : print() (commande série 's', 'S' = remise à zéro)
+
+************************************************************************************************/
+
+#define LOOP_PROFILE_BUCKETS 12
+#define LOOP_PROFILE_FIRST_BUCKET_SHIFT 4  // First bucket: below 1 << 4 = 16 µs
+
+typedef LogHistogram<LOOP_PROFILE_BUCKETS, LOOP_PROFILE_FIRST_BUCKET_SHIFT> LoopHistogram;
+
+enum LoopStage : uint8_t {
+  LOOP_READ,       // Lecture du transport MIDI (USB, DIN, BLE, RTP)
+  LOOP_DISPATCH,   // Événements de la file et notes planifiées
+  LOOP_AIR,        // Écriture de l'angle d'air
+  LOOP_FLUSH,      // ServoController::update() : homing, relâchements, trames I2C
+  LOOP_ITERATION,  // begin() -> end()
+  LOOP_STAGE_COUNT
+};
+
+#if LOOP_PROFILER
+
+struct LoopStageStats {
+  uint32_t min;
+  uint32_t max;
+  uint32_t sum;     // Halved with count when it would overflow: the average is kept
+  uint32_t count;
+  uint16_t buckets[LOOP_PROFILE_BUCKETS];
+};
+
+class LoopProfiler {
+private:
+  LoopStageStats stats[LOOP_STAGE_COUNT];
+  uint32_t current[LOOP_STAGE_COUNT];  // Durations of the iteration in progress
+  uint32_t worst[LOOP_STAGE_COUNT];    // Breakdown of the longest iteration
+  uint32_t iterationStart;
+  uint32_t lapStart;
+  uint32_t deadlineMisses;
+  bool running;
+  void record(uint8_t stage, uint32_t duration);
+
+public:
+  LoopProfiler();
+  void begin();                 // Début d'une itération
+  void lap(uint8_t stage);      // Temps depuis le lap précédent (ou begin()) ajouté à l'étape
+  void end();                   // Fin de l'itération : enregistre les étapes et le total
+
+  uint32_t getMin(uint8_t stage);
+  uint32_t getAverage(uint8_t stage);
+  uint32_t getMax(uint8_t stage);
+  uint32_t getCount(uint8_t stage);
+  uint8_t percentileBucket(uint8_t stage, uint16_t permille); // LOG_HISTOGRAM_NO_BUCKET if empty
+  uint32_t getDeadlineMisses();
+  void reset();
+  void print(Print& out, const char* name = "loop");
+};
+
+#else
+
+class LoopProfiler {
+public:
+  void begin() {}
+  void lap(uint8_t) {}
+  void end() {}
+  void reset() {}
+  void print(Print& out, const char* = "loop") { out.println("loop profiler disabled (LOOP_PROFILER 0)"); }
+};
+
+#endif // LOOP_PROFILER
+
+extern LoopProfiler loopProfiler; // Itérations de loop(), laps posés par le sketch et l'instrument
+
+#endif // LOOPPROFILER_H
@@ -1,4 +1,5 @@
  #include "midiHandler.h"
+#include "LoopProfiler.h"
 
 MidiHandler::MidiHandler(Instrument &instrument) : _instrument(instrument) {
   if (DEBUG) {
@@ -10,8 +11,10 @@ void MidiHandler::readMidi() {
   midiEventPacket_t midiEvent;
   do {
     midiEvent = MidiUSB.read();
+    loopProfiler.lap(LOOP_READ);
     if (midiEvent.header != 0) {
-      processMidiEvent(midiEvent);
+      processMidiEvent(midiEvent); // Notes jouées tout de suite, air compris
+      loopProfiler.lap(LOOP_DISPATCH);
     }
   } while (midiEvent.header != 0);
 }
@@ -18,6 +18,7 @@ il va peut etre falloir ajouter un systeme pour attendre le deplacement des serv
 #include <MIDIUSB.h>
 #include "Instrument.h"
 #include "MidiHandler.h"
+#include "LoopProfiler.h"
 #include "Arduino.h"
 
 Instrument* instrument= nullptr;
@@ -34,7 +35,29 @@ void setup() {
   Serial.println("fin init");
 }
 
+// Moniteur série : 's' = profil de loop(), 'S' = remise à zéro
+void readSerialCommand() {
+  if (!Serial.available()) {
+    return;
+  }
+  switch (Serial.read()) {
+    case 's':
+      loopProfiler.print(Serial);
+      break;
+    case 'S':
+      loopProfiler.reset();
+      Serial.println("loop profiler reset");
+      break;
+  }
+}
+
 void loop() {
+  loopProfiler.begin();
   midiHandler->readMidi();
   instrument->update();
+  loopProfiler.end(); // Printing a report is not part of the iteration
+
+  if (LOOP_PROFILER) {
+    readSerialCommand();
+  }
 }
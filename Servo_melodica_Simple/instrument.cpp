@@ -1,4 +1,5 @@
 #include "Instrument.h"
+#include "LoopProfiler.h"
 
 Instrument::Instrument() : servoController(), activeNotesCount(0), currentVolume(127), currentAirAngle(AIR_CLOSED_ANGLE) {
   if (DEBUG) {
@@ -94,7 +95,9 @@ void Instrument::openAir(uint8_t note, uint8_t velocity) {
   // Si l'angle demandé est supérieur à l'angle actuel, mettre à jour
   if (targetAngle > currentAirAngle) {
     currentAirAngle = targetAngle;
+    loopProfiler.lap(LOOP_DISPATCH);
     airServo.write(currentAirAngle);
+    loopProfiler.lap(LOOP_AIR);
   }
 
   if (DEBUG) {
@@ -112,7 +115,9 @@ void Instrument::openAir(uint8_t note, uint8_t velocity) {
 void Instrument::closeAir() {
   // Ferme la valve d'air
   currentAirAngle = AIR_CLOSED_ANGLE;
+  loopProfiler.lap(LOOP_DISPATCH);
   airServo.write(currentAirAngle);
+  loopProfiler.lap(LOOP_AIR);
 
   if (DEBUG) {
     Serial.println("Air closed - No active notes");
@@ -12,6 +12,11 @@
 //note la plus grave du melodica
 #define FIRST_MIDI_NOTE 65
 
+// Durées min/moy/max et p50/p99 des étapes de loop() (LoopProfiler.h) : lecture, dispatch, air,
+// commande série 's' ('S' = remise à zéro). ~260 octets de RAM. 0 = code retiré à la compilation
+#define LOOP_PROFILER 0
+#define LOOP_DEADLINE_US 1000     // Itération plus longue = comptée en retard (une trame USB = 1 ms)
+
 //------------------------------------------- Air Manager -------------------------
 // Servo d'air branché directement sur PWM Arduino
 #define AIR_SERVO_PIN 9           // Pin PWM pour servo de valve d'air
@@ -39,7 +44,7 @@ const int8_t sensRot[NUMBER_OF_NOTES] {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1
 
 #define PCA1_ADRESS 0x40
 #define PCA2_ADRESS 0x41
-#define PWM_CHANNELS_PER_DRIVER 15  // Number of PWM channels per PCA9685
+#define PWM_CHANNELS_PER_DRIVER 16  // Number of PWM channels per PCA9685 (servos 0-15 on PCA1, 16-31 on PCA2)
 
 #define PIN_PCA_OFF 5// pin pour desactiver alim des servos et reduire le bruit
 
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "MidiScript.h"
+
+bool readScript(std::istream& in, std::vector<ScriptEvent>& events) {
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line)) {
+    lineNumber++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    double ms;
+    if (!(fields >> ms)) {
+      continue;
+    }
+    ScriptEvent event;
+    event.micros = (uint64_t)(ms * 1000);
+    event.din = false;
+    std::string token;
+    while (fields >> token) {
+      if (token == "din") {
+        event.din = true;
+        continue;
+      }
+      event.bytes.push_back((uint8_t)std::stoul(token, nullptr, 16));
+    }
+    if (event.bytes.empty() || (!event.din && event.bytes.size() > 3)) {
+      std::cerr << "line " << lineNumber << ": expected 1 to 3 bytes (or din <bytes>)\n";
+      return false;
+    }
+    events.push_back(event);
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const ScriptEvent& a, const ScriptEvent& b) { return a.micros < b.micros; });
+  return true;
+}
@@ -0,0 +1,26 @@
+#ifndef MIDISCRIPT_H
+#define MIDISCRIPT_H
+
+#include <stdint.h>
+#include <istream>
+#include <vector>
+/***********************************************************************************************
+----------------------------    MidiScript.h   ----------------------------------------
+************************************************************************************************
+
+Scripts MIDI texte de melodica_sim et du banc simavr (scripts/)
+- une ligne par message : "<ms> <statut> <donnée1> <donnée2>" en hexadécimal
+- '#' pour un commentaire ; "din" avant les octets : octets bruts pour la prise DIN
+
+************************************************************************************************/
+
+struct ScriptEvent {
+  uint64_t micros;             // From the start of the script
+  bool din;                    // Raw bytes for Serial1, else one USB-MIDI message
+  std::vector<uint8_t> bytes;
+};
+
+// Events sorted by time, false (line number on stderr) on a malformed line
+bool readScript(std::istream& in, std::vector<ScriptEvent>& events);
+
+#endif // MIDISCRIPT_H
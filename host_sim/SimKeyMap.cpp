@@ -0,0 +1,55 @@
+#include "SimHost.h"
+#include "SimKeyMap.h"
+#include "settings.h"
+#include "NoteRouting.h"
+
+static bool airChannel(uint8_t board, uint8_t channel) {
+  if (!AIR_ON_PCA || board != AIR_PCA_BOARD) {
+    return false;
+  }
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    if (instrumentAirChannel[i] == channel) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SimKeyMap::servoChannel(uint8_t servo, uint8_t& address, uint8_t& pcaChannel) {
+  uint8_t free = 0;
+  for (uint8_t board = 0; board < PCA_BOARD_COUNT; board++) {
+    for (uint8_t channel = 0; channel < PCA_CHANNEL_COUNT; channel++) {
+      if (airChannel(board, channel)) {
+        continue;
+      }
+      if (free++ == servo) {
+        address = pcaAddresses[board];
+        pcaChannel = channel;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool SimKeyMap::noteChannel(uint8_t midiChannel, uint8_t note, uint8_t& address, uint8_t& pcaChannel) {
+  uint8_t instrument = channelInstrument[midiChannel & 0x0F];
+  if (instrument >= INSTRUMENT_COUNT) {
+    return false;
+  }
+  int routed = note + instrumentTranspose[instrument];
+  if (routed < 0 || routed > 127) {
+    return false;
+  }
+  uint8_t key = pgm_read_byte(&noteRouting[routed]);
+  if (key == NO_SERVO || key >= instrumentServoCount[instrument]) {
+    return false;
+  }
+  return servoChannel(instrumentFirstServo[instrument] + key, address, pcaChannel);
+}
+
+void SimKeyMap::addBoards() {
+  for (uint8_t board = 0; board < PCA_BOARD_COUNT; board++) {
+    SimHost::addPca9685(pcaAddresses[board]);
+  }
+}
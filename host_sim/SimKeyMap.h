@@ -0,0 +1,24 @@
+#ifndef SIMKEYMAP_H
+#define SIMKEYMAP_H
+
+#include <stdint.h>
+/***********************************************************************************************
+----------------------------    SimKeyMap.h   ----------------------------------------
+************************************************************************************************
+
+Canal PCA9685 d'une note MIDI, pour relier une note injectée à l'écriture I2C qui la joue
+Même règle que ServoController (servo n = n-ième canal libre, canaux des valves sautés)
+et même routage que Instrument::getServo (noteRouting, instrumentTranspose)
+
+************************************************************************************************/
+
+namespace SimKeyMap {
+
+// false if the note is not played on this MIDI channel (0-15)
+bool noteChannel(uint8_t midiChannel, uint8_t note, uint8_t& address, uint8_t& pcaChannel);
+bool servoChannel(uint8_t servo, uint8_t& address, uint8_t& pcaChannel);
+void addBoards(); // Declares every board of pcaAddresses on the simulated bus
+
+}
+
+#endif // SIMKEYMAP_H
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include "SmfReader.h"
+
+namespace {
+
+struct RawEvent {
+  uint64_t tick;
+  uint32_t order;    // Track, then position: simultaneous events keep the file order
+  uint32_t tempo;    // Microseconds per quarter note, 0 = channel message
+  uint8_t status, data1, data2;
+};
+
+class Cursor {
+public:
+  Cursor(const std::vector<uint8_t>& bytes, size_t start, size_t end) : data(bytes), pos(start), limit(end) {}
+  bool atEnd() const { return pos >= limit; }
+  bool byte(uint8_t& value) {
+    if (pos >= limit) {
+      return false;
+    }
+    value = data[pos++];
+    return true;
+  }
+  bool peek(uint8_t& value) const {
+    if (pos >= limit) {
+      return false;
+    }
+    value = data[pos];
+    return true;
+  }
+  bool variableLength(uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+      uint8_t b;
+      if (!byte(b)) {
+        return false;
+      }
+      value = (value << 7) | (b & 0x7F);
+      if (!(b & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool skip(uint32_t count) {
+    if (limit - pos < count) {
+      return false;
+    }
+    pos += count;
+    return true;
+  }
+  size_t position() const { return pos; }
+
+private:
+  const std::vector<uint8_t>& data;
+  size_t pos;
+  size_t limit;
+};
+
+uint32_t bigEndian(const std::vector<uint8_t>& bytes, size_t pos, int count) {
+  uint32_t value = 0;
+  for (int i = 0; i < count; i++) {
+    value = (value << 8) | bytes[pos + i];
+  }
+  return value;
+}
+
+bool readTrack(Cursor track, uint32_t trackIndex, std::vector<RawEvent>& raw, std::string& error) {
+  uint64_t tick = 0;
+  uint8_t runningStatus = 0;
+  uint32_t position = 0;
+
+  while (!track.atEnd()) {
+    uint32_t delta;
+    uint8_t status;
+    if (!track.variableLength(delta) || !track.peek(status)) {
+      error = "truncated track";
+      return false;
+    }
+    tick += delta;
+
+    if (status & 0x80) {
+      track.byte(status);
+    } else if (runningStatus) {
+      status = runningStatus; // Data byte: running status
+    } else {
+      error = "data byte without status";
+      return false;
+    }
+
+    if (status == 0xFF) {
+      uint8_t type;
+      uint32_t length;
+      if (!track.byte(type) || !track.variableLength(length)) {
+        error = "truncated meta event";
+        return false;
+      }
+      if (type == 0x2F) {
+        break; // End of track
+      }
+      if (type == 0x51 && length == 3) {
+        uint8_t a, b, c;
+        track.byte(a);
+        track.byte(b);
+        track.byte(c);
+        raw.push_back({tick, trackIndex << 20 | position++, (uint32_t)(a << 16 | b << 8 | c), 0, 0, 0});
+      } else if (!track.skip(length)) {
+        error = "truncated meta event";
+        return false;
+      }
+      runningStatus = 0;
+      continue;
+    }
+    if (status == 0xF0 || status == 0xF7) {
+      uint32_t length;
+      if (!track.variableLength(length) || !track.skip(length)) {
+        error = "truncated SysEx";
+        return false;
+      }
+      runningStatus = 0;
+      continue;
+    }
+    if (status >= 0xF0) {
+      error = "system message in a track";
+      return false;
+    }
+
+    runningStatus = status;
+    uint8_t data1 = 0;
+    uint8_t data2 = 0;
+    uint8_t type = status & 0xF0;
+    if (!track.byte(data1) || ((type != 0xC0 && type != 0xD0) && !track.byte(data2))) {
+      error = "truncated channel message";
+      return false;
+    }
+    raw.push_back({tick, trackIndex << 20 | position++, 0, status, data1, data2});
+  }
+  return true;
+}
+
+}
+
+bool readSmf(const std::string& path, std::vector<SmfEvent>& events, std::string& error) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    error = "cannot open";
+    return false;
+  }
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  if (bytes.size() < 14 || bigEndian(bytes, 0, 4) != 0x4D546864 /* MThd */ || bigEndian(bytes, 4, 4) < 6) {
+    error = "not a Standard MIDI File";
+    return false;
+  }
+  uint16_t format = bigEndian(bytes, 8, 2);
+  uint16_t trackCount = bigEndian(bytes, 10, 2);
+  uint16_t division = bigEndian(bytes, 12, 2);
+  if (format > 1) {
+    error = "only type 0 and 1 files are supported";
+    return false;
+  }
+  if (division == 0) {
+    error = "null time division";
+    return false;
+  }
+
+  std::vector<RawEvent> raw;
+  size_t pos = 8 + bigEndian(bytes, 4, 4);
+  for (uint32_t track = 0; track < trackCount; track++) {
+    if (pos + 8 > bytes.size()) {
+      error = "missing track";
+      return false;
+    }
+    uint32_t length = bigEndian(bytes, pos + 4, 4);
+    if (bigEndian(bytes, pos, 4) != 0x4D54726B /* MTrk */ || pos + 8 + length > bytes.size()) {
+      error = "bad track header";
+      return false;
+    }
+    if (!readTrack(Cursor(bytes, pos + 8, pos + 8 + length), track, raw, error)) {
+      return false;
+    }
+    pos += 8 + length;
+  }
+
+  std::sort(raw.begin(), raw.end(), [](const RawEvent& a, const RawEvent& b) {
+    return a.tick != b.tick ? a.tick < b.tick : a.order < b.order;
+  });
+
+  // Ticks -> microseconds through the tempo map (120 bpm until the first tempo event)
+  double microsPerTick;
+  uint32_t tempo = 500000;
+  bool smpte = division & 0x8000;
+  if (smpte) {
+    int framesPerSecond = -(int8_t)(division >> 8);
+    microsPerTick = 1000000.0 / (framesPerSecond * (division & 0xFF));
+  } else {
+    microsPerTick = (double)tempo / division;
+  }
+  double micros = 0;
+  uint64_t lastTick = 0;
+  events.clear();
+  for (const RawEvent& event : raw) {
+    micros += (event.tick - lastTick) * microsPerTick;
+    lastTick = event.tick;
+    if (event.tempo) {
+      if (!smpte) {
+        microsPerTick = (double)event.tempo / division;
+      }
+      continue;
+    }
+    events.push_back({(uint64_t)(micros + 0.5), event.status, event.data1, event.data2});
+  }
+  return true;
+}
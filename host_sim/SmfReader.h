@@ -0,0 +1,28 @@
+#ifndef SMFREADER_H
+#define SMFREADER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+/***********************************************************************************************
+----------------------------    SmfReader.h   ----------------------------------------
+************************************************************************************************
+
+Lecture d'un Standard MIDI File (type 0 ou 1) en une liste de messages de canal datés
+- pistes fusionnées, running status, tempo (méta 0x51) de n'importe quelle piste
+- division en ticks par noire ou SMPTE
+- SysEx et autres méta-événements ignorés
+
+************************************************************************************************/
+
+struct SmfEvent {
+  uint64_t micros;   // From the start of the file, tempo map applied
+  uint8_t status;    // 0x80-0xEF
+  uint8_t data1;
+  uint8_t data2;     // 0 for 1-byte messages
+};
+
+// false with a message in error if the file is not a readable SMF
+bool readSmf(const std::string& path, std::vector<SmfEvent>& events, std::string& error);
+
+#endif // SMFREADER_H
@@ -0,0 +1,81 @@
+#include <string.h>
+#include "TwiPca9685.h"
+#include "avr_twi.h"
+
+#define PCA9685_MODE1 0x00
+#define PCA9685_MODE1_SLEEP 0x10
+#define PCA9685_MODE1_AI 0x20
+#define PCA9685_PRESCALE 0xFE
+
+static const char* irqNames[2] = {"8<pca9685.out", "32>pca9685.in"};
+
+TwiPca9685::TwiPca9685(avr_t* avr, const uint8_t* boardAddresses, uint8_t count)
+  : selected(-1), registerPending(false), pointer(0), transactions(0), bytes(0) {
+  boardCount = count < TWI_PCA9685_MAX_BOARDS ? count : TWI_PCA9685_MAX_BOARDS;
+  memcpy(addresses, boardAddresses, boardCount);
+  memset(registers, 0, sizeof(registers));
+  for (uint8_t board = 0; board < boardCount; board++) {
+    registers[board][PCA9685_MODE1] = 0x11; // Power-on: sleep, ALLCALL
+    registers[board][PCA9685_PRESCALE] = 0x1E;
+  }
+
+  irq = avr_alloc_irq(&avr->irq_pool, 0, 2, irqNames);
+  avr_irq_register_notify(irq + TWI_IRQ_OUTPUT, onMessage, this);
+  avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), irq + TWI_IRQ_OUTPUT);
+  avr_connect_irq(irq + TWI_IRQ_INPUT, avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+}
+
+void TwiPca9685::reply(uint8_t msg, uint8_t address, uint8_t data) {
+  avr_raise_irq(irq + TWI_IRQ_INPUT, avr_twi_irq_msg(msg, address, data));
+}
+
+void TwiPca9685::onMessage(avr_irq_t* irq, uint32_t value, void* param) {
+  TwiPca9685* self = (TwiPca9685*)param;
+  avr_twi_msg_irq_t message;
+  message.u.v = value;
+  uint8_t address = message.u.twi.addr;
+
+  if (message.u.twi.msg & TWI_COND_STOP) {
+    self->selected = -1;
+  }
+  // START (or repeated START) carries the address byte: ACK if it is one of our boards
+  if (message.u.twi.msg & TWI_COND_START) {
+    self->bytes++;
+    self->selected = -1;
+    for (uint8_t board = 0; board < self->boardCount; board++) {
+      if (self->addresses[board] == address >> 1) {
+        self->selected = board;
+        self->registerPending = !(address & 1);
+        self->transactions++;
+        self->reply(TWI_COND_ACK, address, 1);
+      }
+    }
+  }
+  if (self->selected < 0) {
+    return; // Not one of ours: NACK by silence
+  }
+  uint8_t* registers = self->registers[self->selected];
+  if (message.u.twi.msg & TWI_COND_WRITE) {
+    self->bytes++;
+    if (self->registerPending) {
+      self->pointer = message.u.twi.data;
+      self->registerPending = false;
+    } else {
+      if (self->pointer != PCA9685_PRESCALE || (registers[PCA9685_MODE1] & PCA9685_MODE1_SLEEP)) {
+        registers[self->pointer] = message.u.twi.data; // Prescale only written in sleep
+      }
+      if (registers[PCA9685_MODE1] & PCA9685_MODE1_AI) {
+        self->pointer++;
+      }
+    }
+    self->reply(TWI_COND_ACK, address, 1);
+  }
+  if (message.u.twi.msg & TWI_COND_READ) {
+    self->bytes++;
+    self->reply(TWI_COND_READ, address, registers[self->pointer]);
+    if (registers[PCA9685_MODE1] & PCA9685_MODE1_AI) {
+      self->pointer++;
+    }
+  }
+}
+
@@ -0,0 +1,38 @@
+#ifndef TWI_PCA9685_H
+#define TWI_PCA9685_H
+
+#include <stdint.h>
+#include "sim_avr.h"
+/***********************************************************************************************
+----------------------------    TwiPca9685.h   ----------------------------------------
+************************************************************************************************
+
+Esclaves TWI simavr : les cartes PCA9685 de settings.h (pcaAddresses) sur le bus de l'ATmega32u4
+- acquitte son adresse et chaque octet écrit, répond aux lectures (MODE1 pour setPWMFreq)
+- registres avec auto-incrément, comme le modèle de host_sim/mocks/Wire.cpp
+- compte les transactions et les octets pour le banc (adresse comprise)
+
+************************************************************************************************/
+
+#define TWI_PCA9685_MAX_BOARDS 8
+
+class TwiPca9685 {
+private:
+  avr_irq_t* irq;                    // TWI_IRQ_INPUT/OUTPUT côté esclave
+  uint8_t addresses[TWI_PCA9685_MAX_BOARDS];
+  uint8_t registers[TWI_PCA9685_MAX_BOARDS][256];
+  uint8_t boardCount;
+  int8_t selected;                   // Carte adressée, -1 = aucune
+  bool registerPending;              // Le prochain octet écrit est le pointeur de registre
+  uint8_t pointer;
+  static void onMessage(avr_irq_t* irq, uint32_t value, void* param);
+  void reply(uint8_t msg, uint8_t address, uint8_t data);
+
+public:
+  uint32_t transactions;             // Adresses acquittées (un START ou START répété)
+  uint32_t bytes;                    // Octets sur le bus, adresse comprise
+
+  TwiPca9685(avr_t* avr, const uint8_t* boardAddresses, uint8_t count);
+};
+
+#endif // TWI_PCA9685_H
@@ -0,0 +1,312 @@
+/***********************************************************************************************
+----------------------------    avr_bench   ----------------------------------------
+************************************************************************************************
+
+Compte les cycles de l'ATmega32u4 du firmware Servo_melodica sous simavr : le firmware de
+mesure (melodica_avr_bench.ino, compilé par arduino-cli pour la Leonardo) tourne sur le cœur
+simulé, les cartes PCA9685 de settings.h répondent sur le bus TWI (TwiPca9685)
+
+  melodica_avr_bench [--json] [--check baseline.jsonl [--tolerance PCT]] firmware.elf [script]
+
+- noteOn, noteOff, allNotesOff et flush (ServoController::update) : appels directs du firmware
+- loop() : chaque itération pendant le script (scripts/ ou fichier .mid), injecté octet par
+  octet sur l'UART de la prise DIN, un octet toutes les 320 µs comme à 31250 bauds (la FIFO
+  d'entrée de simavr ne se remplit jamais) ; séparé en loop_idle (aucun accès au bus)
+  et loop_bus. L'USB n'est pas simulé : MidiStreamParser en fait les mêmes paquets USB-MIDI
+- cycles exacts hors coût des marqueurs (mesure vide soustraite), µs à 16 MHz
+
+************************************************************************************************/
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "avr_uart.h"
+#include "MidiScript.h"
+#include "SmfReader.h"
+#include "TwiPca9685.h"
+#include "settings.h"
+
+#define AVR_FREQUENCY 16000000
+#define GPIOR0_ADDRESS 0x3E   // Marker: measure begins, value = measure number
+#define GPIOR1_ADDRESS 0x4A   // Marker: measure ends
+#define GPIOR2_ADDRESS 0x4B   // Phase
+#define PHASE_MIDI 2
+#define SCRIPT_LEAD_MS 100    // First script event after the phase marker
+#define SCRIPT_TAIL_MS 500    // Releases and air hang time after the last one
+#define SETUP_TIMEOUT_S 60    // Simulated seconds before giving up on the direct measures
+#define DIN_BYTE_US (10 * 1000000UL / DIN_MIDI_BAUD)  // Start + 8 data + stop bits: 320 µs at 31250 bauds
+
+// Tools the cycles depend on, from avr/CMakeLists.txt: first line of the --json output
+#ifndef BENCH_TOOLCHAIN
+#define BENCH_TOOLCHAIN "unknown"
+#endif
+#ifndef BENCH_SIMAVR
+#define BENCH_SIMAVR "unknown"
+#endif
+
+// Numbering of melodica_avr_bench.ino, then the split of MEASURE_LOOP
+enum {
+  MEASURE_EMPTY,
+  MEASURE_NOTE_ON,
+  MEASURE_NOTE_OFF,
+  MEASURE_ALL_NOTES_OFF,
+  MEASURE_FLUSH,
+  MEASURE_LOOP,
+  MEASURE_LOOP_IDLE,
+  MEASURE_LOOP_BUS,
+  MEASURE_COUNT
+};
+static const char* measureNames[MEASURE_COUNT] = {"empty",  "noteOn", "noteOff",   "allNotesOff",
+                                                  "flush",  "loop",   "loop_idle", "loop_bus"};
+#define NO_MEASURE 0xFF
+
+static std::vector<uint32_t> samples[MEASURE_COUNT];
+static TwiPca9685* boards;
+static uint8_t openMeasure = NO_MEASURE;
+static avr_cycle_count_t openCycle;
+static uint32_t openTransactions;
+static uint8_t phase;
+static avr_cycle_count_t phaseCycle;
+
+static void onBegin(avr_t* avr, avr_io_addr_t address, uint8_t value, void* param) {
+  avr->data[address] = value;
+  if (value < MEASURE_LOOP_IDLE) {
+    openMeasure = value;
+    openCycle = avr->cycle;
+    openTransactions = boards->transactions;
+  }
+}
+
+static void onEnd(avr_t* avr, avr_io_addr_t address, uint8_t value, void* param) {
+  avr->data[address] = value;
+  if (openMeasure == NO_MEASURE) {
+    return;
+  }
+  uint32_t cycles = avr->cycle - openCycle;
+  samples[openMeasure].push_back(cycles);
+  if (openMeasure == MEASURE_LOOP) {
+    samples[boards->transactions != openTransactions ? MEASURE_LOOP_BUS : MEASURE_LOOP_IDLE].push_back(cycles);
+  }
+  openMeasure = NO_MEASURE;
+}
+
+static void onPhase(avr_t* avr, avr_io_addr_t address, uint8_t value, void* param) {
+  avr->data[address] = value;
+  phase = value;
+  phaseCycle = avr->cycle;
+}
+
+static avr_cycle_count_t cyclesOf(uint64_t micros) {
+  return micros * (AVR_FREQUENCY / 1000000);
+}
+
+// Script or Standard MIDI File, as the raw bytes of the DIN stream
+static bool readInput(const std::string& path, std::vector<ScriptEvent>& events) {
+  if (path.size() > 4 && path.compare(path.size() - 4, 4, ".mid") == 0) {
+    std::vector<SmfEvent> smf;
+    std::string error;
+    if (!readSmf(path, smf, error)) {
+      std::cerr << path << ": " << error << "\n";
+      return false;
+    }
+    for (const SmfEvent& message : smf) {
+      uint8_t type = message.status & 0xF0;
+      ScriptEvent event = {message.micros, true, {message.status, message.data1}};
+      if (type != 0xC0 && type != 0xD0) {
+        event.bytes.push_back(message.data2);
+      }
+      events.push_back(event);
+    }
+    return true;
+  }
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "cannot open " << path << "\n";
+    return false;
+  }
+  return readScript(file, events);
+}
+
+struct Summary {
+  size_t count;
+  uint32_t min, max;
+  double avg, p99;
+};
+
+static Summary summarize(std::vector<uint32_t> values, uint32_t overhead) {
+  Summary summary = {values.size(), 0, 0, 0, 0};
+  if (values.empty()) {
+    return summary;
+  }
+  std::sort(values.begin(), values.end());
+  double sum = 0;
+  for (uint32_t& value : values) {
+    value -= std::min(value, overhead);
+    sum += value;
+  }
+  summary.min = values.front();
+  summary.max = values.back();
+  summary.avg = sum / values.size();
+  summary.p99 = values[(size_t)(0.99 * (values.size() - 1) + 0.5)];
+  return summary;
+}
+
+static bool jsonNumber(const std::string& line, const std::string& key, double& value) {
+  size_t pos = line.find("\"" + key + "\":");
+  if (pos == std::string::npos) {
+    return false;
+  }
+  value = std::stod(line.substr(pos + key.size() + 3));
+  return true;
+}
+
+static bool checkBaseline(const std::string& path, const Summary* summaries, double tolerance) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "cannot open baseline " << path << "\n";
+    return false;
+  }
+  bool ok = true;
+  std::string line;
+  while (std::getline(file, line)) {
+    // Another avr-gcc or simavr gives other cycles: warn, the measures still decide
+    if (line.find("\"toolchain\":") != std::string::npos
+        && line.find("\"toolchain\":\"" BENCH_TOOLCHAIN "\",\"simavr\":\"" BENCH_SIMAVR "\"") == std::string::npos) {
+      std::cerr << "warning: baseline recorded with other tools (" << line << "), this build: "
+                << BENCH_TOOLCHAIN << ", simavr " << BENCH_SIMAVR << "\n";
+    }
+    for (uint8_t measure = MEASURE_NOTE_ON; measure < MEASURE_COUNT; measure++) {
+      if (line.find(std::string("\"measure\":\"") + measureNames[measure] + "\"") == std::string::npos) {
+        continue;
+      }
+      double base;
+      if (jsonNumber(line, "avg_cycles", base) && summaries[measure].avg > base * (1 + tolerance / 100)) {
+        std::cerr << measureNames[measure] << ": avg_cycles " << base << " -> " << summaries[measure].avg << "\n";
+        ok = false;
+      }
+      if (jsonNumber(line, "max_cycles", base) && summaries[measure].max > base * (1 + tolerance / 100)) {
+        std::cerr << measureNames[measure] << ": max_cycles " << base << " -> " << summaries[measure].max << "\n";
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  double tolerance = 1;
+  std::string baseline;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--json") {
+      json = true;
+    } else if (arg == "--check" && i + 1 < argc) {
+      baseline = argv[++i];
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = std::stod(argv[++i]);
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty() || paths.size() > 2) {
+    std::cerr << "usage: melodica_avr_bench [--json] [--check baseline.jsonl [--tolerance PCT]] firmware.elf [script]\n";
+    return 2;
+  }
+
+  std::vector<ScriptEvent> events;
+  if (paths.size() > 1 && !readInput(paths[1], events)) {
+    return 2;
+  }
+
+  elf_firmware_t firmware = {};
+  if (elf_read_firmware(paths[0].c_str(), &firmware) != 0) {
+    std::cerr << "cannot load " << paths[0] << "\n";
+    return 2;
+  }
+  avr_t* avr = avr_make_mcu_by_name("atmega32u4");
+  if (!avr) {
+    std::cerr << "simavr built without the atmega32u4 core\n";
+    return 2;
+  }
+  avr_init(avr);
+  avr->frequency = AVR_FREQUENCY;
+  avr_load_firmware(avr, &firmware);
+
+  boards = new TwiPca9685(avr, pcaAddresses, PCA_BOARD_COUNT);
+  avr_register_io_write(avr, GPIOR0_ADDRESS, onBegin, nullptr);
+  avr_register_io_write(avr, GPIOR1_ADDRESS, onEnd, nullptr);
+  avr_register_io_write(avr, GPIOR2_ADDRESS, onPhase, nullptr);
+  avr_irq_t* dinInput = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT);
+
+  // Direct measures up to the phase marker, then the script over the DIN input
+  int state = cpu_Running;
+  while (phase != PHASE_MIDI && avr->cycle < cyclesOf(SETUP_TIMEOUT_S * 1000000ULL)) {
+    state = avr_run(avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+      std::cerr << "firmware stopped before the MIDI phase\n";
+      return 2;
+    }
+  }
+  if (phase != PHASE_MIDI) {
+    std::cerr << "no MIDI phase marker after " << SETUP_TIMEOUT_S << " s (homing, PLL or TWI stuck?)\n";
+    return 2;
+  }
+  uint32_t directTransactions = boards->transactions;
+
+  uint64_t offset = events.empty() ? 0 : events.front().micros;
+  avr_cycle_count_t end =
+    phaseCycle + cyclesOf((events.empty() ? 0 : events.back().micros - offset) + (SCRIPT_LEAD_MS + SCRIPT_TAIL_MS) * 1000ULL);
+  size_t next = 0;
+  std::deque<uint8_t> line;           // Bytes of due events not yet on the wire
+  avr_cycle_count_t nextByteCycle = 0;
+  while ((avr->cycle < end || !line.empty()) && state != cpu_Done && state != cpu_Crashed) {
+    while (next < events.size() &&
+           phaseCycle + cyclesOf(events[next].micros - offset + SCRIPT_LEAD_MS * 1000ULL) <= avr->cycle) {
+      line.insert(line.end(), events[next].bytes.begin(), events[next].bytes.end());
+      next++;
+    }
+    // One byte per byte time, as a real DIN line delivers them: simavr's input FIFO never fills
+    if (!line.empty() && avr->cycle >= nextByteCycle) {
+      avr_raise_irq(dinInput, line.front());
+      line.pop_front();
+      nextByteCycle = avr->cycle + cyclesOf(DIN_BYTE_US);
+    }
+    state = avr_run(avr);
+  }
+
+  uint32_t overhead = summarize(samples[MEASURE_EMPTY], 0).min;
+  Summary summaries[MEASURE_COUNT];
+  for (uint8_t measure = 0; measure < MEASURE_COUNT; measure++) {
+    summaries[measure] = summarize(samples[measure], overhead);
+  }
+  if (json) {
+    std::cout << "{\"toolchain\":\"" BENCH_TOOLCHAIN "\",\"simavr\":\"" BENCH_SIMAVR "\"}\n";
+  }
+  for (uint8_t measure = MEASURE_NOTE_ON; measure < MEASURE_COUNT; measure++) {
+    const Summary& s = summaries[measure];
+    if (json) {
+      std::cout << "{\"measure\":\"" << measureNames[measure] << "\",\"count\":" << s.count
+                << ",\"min_cycles\":" << s.min << ",\"avg_cycles\":" << s.avg << ",\"p99_cycles\":" << s.p99
+                << ",\"max_cycles\":" << s.max << ",\"max_us\":" << s.max * 1e6 / AVR_FREQUENCY << "}\n";
+    } else {
+      std::cout << measureNames[measure] << ": " << s.count << " calls, cycles min " << s.min << " avg " << s.avg
+                << " p99 " << s.p99 << " max " << s.max << " (" << s.max * 1e6 / AVR_FREQUENCY << " us)\n";
+    }
+  }
+  if (!json) {
+    std::cout << "marker overhead " << overhead << " cycles, I2C transactions " << directTransactions
+              << " before the script, " << boards->transactions - directTransactions << " during, "
+              << events.size() << " script events\n";
+  }
+
+  if (!baseline.empty() && !checkBaseline(baseline, summaries, tolerance)) {
+    return 1;
+  }
+  return state == cpu_Crashed ? 2 : 0;
+}
@@ -0,0 +1,92 @@
+/***********************************************************************************************
+----------------------------    melodica_avr_bench   ----------------------------------------
+************************************************************************************************
+Firmware de mesure pour le banc simavr (avr_bench.cpp) : le firmware Servo_melodica complet
+(setup/loop renommés melodicaSetup/melodicaLoop par CMake) et des marqueurs autour des appels
+mesurés. Le banc relève le compteur de cycles de l'ATmega32u4 à chaque marqueur.
+- GPIOR0 = numéro de mesure : début, GPIOR1 : fin (même coût que le marqueur vide MEASURE_EMPTY)
+- GPIOR2 = PHASE_MIDI : mesures directes terminées, le banc injecte son script MIDI sur la
+  prise DIN et mesure chaque loop() jusqu'à la fin du script
+************************************************************************************************/
+#include "Instrument.h"
+#include "MidiHandler.h"
+
+#define BENCH_BEGIN(id) (GPIOR0 = (id))
+#define BENCH_END() (GPIOR1 = 0)
+
+// Numbering shared with avr_bench.cpp
+#define MEASURE_EMPTY 0
+#define MEASURE_NOTE_ON 1
+#define MEASURE_NOTE_OFF 2
+#define MEASURE_ALL_NOTES_OFF 3
+#define MEASURE_FLUSH 4
+#define MEASURE_LOOP 5
+#define PHASE_MIDI 2
+
+extern ServoController* servoController;
+extern Instrument* instruments[INSTRUMENT_COUNT];
+void melodicaSetup();
+void melodicaLoop();
+
+const uint8_t benchChord[6] {65, 69, 72, 77, 81, 84};
+
+// Le firmware tourne normalement pendant l'attente : air, notes planifiées, retour des touches
+void settle(unsigned long ms) {
+  unsigned long start = millis();
+  while (millis() - start < ms) {
+    melodicaLoop();
+  }
+}
+
+void flush() {
+  BENCH_BEGIN(MEASURE_FLUSH);
+  servoController->update();
+  BENCH_END();
+}
+
+void setup() {
+  melodicaSetup();
+  while (!servoController->isHomingComplete()) {
+    melodicaLoop();
+  }
+  settle(500);
+
+  for (uint8_t i = 0; i < 16; i++) {
+    BENCH_BEGIN(MEASURE_EMPTY);
+    BENCH_END();
+  }
+
+  // Single notes over the whole range, first one after a silence (air anticipation)
+  for (uint8_t note = FIRST_MIDI_NOTE; note < FIRST_MIDI_NOTE + NUMBER_OF_NOTES; note++) {
+    BENCH_BEGIN(MEASURE_NOTE_ON);
+    instruments[0]->noteOn(note, 100);
+    BENCH_END();
+    flush();
+    settle(60);
+    BENCH_BEGIN(MEASURE_NOTE_OFF);
+    instruments[0]->noteOff(note);
+    BENCH_END();
+    flush();
+    settle(60);
+  }
+
+  // Chord then All Notes Off (CC 123) with every key held
+  for (uint8_t i = 0; i < sizeof(benchChord); i++) {
+    instruments[0]->noteOn(benchChord[i], 100);
+  }
+  flush();
+  settle(200);
+  BENCH_BEGIN(MEASURE_ALL_NOTES_OFF);
+  instruments[0]->allNotesOff();
+  BENCH_END();
+  flush();
+  settle(500);
+
+  GPIOR2 = PHASE_MIDI;
+}
+
+void loop() {
+  BENCH_BEGIN(MEASURE_LOOP);
+  melodicaLoop();
+  BENCH_END();
+}
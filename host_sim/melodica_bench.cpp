@@ -0,0 +1,351 @@
+/***********************************************************************************************
+----------------------------    melodica_bench   ----------------------------------------
+************************************************************************************************
+
+Rejoue des fichiers MIDI standard (type 0/1) dans le firmware simulé et mesure le pipeline
+des notes : MidiUSB.read() -> MidiHandler -> Instrument -> ServoController -> bus I2C
+
+  melodica_bench [--json] [--loop-us N] [--check baseline.jsonl [--tolerance PCT]] fichiers.mid
+
+- temps CPU hôte par événement (loop() seulement) et événements/s : comparer deux versions
+  sur la même machine, ce n'est pas le temps de l'ATmega32u4
+- I2C, touches tenues et écarts à la partition sont en temps virtuel : reproductibles
+- --json : une ligne JSON par fichier ; --check compare à une exécution précédente et
+  renvoie 1 si une mesure déterministe se dégrade de plus de --tolerance % (5 par défaut)
+
+************************************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "SimHost.h"
+#include "SimKeyMap.h"
+#include "SmfReader.h"
+#include "ServoController.h"
+#include "instrument.h"
+
+void setup();
+void loop();
+extern ServoController* servoController;
+extern Instrument* instruments[INSTRUMENT_COUNT];
+
+struct Result {
+  std::string file;
+  uint32_t events;
+  uint32_t notes;
+  double scoreMs;
+  double cpuNsPerEvent;
+  double eventsPerSecond;
+  double i2cTransactionsPerSecond;
+  double i2cBytesPerSecond;
+  double busBusyPercent;
+  uint32_t peakHeldServos;
+  double onsetMeanMs, onsetP50Ms, onsetP99Ms, onsetMaxMs;
+  double releaseP50Ms, releaseP99Ms, releaseMaxMs;
+  uint32_t notesNotPlayed;
+  uint32_t ringOverflows;
+  uint32_t voicesRejected;
+  uint32_t voicesStolen;
+};
+
+// Deterministic metrics checked against a baseline: higher is worse, absolute slack for noise-free zeros
+struct CheckedMetric {
+  const char* name;
+  double Result::*value;
+  double slack;
+};
+static const CheckedMetric checkedMetrics[] = {
+  {"onset_p50_ms", &Result::onsetP50Ms, 0.1},
+  {"onset_p99_ms", &Result::onsetP99Ms, 0.1},
+  {"onset_max_ms", &Result::onsetMaxMs, 0.1},
+  {"release_p99_ms", &Result::releaseP99Ms, 0.1},
+  {"i2c_bytes_per_s", &Result::i2cBytesPerSecond, 1.0},
+  {"bus_busy_pct", &Result::busBusyPercent, 0.01},
+};
+
+static uint32_t loopMicros = 200;
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+static double mean(const std::vector<double>& values) {
+  double sum = 0;
+  for (double v : values) {
+    sum += v;
+  }
+  return values.empty() ? 0 : sum / values.size();
+}
+
+// A key's PCA9685 channel, identified by (address << 8 | channel)
+struct KeyState {
+  uint16_t restOn, restOff;           // Values after homing: any other value = key down
+  bool held;
+  std::deque<uint64_t> pendingPress;   // Score times of noteOns not written yet
+  std::deque<uint64_t> pendingRelease;
+};
+
+static std::map<uint16_t, KeyState> keys;
+
+static uint64_t runLoop(uint64_t until, uint64_t& cpuNs) {
+  uint32_t iterations = 0;
+  while (SimHost::now() < until) {
+    auto begin = std::chrono::steady_clock::now();
+    loop();
+    cpuNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    SimHost::advanceMicros(loopMicros);
+    iterations++;
+  }
+  return iterations;
+}
+
+static bool playFile(const std::string& path, Result& result) {
+  std::vector<SmfEvent> events;
+  std::string error;
+  if (!readSmf(path, events, error)) {
+    std::cerr << path << ": " << error << "\n";
+    return false;
+  }
+
+  result = Result();
+  result.file = path.substr(path.find_last_of('/') + 1);
+  result.events = events.size();
+  result.scoreMs = events.empty() ? 0 : events.back().micros / 1000.0;
+
+  uint32_t overflowsBefore = 0;
+  uint32_t rejectedBefore = 0;
+  uint32_t stolenBefore = 0;
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    overflowsBefore += instruments[i]->eventRing().getOverflowCount();
+    rejectedBefore += instruments[i]->getVoiceStats().rejectedNotes;
+    stolenBefore += instruments[i]->getVoiceStats().stolenNotes;
+  }
+
+  std::vector<double> onsets;
+  std::vector<double> releases;
+  uint32_t held = 0;
+  uint64_t start = SimHost::now();
+  SimHost::onChannelChange([&](uint8_t address, uint8_t channel, uint16_t on, uint16_t off) {
+    auto key = keys.find(address << 8 | channel);
+    if (key == keys.end()) {
+      return; // Air valve
+    }
+    KeyState& state = key->second;
+    bool down = on != state.restOn || off != state.restOff;
+    double now = (SimHost::now() - start) / 1000.0;
+    if (down && !state.held) {
+      state.held = true;
+      result.peakHeldServos = (std::max)(result.peakHeldServos, ++held);
+      if (!state.pendingPress.empty()) {
+        onsets.push_back(now - state.pendingPress.front() / 1000.0);
+        state.pendingPress.pop_front();
+      }
+    } else if (!down && state.held) {
+      state.held = false;
+      held--;
+      if (!state.pendingRelease.empty()) {
+        releases.push_back(now - state.pendingRelease.front() / 1000.0);
+        state.pendingRelease.pop_front();
+      }
+    }
+  });
+  SimHost::clearBusLog();
+
+  uint64_t cpuNs = 0;
+  for (const SmfEvent& event : events) {
+    runLoop(start + event.micros, cpuNs);
+    SimHost::pushUsbMidi(event.status >> 4, event.status, event.data1, event.data2);
+
+    uint8_t type = event.status & 0xF0;
+    uint8_t address;
+    uint8_t channel;
+    if ((type == 0x90 || type == 0x80) && SimKeyMap::noteChannel(event.status & 0x0F, event.data1, address, channel)) {
+      KeyState& state = keys[address << 8 | channel];
+      if (type == 0x90 && event.data2 > 0) {
+        state.pendingPress.push_back(event.micros);
+        result.notes++;
+      } else {
+        // A release only counts if its press was written (dropped notes release nothing)
+        if (state.held || !state.pendingPress.empty()) {
+          state.pendingRelease.push_back(event.micros);
+        }
+      }
+    }
+  }
+  runLoop(SimHost::now() + 1000000, cpuNs); // Releases, deferred notes and air hang time
+
+  uint64_t played = SimHost::now() - start;
+  uint64_t busBytes = 0;
+  for (const SimHost::BusTransaction& transaction : SimHost::busLog()) {
+    busBytes += 1 + transaction.length;
+  }
+  double seconds = played / 1e6;
+  result.cpuNsPerEvent = events.empty() ? 0 : (double)cpuNs / events.size();
+  result.eventsPerSecond = cpuNs ? events.size() * 1e9 / cpuNs : 0;
+  result.i2cTransactionsPerSecond = SimHost::busLog().size() / seconds;
+  result.i2cBytesPerSecond = busBytes / seconds;
+  result.busBusyPercent = 100.0 * SimHost::busBusyMicros() / played;
+  result.onsetMeanMs = mean(onsets);
+  result.onsetP50Ms = percentile(onsets, 0.5);
+  result.onsetP99Ms = percentile(onsets, 0.99);
+  result.onsetMaxMs = percentile(onsets, 1.0);
+  result.releaseP50Ms = percentile(releases, 0.5);
+  result.releaseP99Ms = percentile(releases, 0.99);
+  result.releaseMaxMs = percentile(releases, 1.0);
+  for (auto& key : keys) {
+    result.notesNotPlayed += key.second.pendingPress.size();
+    key.second.pendingPress.clear();
+    key.second.pendingRelease.clear();
+  }
+  for (uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    result.ringOverflows += instruments[i]->eventRing().getOverflowCount();
+    result.voicesRejected += instruments[i]->getVoiceStats().rejectedNotes;
+    result.voicesStolen += instruments[i]->getVoiceStats().stolenNotes;
+  }
+  result.ringOverflows -= overflowsBefore;
+  result.voicesRejected -= rejectedBefore;
+  result.voicesStolen -= stolenBefore;
+  SimHost::onChannelChange(nullptr);
+  return true;
+}
+
+static void printJson(const Result& r) {
+  std::cout << "{\"file\":\"" << r.file << "\",\"events\":" << r.events << ",\"notes\":" << r.notes
+            << ",\"score_ms\":" << r.scoreMs << ",\"cpu_ns_per_event\":" << r.cpuNsPerEvent
+            << ",\"events_per_s\":" << r.eventsPerSecond << ",\"i2c_transactions_per_s\":" << r.i2cTransactionsPerSecond
+            << ",\"i2c_bytes_per_s\":" << r.i2cBytesPerSecond << ",\"bus_busy_pct\":" << r.busBusyPercent
+            << ",\"peak_held_servos\":" << r.peakHeldServos << ",\"onset_mean_ms\":" << r.onsetMeanMs
+            << ",\"onset_p50_ms\":" << r.onsetP50Ms << ",\"onset_p99_ms\":" << r.onsetP99Ms
+            << ",\"onset_max_ms\":" << r.onsetMaxMs << ",\"release_p50_ms\":" << r.releaseP50Ms
+            << ",\"release_p99_ms\":" << r.releaseP99Ms << ",\"release_max_ms\":" << r.releaseMaxMs
+            << ",\"notes_not_played\":" << r.notesNotPlayed << ",\"ring_overflows\":" << r.ringOverflows
+            << ",\"voices_rejected\":" << r.voicesRejected << ",\"voices_stolen\":" << r.voicesStolen << "}\n";
+}
+
+static void printText(const Result& r) {
+  std::cout << r.file << ": " << r.events << " events, " << r.notes << " notes, " << r.scoreMs / 1000 << " s\n"
+            << "  cpu " << r.cpuNsPerEvent << " ns/event (" << r.eventsPerSecond << " events/s, host)\n"
+            << "  I2C " << r.i2cTransactionsPerSecond << " transactions/s, " << r.i2cBytesPerSecond
+            << " bytes/s, bus busy " << r.busBusyPercent << " %\n"
+            << "  peak held servos " << r.peakHeldServos << "\n"
+            << "  onset vs score ms: mean " << r.onsetMeanMs << " p50 " << r.onsetP50Ms << " p99 " << r.onsetP99Ms
+            << " max " << r.onsetMaxMs << "\n"
+            << "  release vs score ms: p50 " << r.releaseP50Ms << " p99 " << r.releaseP99Ms << " max "
+            << r.releaseMaxMs << "\n"
+            << "  not played " << r.notesNotPlayed << ", ring overflows " << r.ringOverflows << ", voices rejected "
+            << r.voicesRejected << ", stolen " << r.voicesStolen << "\n";
+}
+
+static bool jsonNumber(const std::string& line, const std::string& key, double& value) {
+  size_t pos = line.find("\"" + key + "\":");
+  if (pos == std::string::npos) {
+    return false;
+  }
+  value = std::stod(line.substr(pos + key.size() + 3));
+  return true;
+}
+
+// Counts that must not grow, then the checked metrics with the relative tolerance
+static bool checkBaseline(const std::string& path, const std::vector<Result>& results, double tolerance) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "cannot open baseline " << path << "\n";
+    return false;
+  }
+  bool ok = true;
+  std::string line;
+  while (std::getline(file, line)) {
+    for (const Result& r : results) {
+      if (line.find("\"file\":\"" + r.file + "\"") == std::string::npos) {
+        continue;
+      }
+      double base;
+      if (jsonNumber(line, "notes_not_played", base) && r.notesNotPlayed > base) {
+        std::cerr << r.file << ": notes_not_played " << base << " -> " << r.notesNotPlayed << "\n";
+        ok = false;
+      }
+      if (jsonNumber(line, "ring_overflows", base) && r.ringOverflows > base) {
+        std::cerr << r.file << ": ring_overflows " << base << " -> " << r.ringOverflows << "\n";
+        ok = false;
+      }
+      for (const CheckedMetric& metric : checkedMetrics) {
+        double current = r.*(metric.value);
+        if (jsonNumber(line, metric.name, base) && current > base + (std::max)(base * tolerance / 100, metric.slack)) {
+          std::cerr << r.file << ": " << metric.name << " " << base << " -> " << current << "\n";
+          ok = false;
+        }
+      }
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  double tolerance = 5;
+  std::string baseline;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--json") {
+      json = true;
+    } else if (arg == "--loop-us" && i + 1 < argc) {
+      loopMicros = std::stoul(argv[++i]);
+    } else if (arg == "--check" && i + 1 < argc) {
+      baseline = argv[++i];
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = std::stod(argv[++i]);
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) {
+    std::cerr << "usage: melodica_bench [--json] [--loop-us N] [--check baseline.jsonl [--tolerance PCT]] files.mid\n";
+    return 2;
+  }
+
+  // Boot and home every servo before the first file
+  SimKeyMap::addBoards();
+  setup();
+  uint64_t cpuNs = 0;
+  while (!servoController->isHomingComplete() && SimHost::now() < 30000000) {
+    runLoop(SimHost::now() + 10000, cpuNs);
+  }
+  runLoop(SimHost::now() + 500000, cpuNs);
+  for (uint8_t servo = 0; servo < NUMBER_OF_NOTES; servo++) {
+    uint8_t address;
+    uint8_t channel;
+    if (SimKeyMap::servoChannel(servo, address, channel)) {
+      const SimHost::Pca9685State* board = SimHost::pca9685(address);
+      keys[address << 8 | channel] = {board->on[channel], board->off[channel], false, {}, {}};
+    }
+  }
+
+  std::vector<Result> results;
+  for (const std::string& path : files) {
+    Result result;
+    if (!playFile(path, result)) {
+      return 2;
+    }
+    results.push_back(result);
+    if (json) {
+      printJson(result);
+    } else {
+      printText(result);
+    }
+  }
+
+  if (!baseline.empty() && !checkBaseline(baseline, results, tolerance)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+/***********************************************************************************************
+----------------------------    melodica_sim   ----------------------------------------
+************************************************************************************************
+
+Joue un script MIDI dans le firmware simulé (setup() puis loop() sur l'horloge virtuelle)
+et résume le trafic I2C et la latence réception -> écriture du canal de la touche
+
+  melodica_sim [--echo] [--loop-us N] [--log] [script]     (script sur stdin par défaut)
+
+Script : une ligne par message, "<ms> <statut> <donnée1> <donnée2>" en hexadécimal,
+'#' pour un commentaire ; "din" avant les octets les envoie sur Serial1 (octets bruts)
+
+************************************************************************************************/
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "SimHost.h"
+#include "SimKeyMap.h"
+#include "MidiScript.h"
+
+void setup();
+void loop();
+
+static double percentile(std::vector<uint64_t> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[index] / 1000.0;
+}
+
+int main(int argc, char** argv) {
+  uint32_t loopMicros = 200;   // CPU time of one loop() besides the bus, ATmega32u4 order of magnitude
+  uint32_t tailMs = 500;       // Kept running after the last event (releases, air hang time)
+  bool printLog = false;
+  const char* scriptPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--echo") {
+      SimHost::setSerialEcho(true);
+    } else if (arg == "--log") {
+      printLog = true;
+    } else if (arg == "--loop-us" && i + 1 < argc) {
+      loopMicros = std::stoul(argv[++i]);
+    } else if (arg == "--tail-ms" && i + 1 < argc) {
+      tailMs = std::stoul(argv[++i]);
+    } else {
+      scriptPath = argv[i];
+    }
+  }
+
+  std::vector<ScriptEvent> events;
+  std::ifstream file;
+  if (scriptPath) {
+    file.open(scriptPath);
+    if (!file) {
+      std::cerr << "cannot open " << scriptPath << "\n";
+      return 1;
+    }
+  }
+  if (!readScript(scriptPath ? file : std::cin, events)) {
+    return 1;
+  }
+
+  // Note latency: injection of a noteOn -> first change of its key's PCA9685 channel
+  std::map<uint16_t, uint64_t> pendingKeys; // address << 8 | channel -> injection time
+  std::vector<uint64_t> latencies;
+  uint32_t keyWrites = 0;
+  SimHost::onChannelChange([&](uint8_t address, uint8_t channel, uint16_t, uint16_t) {
+    keyWrites++;
+    auto pending = pendingKeys.find(address << 8 | channel);
+    if (pending != pendingKeys.end()) {
+      latencies.push_back(SimHost::now() - pending->second);
+      pendingKeys.erase(pending);
+    }
+  });
+
+  SimKeyMap::addBoards();
+  setup();
+  uint64_t start = SimHost::now();
+  size_t setupTransactions = SimHost::busLog().size();
+  SimHost::clearBusLog();
+
+  uint64_t end = start + (events.empty() ? 0 : events.back().micros) + tailMs * 1000ULL;
+  size_t next = 0;
+  uint32_t iterations = 0;
+  uint64_t longestLoop = 0;
+  while (SimHost::now() < end) {
+    while (next < events.size() && start + events[next].micros <= SimHost::now()) {
+      const ScriptEvent& event = events[next++];
+      if (event.din) {
+        for (uint8_t value : event.bytes) {
+          SimHost::pushSerial1(value);
+        }
+        continue;
+      }
+      uint8_t status = event.bytes[0];
+      uint8_t data1 = event.bytes.size() > 1 ? event.bytes[1] : 0;
+      uint8_t data2 = event.bytes.size() > 2 ? event.bytes[2] : 0;
+      SimHost::pushUsbMidi(status >> 4, status, data1, data2);
+      uint8_t address;
+      uint8_t channel;
+      if ((status & 0xF0) == 0x90 && data2 > 0 && SimKeyMap::noteChannel(status & 0x0F, data1, address, channel)) {
+        pendingKeys[address << 8 | channel] = SimHost::now();
+      }
+    }
+
+    uint64_t loopStart = SimHost::now();
+    loop();
+    SimHost::advanceMicros(loopMicros);
+    longestLoop = std::max(longestLoop, SimHost::now() - loopStart);
+    iterations++;
+  }
+
+  uint64_t played = SimHost::now() - start;
+  const std::vector<SimHost::BusTransaction>& bus = SimHost::busLog();
+  uint64_t busBytes = 0;
+  uint8_t longestTransaction = 0;
+  for (const SimHost::BusTransaction& transaction : bus) {
+    busBytes += 1 + transaction.length;
+    longestTransaction = std::max(longestTransaction, transaction.length);
+    if (printLog) {
+      std::cout << transaction.startMicros << " us  0x" << std::hex << (int)transaction.address << std::dec
+                << (transaction.acknowledged ? "  " : " NACK ") << (int)transaction.length << " bytes "
+                << transaction.durationMicros << " us\n";
+    }
+  }
+
+  std::cout << "setup: " << start / 1000.0 << " ms virtual, " << setupTransactions << " I2C transactions\n";
+  std::cout << "played: " << played / 1000.0 << " ms, " << events.size() << " events, "
+            << iterations << " loop() iterations, longest " << longestLoop << " us\n";
+  std::cout << "I2C @ " << SimHost::busClock() / 1000 << " kHz: " << bus.size() << " transactions, "
+            << busBytes << " bytes, longest " << (int)longestTransaction << " data bytes, bus busy "
+            << (played ? 100.0 * SimHost::busBusyMicros() / played : 0) << " %\n";
+  std::cout << "channel changes: " << keyWrites << ", EEPROM cells written: " << SimHost::eepromWrites() << "\n";
+  std::cout << "noteOn -> key channel written: " << latencies.size() << " notes, p50 "
+            << percentile(latencies, 0.5) << " ms, p99 " << percentile(latencies, 0.99) << " ms, max "
+            << percentile(latencies, 1.0) << " ms, not played " << pendingKeys.size() << "\n";
+  return 0;
+}
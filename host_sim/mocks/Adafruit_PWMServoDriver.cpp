@@ -0,0 +1,114 @@
+#include "Adafruit_PWMServoDriver.h"
+
+Adafruit_PWMServoDriver::Adafruit_PWMServoDriver(const uint8_t addr, TwoWire& i2c)
+  : i2cAddress(addr), i2c(&i2c), oscillatorFrequency(FREQUENCY_OSCILLATOR) {
+}
+
+bool Adafruit_PWMServoDriver::begin(uint8_t prescale) {
+  i2c->begin();
+  // Probe the address as Adafruit_BusIO does: no ACK, no board
+  i2c->beginTransmission(i2cAddress);
+  if (i2c->endTransmission() != 0) {
+    return false;
+  }
+  reset();
+  if (prescale) {
+    write8(PCA9685_MODE1, MODE1_SLEEP);
+    write8(PCA9685_PRESCALE, prescale);
+    write8(PCA9685_MODE1, MODE1_RESTART | MODE1_AI);
+  } else {
+    setPWMFreq(1000);
+  }
+  return true;
+}
+
+void Adafruit_PWMServoDriver::reset() {
+  write8(PCA9685_MODE1, MODE1_RESTART);
+  delay(10);
+}
+
+void Adafruit_PWMServoDriver::sleep() {
+  write8(PCA9685_MODE1, read8(PCA9685_MODE1) | MODE1_SLEEP);
+  delay(5);
+}
+
+void Adafruit_PWMServoDriver::wakeup() {
+  write8(PCA9685_MODE1, read8(PCA9685_MODE1) & ~MODE1_SLEEP);
+}
+
+void Adafruit_PWMServoDriver::setPWMFreq(float freq) {
+  if (freq < 1) {
+    freq = 1;
+  }
+  if (freq > 3500) {
+    freq = 3500;
+  }
+  float prescaleval = ((oscillatorFrequency / (freq * 4096.0)) + 0.5) - 1;
+  if (prescaleval < PCA9685_PRESCALE_MIN) {
+    prescaleval = PCA9685_PRESCALE_MIN;
+  }
+  if (prescaleval > PCA9685_PRESCALE_MAX) {
+    prescaleval = PCA9685_PRESCALE_MAX;
+  }
+  uint8_t prescale = (uint8_t)prescaleval;
+
+  uint8_t oldmode = read8(PCA9685_MODE1);
+  write8(PCA9685_MODE1, (oldmode & ~MODE1_RESTART) | MODE1_SLEEP);
+  write8(PCA9685_PRESCALE, prescale);
+  write8(PCA9685_MODE1, oldmode);
+  delay(5);
+  write8(PCA9685_MODE1, oldmode | MODE1_RESTART | MODE1_AI);
+}
+
+void Adafruit_PWMServoDriver::setOscillatorFrequency(uint32_t freq) {
+  oscillatorFrequency = freq;
+}
+
+uint32_t Adafruit_PWMServoDriver::getOscillatorFrequency() {
+  return oscillatorFrequency;
+}
+
+uint8_t Adafruit_PWMServoDriver::setPWM(uint8_t num, uint16_t on, uint16_t off) {
+  i2c->beginTransmission(i2cAddress);
+  i2c->write(PCA9685_LED0_ON_L + 4 * num);
+  i2c->write(on);
+  i2c->write(on >> 8);
+  i2c->write(off);
+  i2c->write(off >> 8);
+  return i2c->endTransmission();
+}
+
+void Adafruit_PWMServoDriver::setPin(uint8_t num, uint16_t val, bool invert) {
+  val = min(val, (uint16_t)4095);
+  if (invert) {
+    val = 4095 - val;
+  }
+  if (val == 4095) {
+    setPWM(num, 4096, 0);
+  } else if (val == 0) {
+    setPWM(num, 0, 4096);
+  } else {
+    setPWM(num, 0, val);
+  }
+}
+
+void Adafruit_PWMServoDriver::writeMicroseconds(uint8_t num, uint16_t microseconds) {
+  uint8_t prescale = read8(PCA9685_PRESCALE) + 1;
+  double pulselength = 1000000.0 * prescale / oscillatorFrequency; // us per tick
+  setPWM(num, 0, (uint16_t)(microseconds / pulselength));
+}
+
+void Adafruit_PWMServoDriver::write8(uint8_t reg, uint8_t value) {
+  i2c->beginTransmission(i2cAddress);
+  i2c->write(reg);
+  i2c->write(value);
+  i2c->endTransmission();
+}
+
+uint8_t Adafruit_PWMServoDriver::read8(uint8_t reg) {
+  i2c->beginTransmission(i2cAddress);
+  i2c->write(reg);
+  i2c->endTransmission();
+  i2c->requestFrom(i2cAddress, (uint8_t)1);
+  return i2c->read();
+}
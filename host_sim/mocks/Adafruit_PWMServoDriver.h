@@ -0,0 +1,50 @@
+#ifndef _ADAFRUIT_PWMServoDriver_H
+#define _ADAFRUIT_PWMServoDriver_H
+
+#include "Wire.h"
+/***********************************************************************************************
+----------------------------    Adafruit_PWMServoDriver.h (simulation hôte)   -----------------
+************************************************************************************************
+
+Même interface que la librairie Adafruit, mêmes écritures de registres sur Wire :
+le PCA9685 simulé (SimHost::addPca9685) les décode
+
+************************************************************************************************/
+
+#define PCA9685_MODE1 0x00
+#define PCA9685_MODE2 0x01
+#define PCA9685_LED0_ON_L 0x06
+#define PCA9685_ALLLED_ON_L 0xFA
+#define PCA9685_PRESCALE 0xFE
+
+#define MODE1_RESTART 0x80
+#define MODE1_AI 0x20
+#define MODE1_SLEEP 0x10
+
+#define FREQUENCY_OSCILLATOR 25000000
+#define PCA9685_PRESCALE_MIN 3
+#define PCA9685_PRESCALE_MAX 255
+
+class Adafruit_PWMServoDriver {
+private:
+  uint8_t i2cAddress;
+  TwoWire* i2c;
+  uint32_t oscillatorFrequency;
+  void write8(uint8_t reg, uint8_t value);
+  uint8_t read8(uint8_t reg);
+
+public:
+  Adafruit_PWMServoDriver(const uint8_t addr = 0x40, TwoWire& i2c = Wire);
+  bool begin(uint8_t prescale = 0);
+  void reset();
+  void sleep();
+  void wakeup();
+  void setPWMFreq(float freq);
+  void setOscillatorFrequency(uint32_t freq);
+  uint32_t getOscillatorFrequency();
+  uint8_t setPWM(uint8_t num, uint16_t on, uint16_t off);
+  void setPin(uint8_t num, uint16_t val, bool invert = false);
+  void writeMicroseconds(uint8_t num, uint16_t microseconds);
+};
+
+#endif // _ADAFRUIT_PWMServoDriver_H
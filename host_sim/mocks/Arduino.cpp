@@ -0,0 +1,180 @@
+#include <deque>
+#include <stdio.h>
+#include "SimHost.h"
+#include "Arduino.h"
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+
+static uint64_t clockMicros = 0;
+static int analogPins[32] = {0};
+static int digitalPins[32] = {0};
+static int digitalOutputs[32] = {0};
+static std::string serialText;
+static bool serialEcho = false;
+static std::deque<uint8_t> serial1Input;
+
+uint64_t SimHost::now() {
+  return clockMicros;
+}
+
+void SimHost::advanceMicros(uint64_t us) {
+  clockMicros += us;
+}
+
+void SimHost::setAnalog(uint8_t pin, int value) {
+  analogPins[pin & 31] = value;
+}
+
+void SimHost::setDigital(uint8_t pin, int value) {
+  digitalPins[pin & 31] = value;
+}
+
+int SimHost::digitalOutput(uint8_t pin) {
+  return digitalOutputs[pin & 31];
+}
+
+std::string& SimHost::serialOutput() {
+  return serialText;
+}
+
+void SimHost::setSerialEcho(bool echo) {
+  serialEcho = echo;
+}
+
+void SimHost::pushSerial1(uint8_t value) {
+  serial1Input.push_back(value);
+}
+
+// ---------------------------------------------------------------- Time and pins
+
+unsigned long millis() {
+  return (unsigned long)(clockMicros / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)clockMicros;
+}
+
+void delay(unsigned long ms) {
+  clockMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+  clockMicros += us;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) {
+    digitalPins[pin & 31] = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  digitalOutputs[pin & 31] = value;
+}
+
+int digitalRead(uint8_t pin) {
+  return digitalPins[pin & 31];
+}
+
+int analogRead(uint8_t pin) {
+  return analogPins[pin & 31];
+}
+
+// ---------------------------------------------------------------- Print (same output as the AVR core)
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::write(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+size_t Print::printNumber(unsigned long long n, uint8_t base) {
+  char buffer[8 * sizeof(n) + 1];
+  char* str = &buffer[sizeof(buffer) - 1];
+  *str = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    char digit = n % base;
+    n /= base;
+    *--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::printSigned(long long n, int base) {
+  if (base == 0) {
+    return write((uint8_t)n);
+  }
+  if (base == 10 && n < 0) {
+    return print('-') + printNumber(-(unsigned long long)n, 10);
+  }
+  return printNumber((unsigned long long)n, base);
+}
+
+size_t Print::printFloat(double number, uint8_t digits) {
+  char buffer[48];
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, number);
+  return write(buffer);
+}
+
+size_t Print::print(const char* text) { return write(text); }
+size_t Print::print(char value) { return write((uint8_t)value); }
+size_t Print::print(unsigned char value, int base) { return printNumber(value, base); }
+size_t Print::print(int value, int base) { return printSigned(value, base); }
+size_t Print::print(unsigned int value, int base) { return printNumber(value, base); }
+size_t Print::print(long value, int base) { return printSigned(value, base); }
+size_t Print::print(unsigned long value, int base) { return printNumber(value, base); }
+size_t Print::print(long long value, int base) { return printSigned(value, base); }
+size_t Print::print(unsigned long long value, int base) { return printNumber(value, base); }
+size_t Print::print(double value, int digits) { return printFloat(value, digits); }
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+// ---------------------------------------------------------------- Serial ports
+
+void HardwareSerial::begin(unsigned long baud) {
+  (void)baud;
+}
+
+int HardwareSerial::available() {
+  return port == 1 ? (int)serial1Input.size() : 0;
+}
+
+int HardwareSerial::read() {
+  if (port != 1 || serial1Input.empty()) {
+    return -1;
+  }
+  uint8_t value = serial1Input.front();
+  serial1Input.pop_front();
+  return value;
+}
+
+int HardwareSerial::peek() {
+  return (port == 1 && !serial1Input.empty()) ? serial1Input.front() : -1;
+}
+
+size_t HardwareSerial::write(uint8_t value) {
+  if (port == 0) {
+    serialText += (char)value;
+    if (serialEcho && value != '\r') {
+      putchar(value);
+    }
+  }
+  return 1;
+}
@@ -0,0 +1,126 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+/***********************************************************************************************
+----------------------------    Arduino.h (simulation hôte)   ----------------------------------
+************************************************************************************************
+
+Remplace le core Arduino AVR pour compiler Servo_melodica sur PC, sans modification
+- millis()/micros() lisent une horloge virtuelle avancée par la simulation (SimHost.h),
+  delay() l'avance d'autant, les écritures I2C du temps passé sur le bus
+- min/max sont des macros comme sur AVR : inclure les en-têtes de la STL avant celui-ci
+- Serial est capturé (SimHost::serialOutput), Serial1 lit les octets injectés (MIDI DIN)
+
+************************************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define A0 18
+#define A1 19
+#define A2 20
+#define A3 21
+
+#define PROGMEM
+#define F(string) (string)
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// No interrupts on the host: the core's ISR-shared state is only touched by one thread
+#define noInterrupts()
+#define interrupts()
+#define ISR(vector) void vector()
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+class Print {
+private:
+  size_t printNumber(unsigned long long n, uint8_t base);
+  size_t printSigned(long long n, int base);
+  size_t printFloat(double number, uint8_t digits);
+
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t value) = 0;
+  size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* text);
+
+  size_t print(const char* text);
+  size_t print(char value);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(long long value, int base = DEC);
+  size_t print(unsigned long long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println();
+  template <typename T> size_t println(T value) {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <typename T> size_t println(T value, int format) {
+    size_t n = print(value, format);
+    return n + println();
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+// Serial (USB CDC) and Serial1 (UART): output captured, input injected by the simulation
+class HardwareSerial : public Stream {
+private:
+  uint8_t port;
+public:
+  explicit HardwareSerial(uint8_t portNumber) : port(portNumber) {}
+  void begin(unsigned long baud);
+  void end() {}
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() {}
+  size_t write(uint8_t value) override;
+  using Print::write;
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // ARDUINO_H
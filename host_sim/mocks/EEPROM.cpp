@@ -0,0 +1,36 @@
+#include "SimHost.h"
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+static uint8_t cells[E2END + 1];
+static bool erased = false;
+static uint32_t writeCount = 0;
+
+uint8_t* SimHost::eeprom() {
+  if (!erased) {
+    memset(cells, 0xFF, sizeof(cells));
+    erased = true;
+  }
+  return cells;
+}
+
+uint32_t SimHost::eepromWrites() {
+  return writeCount;
+}
+
+uint8_t EEPROMClass::read(int address) {
+  return SimHost::eeprom()[address & E2END];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  SimHost::eeprom()[address & E2END] = value;
+  writeCount++;
+  SimHost::advanceMicros(3300); // Erase + write of one cell on the ATmega32u4, CPU halted
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+  if (read(address) != value) {
+    write(address, value);
+  }
+}
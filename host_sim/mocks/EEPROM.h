@@ -0,0 +1,42 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include "Arduino.h"
+/***********************************************************************************************
+----------------------------    EEPROM.h (simulation hôte)   ----------------------------------------
+************************************************************************************************
+
+EEPROM de 1 Ko de l'ATmega32u4, effacée (0xFF) au démarrage, écritures comptées (usure)
+
+************************************************************************************************/
+
+#define E2END 0x3FF
+
+class EEPROMClass {
+public:
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+  void update(int address, uint8_t value);
+  uint16_t length() { return E2END + 1; }
+
+  template <typename T> T& get(int address, T& value) {
+    uint8_t* bytes = (uint8_t*)&value;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      bytes[i] = read(address + i);
+    }
+    return value;
+  }
+
+  // Like the AVR library: only bytes that differ are written
+  template <typename T> const T& put(int address, const T& value) {
+    const uint8_t* bytes = (const uint8_t*)&value;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      update(address + i, bytes[i]);
+    }
+    return value;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_h
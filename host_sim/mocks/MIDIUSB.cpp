@@ -0,0 +1,33 @@
+#include <deque>
+#include "SimHost.h"
+#include "MIDIUSB.h"
+
+MIDI_ MidiUSB;
+
+static std::deque<midiEventPacket_t> received;
+static std::vector<SimHost::MidiPacket> sent;
+
+void SimHost::pushUsbMidi(uint8_t header, uint8_t byte1, uint8_t byte2, uint8_t byte3) {
+  received.push_back({header, byte1, byte2, byte3});
+}
+
+size_t SimHost::pendingUsbMidi() {
+  return received.size();
+}
+
+const std::vector<SimHost::MidiPacket>& SimHost::usbMidiSent() {
+  return sent;
+}
+
+midiEventPacket_t MIDI_::read() {
+  if (received.empty()) {
+    return {0, 0, 0, 0};
+  }
+  midiEventPacket_t packet = received.front();
+  received.pop_front();
+  return packet;
+}
+
+void MIDI_::sendMIDI(midiEventPacket_t event) {
+  sent.push_back({event.header, event.byte1, event.byte2, event.byte3});
+}
@@ -0,0 +1,30 @@
+#ifndef MIDIUSB_h
+#define MIDIUSB_h
+
+#include "Arduino.h"
+/***********************************************************************************************
+----------------------------    MIDIUSB.h (simulation hôte)   ----------------------------------------
+************************************************************************************************
+
+read() renvoie les paquets injectés par SimHost::pushUsbMidi(), header 0 quand la file est vide ;
+sendMIDI() les garde dans SimHost::usbMidiSent()
+
+************************************************************************************************/
+
+typedef struct {
+  uint8_t header;
+  uint8_t byte1;
+  uint8_t byte2;
+  uint8_t byte3;
+} midiEventPacket_t;
+
+class MIDI_ {
+public:
+  midiEventPacket_t read();
+  void sendMIDI(midiEventPacket_t event);
+  void flush() {}
+};
+
+extern MIDI_ MidiUSB;
+
+#endif // MIDIUSB_h
@@ -0,0 +1,45 @@
+#include "SimHost.h"
+#include "Servo.h"
+
+static std::vector<SimHost::ServoWrite> servoWrites;
+
+const std::vector<SimHost::ServoWrite>& SimHost::servoLog() {
+  return servoWrites;
+}
+
+Servo::Servo() : pin(-1), angle(90) {
+}
+
+uint8_t Servo::attach(int servoPin) {
+  pin = servoPin;
+  return 0;
+}
+
+uint8_t Servo::attach(int servoPin, int min, int max) {
+  (void)min;
+  (void)max;
+  return attach(servoPin);
+}
+
+void Servo::detach() {
+  pin = -1;
+}
+
+void Servo::write(int value) {
+  angle = constrain(value, 0, 180);
+  if (pin >= 0) {
+    servoWrites.push_back({SimHost::now(), (uint8_t)pin, angle});
+  }
+}
+
+void Servo::writeMicroseconds(int value) {
+  write(map(value, 544, 2400, 0, 180));
+}
+
+int Servo::read() {
+  return angle;
+}
+
+bool Servo::attached() {
+  return pin >= 0;
+}
@@ -0,0 +1,29 @@
+#ifndef Servo_h
+#define Servo_h
+
+#include "Arduino.h"
+/***********************************************************************************************
+----------------------------    Servo.h (simulation hôte)   ----------------------------------------
+************************************************************************************************
+
+Servo sur une broche : chaque write() est journalisé (SimHost::servoLog)
+
+************************************************************************************************/
+
+class Servo {
+private:
+  int8_t pin;   // -1 = detached
+  int angle;
+
+public:
+  Servo();
+  uint8_t attach(int pin);
+  uint8_t attach(int pin, int min, int max);
+  void detach();
+  void write(int value);
+  void writeMicroseconds(int value);
+  int read();
+  bool attached();
+};
+
+#endif // Servo_h
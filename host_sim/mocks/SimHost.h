@@ -0,0 +1,87 @@
+#ifndef SIMHOST_H
+#define SIMHOST_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+/***********************************************************************************************
+----------------------------    SimHost.h   ----------------------------------------
+************************************************************************************************
+
+Pilotage de la simulation hôte depuis un outil (melodica_sim, benchmarks)
+- horloge virtuelle en microsecondes : rien ne bouge tant que l'outil ne l'avance pas,
+  sauf delay() et le temps passé sur le bus I2C (Wire est bloquant sur AVR)
+- chaque transaction I2C est journalisée avec son instant et sa durée au débit du bus,
+  les PCA9685 déclarés décodent leurs registres (canaux, MODE1, PRESCALE)
+- entrées : paquets USB-MIDI, octets sur Serial1 (DIN), broches analogiques/numériques
+- sorties : Serial, paquets USB-MIDI envoyés, écritures Servo, contenu de l'EEPROM
+
+Inclure avant Arduino.h (les macros min/max du core AVR cassent la STL)
+
+************************************************************************************************/
+
+namespace SimHost {
+
+struct BusTransaction {
+  uint64_t startMicros;      // Virtual time at START
+  uint32_t durationMicros;   // START, address, data bytes (9 bits each) and STOP at the bus clock
+  uint8_t address;           // 7-bit address
+  bool acknowledged;         // A simulated device answers at this address
+  uint8_t length;            // Data bytes after the address byte
+  uint8_t data[32];
+};
+
+struct Pca9685State {
+  uint8_t mode1;
+  uint8_t prescale;
+  uint16_t on[16];           // LEDn_ON (12 bits)
+  uint16_t off[16];          // LEDn_OFF (12 bits)
+  uint64_t changedMicros[16]; // Last time ON or OFF of the channel changed
+};
+
+struct ServoWrite {
+  uint64_t micros;
+  uint8_t pin;
+  int angle;
+};
+
+struct MidiPacket {
+  uint8_t header, byte1, byte2, byte3;
+};
+
+// Clock
+uint64_t now();                    // Virtual microseconds since start
+void advanceMicros(uint64_t us);
+
+// I2C bus
+void addPca9685(uint8_t address);  // Device answering (ACK) at this address
+const Pca9685State* pca9685(uint8_t address); // nullptr if not declared
+const std::vector<BusTransaction>& busLog();
+uint64_t busBusyMicros();          // Sum of transaction durations since the last clear
+uint32_t busClock();               // Hz, Wire.setClock() (100 kHz by default, as on AVR)
+void clearBusLog();
+// Called on every PCA9685 channel whose ON or OFF value changes
+void onChannelChange(std::function<void(uint8_t address, uint8_t channel, uint16_t on, uint16_t off)> listener);
+
+// MIDI and serial input
+void pushUsbMidi(uint8_t header, uint8_t byte1, uint8_t byte2, uint8_t byte3);
+size_t pendingUsbMidi();
+void pushSerial1(uint8_t value);
+const std::vector<MidiPacket>& usbMidiSent();
+
+// Pins
+void setAnalog(uint8_t pin, int value);
+void setDigital(uint8_t pin, int value);
+int digitalOutput(uint8_t pin);    // Last digitalWrite()
+
+// Outputs
+std::string& serialOutput();       // Everything printed on Serial
+void setSerialEcho(bool echo);     // Also copy Serial to stdout
+const std::vector<ServoWrite>& servoLog();
+uint8_t* eeprom();                 // 1 KB, erased (0xFF) at start
+uint32_t eepromWrites();           // Cells actually written (update() skips equal bytes)
+
+}
+
+#endif // SIMHOST_H
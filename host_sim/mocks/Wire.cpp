@@ -0,0 +1,201 @@
+#include <map>
+#include "SimHost.h"
+#include "Wire.h"
+
+TwoWire Wire;
+
+static std::vector<SimHost::BusTransaction> transactions;
+static std::map<uint8_t, SimHost::Pca9685State> pcaBoards;
+static std::map<uint8_t, uint8_t> pcaRegisterPointers;
+static std::function<void(uint8_t, uint8_t, uint16_t, uint16_t)> channelListener;
+static uint64_t busyMicros = 0;
+static uint32_t clockHz = 100000; // TWI default of the AVR core
+
+void SimHost::addPca9685(uint8_t address) {
+  SimHost::Pca9685State state;
+  memset(&state, 0, sizeof(state));
+  state.mode1 = 0x11; // Power-on: SLEEP | ALLCALL
+  state.prescale = 0x1E;
+  for (uint8_t c = 0; c < 16; c++) {
+    state.off[c] = 0x1000; // Power-on: full OFF bit set
+  }
+  pcaBoards[address] = state;
+  pcaRegisterPointers[address] = 0;
+}
+
+const SimHost::Pca9685State* SimHost::pca9685(uint8_t address) {
+  auto board = pcaBoards.find(address);
+  return board == pcaBoards.end() ? nullptr : &board->second;
+}
+
+const std::vector<SimHost::BusTransaction>& SimHost::busLog() {
+  return transactions;
+}
+
+uint64_t SimHost::busBusyMicros() {
+  return busyMicros;
+}
+
+uint32_t SimHost::busClock() {
+  return clockHz;
+}
+
+void SimHost::clearBusLog() {
+  transactions.clear();
+  busyMicros = 0;
+}
+
+void SimHost::onChannelChange(std::function<void(uint8_t, uint8_t, uint16_t, uint16_t)> listener) {
+  channelListener = listener;
+}
+
+// PCA9685 register file: LEDn registers are 4 bytes from 0x06, auto-increment if MODE1.AI
+static void pcaWrite(uint8_t address, SimHost::Pca9685State& board, const uint8_t* data, uint8_t length) {
+  if (length == 0) {
+    return;
+  }
+  uint8_t reg = data[0];
+  bool autoIncrement = board.mode1 & 0x20;
+  for (uint8_t i = 1; i < length; i++) {
+    uint8_t value = data[i];
+    if (reg == 0x00) {
+      board.mode1 = value & 0x7F; // RESTART reads back as 0 once written
+    } else if (reg == 0xFE) {
+      if (board.mode1 & 0x10) {
+        board.prescale = value; // Only writable in sleep
+      }
+    } else if (reg >= 0x06 && reg < 0x06 + 4 * 16) {
+      uint8_t channel = (reg - 0x06) / 4;
+      uint16_t on = board.on[channel];
+      uint16_t off = board.off[channel];
+      switch ((reg - 0x06) % 4) {
+        case 0: on = (on & 0x1F00) | value; break;
+        case 1: on = (on & 0x00FF) | ((value & 0x1F) << 8); break;
+        case 2: off = (off & 0x1F00) | value; break;
+        case 3: off = (off & 0x00FF) | ((value & 0x1F) << 8); break;
+      }
+      if (on != board.on[channel] || off != board.off[channel]) {
+        board.on[channel] = on;
+        board.off[channel] = off;
+        board.changedMicros[channel] = SimHost::now();
+        if (channelListener) {
+          channelListener(address, channel, on, off);
+        }
+      }
+    }
+    if (autoIncrement) {
+      reg++;
+    }
+  }
+  pcaRegisterPointers[address] = reg;
+}
+
+static uint8_t pcaRead(const SimHost::Pca9685State& board, uint8_t reg) {
+  if (reg == 0x00) {
+    return board.mode1;
+  }
+  if (reg == 0xFE) {
+    return board.prescale;
+  }
+  if (reg >= 0x06 && reg < 0x06 + 4 * 16) {
+    uint8_t channel = (reg - 0x06) / 4;
+    uint16_t value = ((reg - 0x06) % 4 < 2) ? board.on[channel] : board.off[channel];
+    return (reg % 2 == 0) ? (value & 0xFF) : (value >> 8);
+  }
+  return 0;
+}
+
+// START + address byte + data bytes (8 bits + ACK each) + STOP
+static uint32_t transactionMicros(uint8_t dataBytes) {
+  uint32_t bits = 1 + 9 * (1 + dataBytes) + 1;
+  return (bits * 1000000UL + clockHz - 1) / clockHz;
+}
+
+TwoWire::TwoWire() : txAddress(0), txLength(0), rxLength(0), rxIndex(0) {
+}
+
+void TwoWire::begin() {
+}
+
+void TwoWire::setClock(uint32_t frequency) {
+  clockHz = frequency;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  txAddress = address;
+  txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  if (txLength >= BUFFER_LENGTH) {
+    return 0;
+  }
+  txBuffer[txLength++] = value;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+  size_t n = 0;
+  while (n < quantity && write(data[n])) {
+    n++;
+  }
+  return n;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  (void)sendStop;
+  SimHost::BusTransaction transaction;
+  transaction.startMicros = SimHost::now();
+  auto board = pcaBoards.find(txAddress);
+  transaction.acknowledged = board != pcaBoards.end();
+  transaction.address = txAddress;
+  // A NACKed address ends the transaction after the address byte
+  transaction.length = transaction.acknowledged ? txLength : 0;
+  memcpy(transaction.data, txBuffer, txLength);
+  transaction.durationMicros = transactionMicros(transaction.length);
+  transactions.push_back(transaction);
+  busyMicros += transaction.durationMicros;
+
+  SimHost::advanceMicros(transaction.durationMicros); // Blocking, as the AVR TWI driver
+  if (!transaction.acknowledged) {
+    return 2;
+  }
+  pcaWrite(txAddress, board->second, txBuffer, txLength);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+  rxLength = 0;
+  rxIndex = 0;
+  auto board = pcaBoards.find(address);
+  if (board == pcaBoards.end() || quantity > BUFFER_LENGTH) {
+    return 0;
+  }
+  uint8_t reg = pcaRegisterPointers[address];
+  for (uint8_t i = 0; i < quantity; i++) {
+    rxBuffer[rxLength++] = pcaRead(board->second, reg);
+    if (board->second.mode1 & 0x20) {
+      reg++;
+    }
+  }
+
+  SimHost::BusTransaction transaction;
+  transaction.startMicros = SimHost::now();
+  transaction.acknowledged = true;
+  transaction.address = address;
+  transaction.length = quantity;
+  memcpy(transaction.data, rxBuffer, quantity);
+  transaction.durationMicros = transactionMicros(quantity);
+  transactions.push_back(transaction);
+  busyMicros += transaction.durationMicros;
+  SimHost::advanceMicros(transaction.durationMicros);
+  return quantity;
+}
+
+int TwoWire::available() {
+  return rxLength - rxIndex;
+}
+
+int TwoWire::read() {
+  return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1;
+}
@@ -0,0 +1,41 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+/***********************************************************************************************
+----------------------------    Wire.h (simulation hôte)   ----------------------------------------
+************************************************************************************************
+
+Maître I2C bloquant comme sur AVR : endTransmission() avance l'horloge virtuelle de la
+durée de la transaction et la journalise (SimHost::busLog), tampon de 32 octets
+
+************************************************************************************************/
+
+#define BUFFER_LENGTH 32
+
+class TwoWire {
+private:
+  uint8_t txAddress;
+  uint8_t txBuffer[BUFFER_LENGTH];
+  uint8_t txLength;
+  uint8_t rxBuffer[BUFFER_LENGTH];
+  uint8_t rxLength;
+  uint8_t rxIndex;
+
+public:
+  TwoWire();
+  void begin();
+  void end() {}
+  void setClock(uint32_t frequency);
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool sendStop = true); // 0 = ACK, 2 = address NACK (no device)
+  size_t write(uint8_t value);                   // 0 when the 32-byte buffer is full
+  size_t write(const uint8_t* data, size_t quantity);
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+  int available();
+  int read();
+};
+
+extern TwoWire Wire;
+
+#endif // TwoWire_h
@@ -0,0 +1,43 @@
+#ifndef SERVORIG_H
+#define SERVORIG_H
+
+#include "SimHost.h"
+#include "SimKeyMap.h"
+#include "ServoController.h"
+/***********************************************************************************************
+----------------------------    ServoRig.h   ----------------------------------------
+************************************************************************************************
+
+ServoController prêt à jouer pour les tests : cartes de settings.h sur le bus simulé,
+begin(), homing terminé, journal du bus et compteurs remis à zéro
+
+Pulse width of a channel read back from the simulated PCA9685 registers (OFF - ON, wrapped)
+
+************************************************************************************************/
+
+inline void homeServos(ServoController& servos) {
+  SimKeyMap::addBoards();
+  servos.begin();
+  while (!servos.isHomingComplete()) {
+    servos.update();
+    SimHost::advanceMicros(1000);
+  }
+  servos.update();
+  SimHost::clearBusLog();
+  servos.resetBusStats();
+}
+
+inline uint16_t channelWidth(uint8_t servo) {
+  uint8_t address, channel;
+  SimKeyMap::servoChannel(servo, address, channel);
+  const SimHost::Pca9685State* board = SimHost::pca9685(address);
+  return (board->off[channel] + PWM_PERIOD_TICKS - board->on[channel]) % PWM_PERIOD_TICKS;
+}
+
+// Same arithmetic as the firmware did on every note before the tick tables (map() + 32-bit divide)
+inline uint16_t referenceTicks(long angle) {
+  long pulse = map(angle, SERVO_MIN_ANGLE, SERVO_MAX_ANGLE, SERVO_PULSE_MIN, SERVO_PULSE_MAX);
+  return ((uint32_t)pulse * SERVO_FREQUENCY * 4096UL) / MICROSECONDS_PER_SECOND;
+}
+
+#endif // SERVORIG_H
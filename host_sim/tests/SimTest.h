@@ -0,0 +1,54 @@
+#ifndef SIMTEST_H
+#define SIMTEST_H
+
+#include <iostream>
+/***********************************************************************************************
+----------------------------    SimTest.h   ----------------------------------------
+************************************************************************************************
+
+Vérifications des tests de la simulation hôte (tests/test_*.cpp, un exécutable par fichier,
+lancés par ctest)
+- CHECK(cond) et CHECK_EQUAL(attendu, obtenu) affichent le fichier, la ligne et les valeurs,
+  puis le test continue : un seul passage liste toutes les mesures qui ont changé
+- simTestResult() en fin de main() : code de retour 1 si une vérification a échoué
+
+Inclure avant Arduino.h, comme SimHost.h
+
+************************************************************************************************/
+
+namespace SimTest {
+inline int& failures() {
+  static int count = 0;
+  return count;
+}
+}
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+      SimTest::failures()++; \
+    } \
+  } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+  do { \
+    long long expectedValue_ = (long long)(expected); \
+    long long actualValue_ = (long long)(actual); \
+    if (expectedValue_ != actualValue_) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " = " << actualValue_ \
+                << ", expected " #expected " = " << expectedValue_ << "\n"; \
+      SimTest::failures()++; \
+    } \
+  } while (0)
+
+inline int simTestResult(const char* name) {
+  if (SimTest::failures()) {
+    std::cerr << name << ": " << SimTest::failures() << " check(s) failed\n";
+    return 1;
+  }
+  std::cout << name << ": ok\n";
+  return 0;
+}
+
+#endif // SIMTEST_H
@@ -0,0 +1,55 @@
+/***********************************************************************************************
+----------------------------    config_check   ----------------------------------------
+************************************************************************************************
+
+Configurations de ServoController / Instrument vérifiées à la compilation : une cible par
+CONFIG_CASE, construite par ctest (config_check_*)
+- 0 : configurations valides (une carte et 16 servos, niveaux de debug), doit compiler
+- 1 à 5 : invalides, la compilation doit s'arrêter sur le static_assert attendu
+
+************************************************************************************************/
+#include "instrument.h"
+
+// One board, 16 servos, no air valve: a smaller rig than settings.h
+struct OneBoardTables {
+  static const uint8_t boardCount = 1;
+  static const uint8_t noteCount = 16;
+  static const uint8_t slots[MAX_SERVOS];
+  static uint8_t address(uint8_t) { return 0x40; }
+  static uint16_t phaseBase(uint8_t) { return 0; }
+  static uint16_t phaseStep(uint8_t) { return 256; }
+};
+
+// Three boards, 48 servos: more than noteRouting and VoiceAllocator hold (NUMBER_OF_NOTES)
+struct ThreeBoardTables {
+  static const uint8_t boardCount = 3;
+  static const uint8_t noteCount = 48;
+  static const uint8_t slots[MAX_SERVOS];
+  static uint8_t address(uint8_t board) { return 0x40 + board; }
+  static uint16_t phaseBase(uint8_t) { return 0; }
+  static uint16_t phaseStep(uint8_t) { return 256; }
+};
+
+#if CONFIG_CASE == 0
+typedef ServoControllerT<ServoConfig<1, 16, OneBoardTables, SERVO_DEBUG_OFF> > OneBoard;
+typedef ServoControllerT<ServoConfig<1, 16, OneBoardTables, SERVO_DEBUG_VERBOSE> > OneBoardVerbose;
+static_assert(OneBoard::noteCount == 16 && OneBoard::boardCount == 1, "one board rig");
+static_assert(sizeof(OneBoard::Mask) == 4 && sizeof(OneBoard::Calibration) == 4 + 7 * 16 + 2, "16 servos");
+static_assert(sizeof(OneBoard) < sizeof(ServoController), "tables sized by the configuration");
+static_assert(OneBoardVerbose::debugLevel == SERVO_DEBUG_VERBOSE, "debug level carried by the type");
+static_assert(sizeof(InstrumentT<OneBoard>) < sizeof(Instrument), "instrument sized by its controller");
+#elif CONFIG_CASE == 1
+static const size_t size = sizeof(ServoControllerT<ServoConfig<0, 16, OneBoardTables, SERVO_DEBUG_OFF> >);
+#elif CONFIG_CASE == 2
+static const size_t size = sizeof(ServoControllerT<ServoConfig<1, 20, OneBoardTables, SERVO_DEBUG_OFF> >);
+#elif CONFIG_CASE == 3
+static const size_t size = sizeof(ServoControllerT<ServoConfig<2, 32, OneBoardTables, SERVO_DEBUG_OFF> >);
+#elif CONFIG_CASE == 4
+static const size_t size = sizeof(ServoControllerT<ServoConfig<1, 16, OneBoardTables, 3> >);
+#elif CONFIG_CASE == 5
+static const size_t size = sizeof(InstrumentT<ServoControllerT<ServoConfig<3, 48, ThreeBoardTables, SERVO_DEBUG_OFF> > >);
+#endif
+
+int main() {
+  return 0;
+}
@@ -0,0 +1,90 @@
+/***********************************************************************************************
+----------------------------    test_air_flow   ----------------------------------------
+************************************************************************************************
+
+Servo d'air (AIR_ON_PCA 0, écritures journalisées par le mock Servo) :
+- première note après un silence : une seule écriture, l'angle de son seau de vélocité
+  (bord bas du seau : 1 -> AIR_MIN_ANGLE, 127 -> AIR_MAX_ANGLE)
+- la note tenue la plus forte fixe l'angle, on redescend quand elle est relâchée
+- dernière note relâchée : valve fermée après AIR_HANG_MS
+
+************************************************************************************************/
+#include <iostream>
+#include "SimTest.h"
+#include "ServoRig.h"
+#include "instrument.h"
+
+static size_t airWrites() {
+  size_t writes = 0;
+  for (const SimHost::ServoWrite& w : SimHost::servoLog()) {
+    if (w.pin == AIR_SERVO_PIN) {
+      writes++;
+    }
+  }
+  return writes;
+}
+
+static int airAngle() {
+  int angle = -1;
+  for (const SimHost::ServoWrite& w : SimHost::servoLog()) {
+    if (w.pin == AIR_SERVO_PIN) {
+      angle = w.angle;
+    }
+  }
+  return angle;
+}
+
+static void runMillis(Instrument& instrument, ServoController& servos, uint16_t ms) {
+  for (uint16_t i = 0; i < ms; i++) {
+    SimHost::advanceMicros(1000);
+    instrument.update();
+    servos.update();
+  }
+}
+
+int main() {
+  static_assert(AIR_ON_PCA == 0 && AIR_MIN_ANGLE == 30 && AIR_MAX_ANGLE == 90 && AIR_CLOSED_ANGLE == 0
+                && VELOCITY_BUCKET_SHIFT == 2, "test written for the default settings.h");
+  ServoController servos;
+  homeServos(servos);
+  Instrument instrument(servos, 0);
+  CHECK(instrument.begin());
+  size_t before = airWrites();
+
+  // First note: the air opens once, the key press finds the angle already set
+  instrument.noteOn(FIRST_MIDI_NOTE, 100);
+  runMillis(instrument, servos, AIR_ANTICIPATION_MS + 10);
+  CHECK_EQUAL(1, instrument.getVoiceStats().admittedNotes);
+  CHECK_EQUAL(before + 1, airWrites());
+  CHECK_EQUAL(30 + 100 * 60 / 124, airAngle());
+
+  // Louder note on top: full opening, back down when it is released
+  instrument.noteOn(FIRST_MIDI_NOTE + 1, 127);
+  runMillis(instrument, servos, 1);
+  CHECK_EQUAL(AIR_MAX_ANGLE, airAngle());
+  runMillis(instrument, servos, MIN_NOTE_HOLD_MS);
+  instrument.noteOff(FIRST_MIDI_NOTE + 1);
+  runMillis(instrument, servos, 1);
+  CHECK_EQUAL(30 + 100 * 60 / 124, airAngle());
+
+  // Same bucket again: nothing written
+  size_t held = airWrites();
+  instrument.noteOn(FIRST_MIDI_NOTE + 2, 101);
+  runMillis(instrument, servos, 1);
+  CHECK_EQUAL(held, airWrites());
+
+  // Silence: closed after the hang time, then the softest note opens at the minimum
+  runMillis(instrument, servos, MIN_NOTE_HOLD_MS);
+  instrument.noteOff(FIRST_MIDI_NOTE);
+  instrument.noteOff(FIRST_MIDI_NOTE + 2);
+  runMillis(instrument, servos, AIR_HANG_MS + 10);
+  CHECK_EQUAL(AIR_CLOSED_ANGLE, airAngle());
+  held = airWrites();
+  instrument.noteOn(FIRST_MIDI_NOTE, 1);
+  runMillis(instrument, servos, AIR_ANTICIPATION_MS + 10);
+  CHECK_EQUAL(held + 1, airWrites());
+  CHECK_EQUAL(AIR_MIN_ANGLE, airAngle());
+
+  std::cout << "air flow: " << airWrites() - before << " air writes" << std::endl;
+  return simTestResult("test_air_flow");
+}
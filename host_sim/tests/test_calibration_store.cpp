@@ -0,0 +1,192 @@
+/***********************************************************************************************
+----------------------------    test_calibration_store   ----------------------------------------
+************************************************************************************************
+
+Calibration en EEPROM (banques A/B, séquence, CRC-16), un démarrage = un ServoController neuf
+- bloc des versions 1 à 3 (checksum additif) : migré dans la banque B au premier démarrage,
+  valeurs conservées ; le démarrage suivant ne réécrit rien
+- CRC faux dans la banque la plus récente : la précédente est chargée
+- séquence qui passe de 255 à 0 : 0 est la plus récente ((int8_t)(a - b))
+- aucune banque valide (EEPROM effacée, ou deux CRC faux) : valeurs par défaut, rien d'écrit
+
+************************************************************************************************/
+#include <string.h>
+#include "SimTest.h"
+#include "ServoRig.h"
+
+#define BANK_A EEPROM_START_ADDRESS
+#define BANK_B (EEPROM_START_ADDRESS + sizeof(CalibrationData))
+
+static void eraseEeprom() {
+  memset(SimHost::eeprom(), 0xFF, E2END + 1);
+}
+
+static uint16_t eepromWord(uint16_t address) {
+  return SimHost::eeprom()[address] | (SimHost::eeprom()[address + 1] << 8);
+}
+
+static uint16_t storedAngle(ServoController& servos, uint8_t servo) {
+  uint16_t offset = offsetof(CalibrationData, servoAngles) + 2 * servo;
+  return servos.readCalibrationImage(offset) | (servos.readCalibrationImage(offset + 1) << 8);
+}
+
+// CRC-16/CCITT (0x1021, init 0xFFFF) written independently of the firmware
+static void resealBank(uint16_t address, uint8_t sequence) {
+  uint8_t* bytes = SimHost::eeprom() + address;
+  bytes[offsetof(CalibrationData, sequence)] = sequence;
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < offsetof(CalibrationData, crc); i++) {
+    crc ^= bytes[i] << 8;
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  bytes[offsetof(CalibrationData, crc)] = crc & 0xFF;
+  bytes[offsetof(CalibrationData, crc) + 1] = crc >> 8;
+}
+
+// Versions 1 to 3: magic, version, angles, then 1 (v1), 4 (v2) or 5 (v3) byte tables, additive checksum
+static void writeLegacyBlock(uint8_t version) {
+  uint8_t* bytes = SimHost::eeprom() + EEPROM_START_ADDRESS;
+  uint8_t tables = (version >= 3) ? 5 : (version >= 2) ? 4 : 1;
+  uint16_t sum = EEPROM_MAGIC_NUMBER + version;
+  bytes[0] = EEPROM_MAGIC_NUMBER & 0xFF;
+  bytes[1] = EEPROM_MAGIC_NUMBER >> 8;
+  bytes[2] = version;
+  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+    uint16_t angle = 80 + i % 10;
+    bytes[3 + 2 * i] = angle & 0xFF;
+    bytes[4 + 2 * i] = angle >> 8;
+    sum += angle;
+  }
+  uint16_t tablesStart = 3 + 2 * NUMBER_OF_NOTES;
+  for (uint8_t t = 0; t < tables; t++) {
+    for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+      // Directions -1, then hover 4, press 18, overshoot 3, travel 25
+      static const uint8_t values[5] = {0xFF, 4, 18, 3, 25};
+      bytes[tablesStart + t * NUMBER_OF_NOTES + i] = values[t];
+      sum += values[t];
+    }
+  }
+  uint16_t end = tablesStart + tables * NUMBER_OF_NOTES;
+  bytes[end] = sum & 0xFF;
+  bytes[end + 1] = sum >> 8;
+}
+
+static void legacyMigration(uint8_t version) {
+  eraseEeprom();
+  writeLegacyBlock(version);
+  uint32_t writes = SimHost::eepromWrites();
+  {
+    ServoController servos;
+    CHECK(servos.isCalibrationValid());
+    CHECK(SimHost::eepromWrites() > writes);
+    CHECK_EQUAL(EEPROM_MAGIC_NUMBER, eepromWord(BANK_B + offsetof(CalibrationData, magicNumber)));
+    CHECK_EQUAL(EEPROM_VERSION, SimHost::eeprom()[BANK_B + offsetof(CalibrationData, version)]);
+    CHECK_EQUAL(83, storedAngle(servos, 3));
+    CHECK_EQUAL(0xFF, servos.readCalibrationImage(offsetof(CalibrationData, servoDirections) + 5));
+    if (version >= 2) {
+      CHECK_EQUAL(4, servos.readCalibrationImage(offsetof(CalibrationData, hoverOffsets) + 7));
+      CHECK_EQUAL(18, servos.readCalibrationImage(offsetof(CalibrationData, pressTravels) + 7));
+      CHECK_EQUAL(3, servos.readCalibrationImage(offsetof(CalibrationData, releaseOvershoots) + 7));
+    } else {
+      CHECK_EQUAL(ANGLE_NOTE_ON, servos.readCalibrationImage(offsetof(CalibrationData, pressTravels) + 7));
+    }
+    if (version >= 3) {
+      CHECK_EQUAL(25, servos.getTravelTime(9));
+    } else {
+      CHECK_EQUAL(servos.estimatePressMs(9), servos.getTravelTime(9));
+    }
+  }
+
+  // Second boot: bank B loaded as is
+  writes = SimHost::eepromWrites();
+  ServoController servos;
+  CHECK(servos.isCalibrationValid());
+  CHECK_EQUAL(writes, SimHost::eepromWrites());
+  CHECK_EQUAL(89, storedAngle(servos, 9));
+}
+
+// Banks A (sequence 1, servo 0 at 80°) then B (sequence 2, 70°), both written by the firmware
+static void writeTwoBanks() {
+  eraseEeprom();
+  ServoController servos;
+  servos.setServoCalibration(0, 80, 1);
+  servos.saveCalibration();
+  servos.setServoCalibration(0, 70, 1);
+  servos.saveCalibration();
+  CHECK_EQUAL(1, SimHost::eeprom()[BANK_A + offsetof(CalibrationData, sequence)]);
+  CHECK_EQUAL(2, SimHost::eeprom()[BANK_B + offsetof(CalibrationData, sequence)]);
+}
+
+static void corruptNewestBank() {
+  writeTwoBanks();
+  {
+    ServoController servos;
+    CHECK_EQUAL(70, storedAngle(servos, 0));
+  }
+  SimHost::eeprom()[BANK_B + offsetof(CalibrationData, servoAngles) + 10] ^= 0x01;
+  uint32_t writes = SimHost::eepromWrites();
+  ServoController servos;
+  CHECK(servos.isCalibrationValid());
+  CHECK_EQUAL(80, storedAngle(servos, 0));
+  CHECK_EQUAL(writes, SimHost::eepromWrites());
+
+  // The next save goes over the corrupt bank, with the next sequence number
+  servos.setServoCalibration(0, 75, 1);
+  servos.saveCalibration();
+  CHECK_EQUAL(2, SimHost::eeprom()[BANK_B + offsetof(CalibrationData, sequence)]);
+  ServoController reboot;
+  CHECK_EQUAL(75, storedAngle(reboot, 0));
+}
+
+static void sequenceWrap() {
+  writeTwoBanks();
+  resealBank(BANK_A, 255);
+  resealBank(BANK_B, 0);
+  {
+    ServoController servos;
+    CHECK_EQUAL(70, storedAngle(servos, 0)); // B: 0 follows 255
+    servos.setServoCalibration(0, 60, 1);
+    servos.saveCalibration();                // To A, sequence 1
+    CHECK_EQUAL(1, SimHost::eeprom()[BANK_A + offsetof(CalibrationData, sequence)]);
+  }
+  ServoController servos;
+  CHECK_EQUAL(60, storedAngle(servos, 0));
+
+  resealBank(BANK_A, 0);
+  resealBank(BANK_B, 255);
+  ServoController swapped;
+  CHECK_EQUAL(60, storedAngle(swapped, 0)); // A: 0 follows 255
+}
+
+static void noValidBank() {
+  eraseEeprom();
+  uint32_t writes = SimHost::eepromWrites();
+  {
+    ServoController servos;
+    CHECK(!servos.isCalibrationValid());
+    CHECK_EQUAL(48, servos.estimatePressMs(0));  // Default 20° travel
+    CHECK_EQUAL(48, servos.getTravelTime(0));
+  }
+  CHECK_EQUAL(writes, SimHost::eepromWrites());
+
+  writeTwoBanks();
+  SimHost::eeprom()[BANK_A + offsetof(CalibrationData, crc)] ^= 0x80;
+  SimHost::eeprom()[BANK_B + offsetof(CalibrationData, travelTimes)] ^= 0x80;
+  writes = SimHost::eepromWrites();
+  ServoController servos;
+  CHECK(!servos.isCalibrationValid());
+  CHECK_EQUAL(writes, SimHost::eepromWrites());
+}
+
+int main() {
+  static_assert(EEPROM_VERSION == 4, "legacy layouts written for versions 1 to 3");
+  noValidBank();
+  legacyMigration(1);
+  legacyMigration(2);
+  legacyMigration(3);
+  corruptNewestBank();
+  sequenceWrap();
+  return simTestResult("test_calibration_store");
+}
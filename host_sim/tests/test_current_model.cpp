@@ -0,0 +1,67 @@
+/***********************************************************************************************
+----------------------------    test_current_model   ----------------------------------------
+************************************************************************************************
+
+Décalage de phase des impulsions PWM (appel de courant des SG90), modèle tick par tick
+- début d'impulsion de chaque canal dans les registres = pwmPhaseBase + canal * pwmPhaseStep
+- nombre d'impulsions hautes sur chacun des 4096 ticks de la période, calculé à partir des
+  registres des PCA9685 simulés : son maximum = peakConcurrentPulses() du firmware
+- au repos et touches toutes enfoncées, décalées contre toutes au tick 0 (PWM_PHASE_MODE 0) :
+  le pic passe du nombre de servos à quelques impulsions
+
+************************************************************************************************/
+#include <algorithm>
+#include <iostream>
+#include "SimTest.h"
+#include "ServoRig.h"
+
+// Pulses high on each tick of the period, from the simulated registers; returns the peak
+static uint8_t registerPeak(bool phased) {
+  uint8_t perTick[PWM_PERIOD_TICKS] = {0};
+  for (uint8_t servo = 0; servo < NUMBER_OF_NOTES; servo++) {
+    uint8_t address, channel;
+    SimKeyMap::servoChannel(servo, address, channel);
+    const SimHost::Pca9685State* board = SimHost::pca9685(address);
+    uint16_t start = phased ? board->on[channel] : 0;
+    uint16_t width = channelWidth(servo);
+    for (uint16_t t = 0; t < width; t++) {
+      perTick[(start + t) % PWM_PERIOD_TICKS]++;
+    }
+  }
+  return *std::max_element(perTick, perTick + PWM_PERIOD_TICKS);
+}
+
+int main() {
+  static_assert(PWM_PHASE_MODE && !AIR_ON_PCA && NUMBER_OF_NOTES == 32 && PCA_BOARD_COUNT == 2,
+                "test written for the default settings.h");
+  ServoController servos;
+  homeServos(servos);
+
+  for (uint8_t servo = 0; servo < NUMBER_OF_NOTES; servo++) {
+    uint8_t address, channel;
+    SimKeyMap::servoChannel(servo, address, channel);
+    uint8_t board = (address == pcaAddresses[0]) ? 0 : 1;
+    CHECK_EQUAL((pwmPhaseBase[board] + channel * pwmPhaseStep[board]) % PWM_PERIOD_TICKS,
+                SimHost::pca9685(address)->on[channel]);
+  }
+
+  // At rest (90°: 1.5 ms = 307 ticks), 256-tick steps and the second board 128 ticks later
+  uint8_t restPeak = registerPeak(true);
+  CHECK_EQUAL(restPeak, servos.peakConcurrentPulses());
+  CHECK_EQUAL(NUMBER_OF_NOTES, registerPeak(false));
+  CHECK_EQUAL(3, restPeak);
+
+  // Every key down (70°: 1.28 ms = 262 ticks), the worst chord for the 5 V rail
+  for (uint8_t servo = 0; servo < NUMBER_OF_NOTES; servo++) {
+    servos.noteOn(servo);
+  }
+  servos.flush();
+  uint8_t chordPeak = registerPeak(true);
+  CHECK_EQUAL(chordPeak, servos.peakConcurrentPulses());
+  CHECK_EQUAL(NUMBER_OF_NOTES, registerPeak(false));
+  CHECK_EQUAL(3, chordPeak);
+
+  std::cout << "peak concurrent pulses, " << NUMBER_OF_NOTES << " servos: at rest " << (int)restPeak
+            << ", all keys down " << (int)chordPeak << " (" << NUMBER_OF_NOTES << " without phase offsets)\n";
+  return simTestResult("test_current_model");
+}
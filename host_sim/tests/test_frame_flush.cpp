@@ -0,0 +1,150 @@
+/***********************************************************************************************
+----------------------------    test_frame_flush   ----------------------------------------
+************************************************************************************************
+
+Tables de ticks précalculées et trames I2C groupées, vérifiées sur le bus simulé
+- largeur d'impulsion de chaque touche (registres du PCA9685) = l'ancien calcul
+  constrain + map() + division 32 bits, pour l'appui et le repos
+- accord de touches contiguës : une rafale (registre + 4 octets par canal, 7 canaux au plus
+  dans le tampon Wire de 32 octets) au lieu d'un setPWM() par touche ; octets, transactions
+  et durée comparés à ceux de setPWM() sur le même bus
+- valeur remplacée avant le flush (coalescée) ou déjà sur la carte (supprimée) : rien de plus
+- microbenchmark : accords de 14 touches (deux rafales de 7 canaux), relâchés après
+  MIN_NOTE_HOLD_MS (puis posés après RELEASE_OVERSHOOT_MS) ; nombre et taille des rafales
+  vérifiés, temps hôte par noteOn/noteOff (lecture de table et flush) contre le calcul par appel
+
+************************************************************************************************/
+#include <chrono>
+#include <iostream>
+#include "SimTest.h"
+#include "ServoRig.h"
+
+// Bus time of one transaction carrying `bytes` data bytes at the current clock
+static uint32_t busMicros(uint8_t bytes) {
+  return ((1 + 9 * (1 + bytes) + 1) * 1000000UL + SimHost::busClock() - 1) / SimHost::busClock();
+}
+
+int main() {
+  static_assert(PCA_BOARD_COUNT >= 2 && PCA_CHANNEL_COUNT == 16 && NUMBER_OF_NOTES >= 26 && !AIR_ON_PCA,
+                "test written for the default settings.h");
+  ServoController servos;
+  homeServos(servos);
+
+  // Rest positions from homing match the per-call computation
+  for (uint8_t i = 0; i < NUMBER_OF_NOTES; i++) {
+    CHECK_EQUAL(referenceTicks(initialAngles[i] - DEFAULT_HOVER_OFFSET * sensRot[i]), channelWidth(i));
+  }
+
+  // Chord of 6 contiguous keys: one burst of register + 24 bytes
+  for (uint8_t i = 0; i < 6; i++) {
+    servos.noteOn(i);
+  }
+  CHECK_EQUAL(0, SimHost::busLog().size()); // Nothing before the flush
+  servos.flush();
+  CHECK_EQUAL(1, SimHost::busLog().size());
+  CHECK_EQUAL(25, SimHost::busLog()[0].length);
+  CHECK_EQUAL(busMicros(25), SimHost::busLog()[0].durationMicros);
+  CHECK_EQUAL(26, servos.getBusStats().lastFlushBytes); // Address byte included
+  CHECK_EQUAL(1, servos.getBusStats().lastFlushTransactions);
+  for (uint8_t i = 0; i < 6; i++) {
+    CHECK_EQUAL(referenceTicks(initialAngles[i] - ANGLE_NOTE_ON * sensRot[i]), channelWidth(i));
+  }
+  uint64_t burstMicros = SimHost::busBusyMicros();
+
+  // The same 6 channels written one setPWM() at a time, as before the frames
+  SimHost::clearBusLog();
+  Adafruit_PWMServoDriver direct(pcaAddresses[0]);
+  for (uint8_t c = 0; c < 6; c++) {
+    direct.setPWM(c, 0, 300);
+  }
+  CHECK_EQUAL(6, SimHost::busLog().size());
+  CHECK_EQUAL(6 * busMicros(5), SimHost::busBusyMicros());
+  CHECK_EQUAL(2360, burstMicros);
+  CHECK_EQUAL(3360, SimHost::busBusyMicros());
+
+  // 10 contiguous keys on the second board: 7 channels fit the Wire buffer, then 3
+  SimHost::clearBusLog();
+  servos.resetBusStats();
+  for (uint8_t i = 16; i < 26; i++) {
+    servos.noteOn(i);
+  }
+  servos.flush();
+  CHECK_EQUAL(2, SimHost::busLog().size());
+  CHECK_EQUAL(pcaAddresses[1], SimHost::busLog()[0].address);
+  CHECK_EQUAL(1 + 4 * 7, SimHost::busLog()[0].length);
+  CHECK_EQUAL(1 + 4 * 3, SimHost::busLog()[1].length);
+  CHECK_EQUAL(2 + 4 * 7 + 2 + 4 * 3, servos.getBusStats().lastFlushBytes);
+
+  // Key pressed twice before the flush: one write. Pressed again once written: no write.
+  SimHost::clearBusLog();
+  servos.resetBusStats();
+  servos.noteOn(30);
+  servos.noteOn(30);
+  servos.flush();
+  CHECK_EQUAL(1, servos.getBusStats().coalescedWrites);
+  CHECK_EQUAL(1, SimHost::busLog().size());
+  servos.noteOn(30);
+  servos.flush();
+  CHECK_EQUAL(1, servos.getBusStats().suppressedWrites);
+  CHECK_EQUAL(1, SimHost::busLog().size());
+
+  // Host microbenchmark: note path (table) against the per-call arithmetic it replaced
+  const uint32_t rounds = 200000;
+  volatile uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    uint8_t servo = r % NUMBER_OF_NOTES;
+    sink += referenceTicks(initialAngles[servo] - ANGLE_NOTE_ON * sensRot[servo]);
+    sink += referenceTicks(initialAngles[servo]);
+  }
+  double perCallNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+  // Chords of 14 keys on the first board, each release once MIN_NOTE_HOLD_MS is up (no deferral):
+  // press, release (and settle after an overshoot) each go out as 2 bursts of 7 channels
+  const uint8_t chord = 14;
+  const uint32_t chords = rounds / chord;
+  const uint8_t phases = DEFAULT_RELEASE_OVERSHOOT > 0 ? 3 : 2;
+  uint32_t bursts = 0;
+  uint32_t fullBursts = 0;
+  uint32_t releasedAtOnce = 0; // Chords whose release went out in the noteOff flush, not deferred
+  for (uint8_t servo = 0; servo < chord; servo++) {
+    servos.noteOff(servo, true); // Keys of the first chord back at rest
+  }
+  SimHost::advanceMicros(RELEASE_OVERSHOOT_MS * 1000UL);
+  servos.update();
+  SimHost::clearBusLog();
+  servos.resetBusStats();
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < chords; r++) {
+    for (uint8_t servo = 0; servo < chord; servo++) {
+      servos.noteOn(servo);
+    }
+    servos.flush();
+    SimHost::advanceMicros(MIN_NOTE_HOLD_MS * 1000UL);
+    for (uint8_t servo = 0; servo < chord; servo++) {
+      servos.noteOff(servo);
+    }
+    servos.flush();
+    releasedAtOnce += (SimHost::busLog().size() == 4);
+    SimHost::advanceMicros(RELEASE_OVERSHOOT_MS * 1000UL);
+    servos.update(); // Overshoot over, if any: rest position
+    for (const SimHost::BusTransaction& t : SimHost::busLog()) {
+      bursts++;
+      fullBursts += (t.length == 1 + 4 * 7);
+    }
+    SimHost::clearBusLog();
+  }
+  double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (chords * chord);
+  CHECK_EQUAL(chords, releasedAtOnce);
+  CHECK_EQUAL(chords * phases * 2, bursts);
+  CHECK_EQUAL(bursts, fullBursts);
+  for (uint8_t servo = 0; servo < chord; servo++) {
+    CHECK_EQUAL(referenceTicks(initialAngles[servo] - DEFAULT_HOVER_OFFSET * sensRot[servo]), channelWidth(servo));
+  }
+  // Not checked: host CPU time says little about the ATmega32u4 division, see avr/ for cycles
+  std::cout << "noteOn+noteOff (table, frame buffer, flush on the simulated bus): " << tableNs
+            << " ns, tick arithmetic it replaced: " << perCallNs << " ns per pair (host CPU), "
+            << bursts << " bursts of 7 channels\n";
+
+  return simTestResult("test_frame_flush");
+}
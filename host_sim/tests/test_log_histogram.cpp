@@ -0,0 +1,67 @@
+/***********************************************************************************************
+----------------------------    test_log_histogram   ----------------------------------------
+************************************************************************************************
+
+Seaux par doublement partagés par LatencyStats (premier seau < 256 µs) et LoopProfiler
+(< 16 µs) : seau d'une valeur, saturation à 65535, percentiles, bornes affichées
+
+************************************************************************************************/
+#include <iostream>
+#include <string>
+#include "SimTest.h"
+#include "SimHost.h"
+#include "LogHistogram.h"
+
+typedef LogHistogram<12, 4> Histogram;
+
+int main() {
+  uint16_t counts[12] = {0};
+
+  // Edges 16, 32, 64 ... 16384, last bucket unbounded
+  Histogram::add(counts, 0);
+  Histogram::add(counts, 15);
+  Histogram::add(counts, 16);
+  Histogram::add(counts, 31);
+  Histogram::add(counts, 16383);
+  Histogram::add(counts, 16384);
+  Histogram::add(counts, 0xFFFFFFFFUL);
+  CHECK_EQUAL(2, counts[0]);
+  CHECK_EQUAL(2, counts[1]);
+  CHECK_EQUAL(1, counts[10]);
+  CHECK_EQUAL(2, counts[11]);
+  CHECK_EQUAL(7, Histogram::total(counts));
+  CHECK_EQUAL(16, Histogram::edge(0));
+  CHECK_EQUAL(16384, Histogram::edge(10));
+
+  // Percentile: smallest bucket holding the rank (rounded up)
+  CHECK_EQUAL(0, Histogram::percentile(counts, 0));
+  CHECK_EQUAL(0, Histogram::percentile(counts, 285));  // 2 of 7
+  CHECK_EQUAL(1, Histogram::percentile(counts, 500));  // rank 4
+  CHECK_EQUAL(11, Histogram::percentile(counts, 990));
+  uint16_t empty[12] = {0};
+  CHECK_EQUAL(LOG_HISTOGRAM_NO_BUCKET, Histogram::percentile(empty, 500));
+
+  // Counters stop at 65535
+  counts[3] = 0xFFFE;
+  Histogram::add(counts, 100);
+  Histogram::add(counts, 100);
+  CHECK_EQUAL(0xFFFF, counts[3]);
+
+  // "<edge", ">=edge of the previous one" for the last bucket
+  SimHost::serialOutput().clear();
+  Histogram::printBucket(Serial, 2);
+  Serial.print(' ');
+  Histogram::printBucket(Serial, 11);
+  CHECK(SimHost::serialOutput() == "<64 >=16384");
+
+  // Same arithmetic with the latency edges
+  typedef LogHistogram<12, 8> Latency;
+  uint16_t latency[12] = {0};
+  Latency::add(latency, 255);
+  Latency::add(latency, 256);
+  CHECK_EQUAL(1, latency[0]);
+  CHECK_EQUAL(1, latency[1]);
+  CHECK_EQUAL(524288, Latency::edge(11));
+
+  return simTestResult("test_log_histogram");
+}
@@ -0,0 +1,188 @@
+/***********************************************************************************************
+----------------------------    test_midi_event_ring   ----------------------------------------
+************************************************************************************************
+
+MidiEventRing sous rafales plus longues que sa capacité
+- chaque événement poussé est soit lu une fois, dans l'ordre, soit compté une fois dans
+  getOverflowCount() : acceptés + débordements = poussés, rien n'est perdu sans être compté
+- getHighWaterMark() = plus grand remplissage réellement atteint
+- plusieurs milliers d'événements : les index 8 bits head/tail font de nombreux tours
+- même contrôle avec le producteur et le consommateur sur deux threads
+- un événement resté plus de 256 ms dans la file (sauvegarde EEPROM, homing) garde sa date
+  de réception : l'instrument en tient compte dans la latence de l'appui
+
+************************************************************************************************/
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+#include "SimHost.h"
+#include "SimTest.h"
+#include "MidiEventRing.h"
+#include "ServoRig.h"
+#include "instrument.h"
+
+// 14-bit sequence number carried in data1/data2, status cycles through note messages
+static void encode(uint16_t sequence, uint8_t& status, uint8_t& data1, uint8_t& data2) {
+  status = 0x80 | ((sequence >> 14) & 0x1F);
+  data1 = sequence & 0x7F;
+  data2 = (sequence >> 7) & 0x7F;
+}
+
+static uint16_t decode(const MidiEvent& event) {
+  return event.data1 | (event.data2 << 7);
+}
+
+static void burstsAgainstModel() {
+  MidiEventRing ring;
+  std::deque<uint16_t> model; // Events accepted and not yet read
+  uint32_t pushed = 0;
+  uint32_t accepted = 0;
+  uint32_t overflows = 0;
+  uint32_t highWater = 0;
+  bool orderOk = true;
+
+  // Burst sizes around and above the capacity, drains that leave the ring partly full
+  const uint16_t bursts[] = {MIDI_RING_CAPACITY + 37, 5, MIDI_RING_CAPACITY, 1, 2 * MIDI_RING_CAPACITY + 3, 17};
+  const uint16_t drains[] = {MIDI_RING_CAPACITY / 2, 3, MIDI_RING_CAPACITY, 0, MIDI_RING_CAPACITY - 1, 200};
+  for (uint16_t round = 0; round < 300; round++) {
+    uint16_t burst = bursts[round % 6];
+    for (uint16_t i = 0; i < burst; i++) {
+      uint8_t status, data1, data2;
+      encode(pushed & 0x3FFF, status, data1, data2);
+      bool wasFull = model.size() == MIDI_RING_CAPACITY;
+      bool ok = ring.push(status, data1, data2);
+      CHECK(ok == !wasFull);
+      if (ok) {
+        model.push_back(pushed & 0x3FFF);
+        accepted++;
+        highWater = std::max<uint32_t>(highWater, model.size());
+      } else {
+        overflows++;
+      }
+      pushed++;
+    }
+    CHECK_EQUAL(model.size(), ring.size());
+
+    uint16_t drain = drains[(round * 5) % 6];
+    MidiEvent event;
+    for (uint16_t i = 0; i < drain && ring.pop(event); i++) {
+      orderOk = orderOk && !model.empty() && decode(event) == model.front();
+      model.pop_front();
+    }
+    CHECK_EQUAL(model.size(), ring.size());
+  }
+  MidiEvent event;
+  while (ring.pop(event)) {
+    orderOk = orderOk && !model.empty() && decode(event) == model.front();
+    model.pop_front();
+  }
+
+  CHECK(orderOk);
+  CHECK(model.empty());
+  CHECK(pushed > 50 * 256);           // Head wrapped many times
+  CHECK(overflows > 0);
+  CHECK_EQUAL(pushed, accepted + overflows);
+  CHECK_EQUAL(overflows, ring.getOverflowCount());
+  CHECK_EQUAL(MIDI_RING_CAPACITY, highWater);
+  CHECK_EQUAL(highWater, ring.getHighWaterMark());
+
+  ring.resetStats();
+  CHECK_EQUAL(0, ring.getOverflowCount());
+  CHECK_EQUAL(0, ring.getHighWaterMark());
+}
+
+// High-water mark below capacity when the consumer keeps up
+static void highWaterBelowCapacity() {
+  MidiEventRing ring;
+  MidiEvent event;
+  for (uint16_t i = 0; i < 1000; i++) {
+    for (uint8_t n = 0; n < 1 + i % 7; n++) {
+      CHECK(ring.push(0x90, n, 100));
+    }
+    while (ring.pop(event)) {
+    }
+  }
+  CHECK_EQUAL(7, ring.getHighWaterMark());
+  CHECK_EQUAL(0, ring.getOverflowCount());
+}
+
+// Producer and consumer threads: the ring as used between the ESP32 transport task and loop()
+static void concurrentBursts() {
+  MidiEventRing ring;
+  const uint32_t total = 200000;
+  std::atomic<bool> done(false);
+  std::vector<uint16_t> accepted;
+  std::vector<uint16_t> received;
+  accepted.reserve(total);
+  received.reserve(total);
+
+  std::thread consumer([&]() {
+    MidiEvent event;
+    uint32_t spin = 0;
+    while (true) {
+      if (ring.pop(event)) {
+        received.push_back(decode(event));
+      } else if (done.load()) {
+        if (!ring.pop(event)) {
+          break;
+        }
+        received.push_back(decode(event));
+      } else if (++spin % 64 == 0) {
+        std::this_thread::yield(); // Slower than the producer now and then: overflows happen
+      }
+    }
+  });
+
+  uint32_t overflows = 0;
+  for (uint32_t i = 0; i < total; i++) {
+    uint8_t status, data1, data2;
+    encode(i & 0x3FFF, status, data1, data2);
+    if (ring.push(status, data1, data2)) {
+      accepted.push_back(i & 0x3FFF);
+    } else {
+      overflows++;
+    }
+  }
+  done.store(true);
+  consumer.join();
+
+  CHECK_EQUAL(total, accepted.size() + overflows);
+  CHECK_EQUAL((uint16_t)overflows, ring.getOverflowCount()); // 16-bit counter
+  CHECK(received == accepted);
+  CHECK(ring.getHighWaterMark() <= MIDI_RING_CAPACITY);
+  CHECK_EQUAL(0, ring.size());
+}
+
+// Events that wait longer than 256 ms: the 16-bit timestamp still gives the arrival time
+static void longWaitKeepsArrivalTime() {
+  MidiEventRing ring;
+  MidiEvent event;
+  const unsigned long waits[] = {300, 1000, 60000};
+  for (unsigned long wait : waits) {
+    CHECK(ring.push(0x90, 60, 100));
+    unsigned long pushed = millis();
+    SimHost::advanceMicros(wait * 1000);
+    CHECK(ring.pop(event));
+    CHECK_EQUAL(pushed & 0xFFFF, event.timestamp);
+    CHECK_EQUAL(wait, (uint16_t)((uint16_t)millis() - event.timestamp));
+  }
+
+  // Note queued while the loop was busy for 300 ms: the onset latency counts the wait
+  ServoController servos;
+  homeServos(servos);
+  Instrument instrument(servos, 0);
+  CHECK(instrument.begin());
+  CHECK(instrument.eventRing().push(0x90, FIRST_MIDI_NOTE, 100));
+  SimHost::advanceMicros(300000UL);
+  instrument.update();
+  CHECK_EQUAL(300 + AIR_ANTICIPATION_MS, instrument.getLastOnsetLatency());
+}
+
+int main() {
+  burstsAgainstModel();
+  longWaitKeepsArrivalTime();
+  highWaterBelowCapacity();
+  concurrentBursts();
+  return simTestResult("test_midi_event_ring");
+}
@@ -0,0 +1,77 @@
+/***********************************************************************************************
+----------------------------    test_midi_stream_parser   ----------------------------------------
+************************************************************************************************
+
+MidiStreamParser (prise DIN) : flux d'octets -> paquets USB-MIDI attendus
+- running status, canal 2 octets et 1 octet (Program Change)
+- temps réel (0xF8-0xFF) au milieu d'un message et d'un SysEx : paquet immédiat, le message
+  en cours continue
+- SysEx de toutes les longueurs : paquets CIN 0x4 de 3 octets, fin en 0x5 / 0x6 / 0x7
+- SysEx interrompu par un statut, system common, octets de données sans statut
+
+************************************************************************************************/
+#include <vector>
+#include "SimTest.h"
+#include "MidiStreamParser.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Every packet as header, byte1, byte2, byte3
+static Bytes parse(MidiStreamParser& parser, const Bytes& stream) {
+  Bytes packets;
+  midiEventPacket_t packet;
+  for (uint8_t value : stream) {
+    if (parser.parse(value, packet)) {
+      packets.push_back(packet.header);
+      packets.push_back(packet.byte1);
+      packets.push_back(packet.byte2);
+      packets.push_back(packet.byte3);
+    }
+  }
+  return packets;
+}
+
+#define CHECK_PACKETS(stream, expected) CHECK(parse(parser, stream) == Bytes(expected))
+
+int main() {
+  MidiStreamParser parser;
+
+  // Running status
+  CHECK_PACKETS(Bytes({0x90, 0x40, 0x64, 0x41, 0x64, 0x42, 0x00}),
+                Bytes({0x09, 0x90, 0x40, 0x64, 0x09, 0x90, 0x41, 0x64, 0x09, 0x90, 0x42, 0x00}));
+  CHECK_PACKETS(Bytes({0xC3, 0x05, 0x06}), Bytes({0x0C, 0xC3, 0x05, 0x00, 0x0C, 0xC3, 0x06, 0x00}));
+
+  // Real-time inside a note and between running-status messages
+  CHECK_PACKETS(Bytes({0x80, 0xF8, 0x40, 0xFE, 0x00, 0xFA, 0x41, 0x00}),
+                Bytes({0x0F, 0xF8, 0x00, 0x00, 0x0F, 0xFE, 0x00, 0x00, 0x08, 0x80, 0x40, 0x00,
+                       0x0F, 0xFA, 0x00, 0x00, 0x08, 0x80, 0x41, 0x00}));
+
+  // SysEx of 3, 4, 5 and 6 bytes: end packet with 1, 2, 3 bytes, or one byte after a full packet
+  CHECK_PACKETS(Bytes({0xF0, 0x7D, 0xF7}), Bytes({0x07, 0xF0, 0x7D, 0xF7}));
+  CHECK_PACKETS(Bytes({0xF0, 0x7D, 0x00, 0xF7}), Bytes({0x04, 0xF0, 0x7D, 0x00, 0x05, 0xF7, 0x00, 0x00}));
+  CHECK_PACKETS(Bytes({0xF0, 0x7D, 0x00, 0x01, 0xF7}), Bytes({0x04, 0xF0, 0x7D, 0x00, 0x06, 0x01, 0xF7, 0x00}));
+  CHECK_PACKETS(Bytes({0xF0, 0x7D, 0x00, 0x01, 0x01, 0xF7}), Bytes({0x04, 0xF0, 0x7D, 0x00, 0x07, 0x01, 0x01, 0xF7}));
+
+  // Clock ticks inside a SysEx split over several packets
+  CHECK_PACKETS(Bytes({0xF0, 0x7D, 0xF8, 0x00, 0x02, 0x01, 0xF8, 0x4A, 0x7F, 0xF7}),
+                Bytes({0x0F, 0xF8, 0x00, 0x00, 0x04, 0xF0, 0x7D, 0x00, 0x0F, 0xF8, 0x00, 0x00,
+                       0x04, 0x02, 0x01, 0x4A, 0x06, 0x7F, 0xF7, 0x00}));
+
+  // SysEx ends the running status; data bytes without status are dropped
+  CHECK_PACKETS(Bytes({0x90, 0x40, 0x64, 0xF0, 0x01, 0xF7, 0x41, 0x64}),
+                Bytes({0x09, 0x90, 0x40, 0x64, 0x07, 0xF0, 0x01, 0xF7}));
+
+  // A status byte inside a SysEx aborts it without an end packet
+  CHECK_PACKETS(Bytes({0xF0, 0x01, 0x02, 0x03, 0x04, 0x91, 0x45, 0x20}),
+                Bytes({0x04, 0xF0, 0x01, 0x02, 0x09, 0x91, 0x45, 0x20}));
+
+  // System common: Song Position, MTC quarter frame, Tune Request; no running status after them
+  CHECK_PACKETS(Bytes({0xF2, 0x10, 0x20, 0xF1, 0x05, 0x06, 0xF6, 0x40}),
+                Bytes({0x03, 0xF2, 0x10, 0x20, 0x02, 0xF1, 0x05, 0x00, 0x05, 0xF6, 0x00, 0x00}));
+
+  // Cable plugged in mid-message: data bytes until the first status are ignored
+  parser.reset();
+  CHECK_PACKETS(Bytes({0x40, 0x64, 0xB0, 0x07, 0x64}), Bytes({0x0B, 0xB0, 0x07, 0x64}));
+
+  return simTestResult("test_midi_stream_parser");
+}
@@ -0,0 +1,83 @@
+/***********************************************************************************************
+----------------------------    test_motion_profile   ----------------------------------------
+************************************************************************************************
+
+Profils de mouvement : modèle cinématique et séquence réellement envoyée aux PCA9685
+- modèle SG90 (1,7 ms/degré, ralentissement sous 8° d'erreur, arrivé à 1°) :
+  course simple de 20° = 48 ms à l'appui comme au relâchement ;
+  survol à 12° et appui à 20° = 28 ms ; dépassement de 6° au relâchement = 14 ms
+- registres : appui -> angle d'appui, relâchement -> dépassement puis survol
+  RELEASE_OVERSHOOT_MS plus tard, à la milliseconde de update() près
+- relâchement avant MIN_NOTE_HOLD_MS : la touche reste enfoncée jusque-là
+
+************************************************************************************************/
+#include <iostream>
+#include "SimTest.h"
+#include "ServoRig.h"
+
+// Runs update() every millisecond until the servo's pulse width is `ticks`,
+// returns the virtual time of that channel write, µs after `since`
+static uint64_t microsUntilWidth(ServoController& servos, uint8_t servo, uint16_t ticks, uint64_t since) {
+  for (uint16_t ms = 0; channelWidth(servo) != ticks && ms < 1000; ms++) {
+    SimHost::advanceMicros(1000);
+    servos.update();
+  }
+  uint8_t address, channel;
+  SimKeyMap::servoChannel(servo, address, channel);
+  return SimHost::pca9685(address)->changedMicros[channel] - since;
+}
+
+int main() {
+  static_assert(ANGLE_NOTE_ON == 20 && DEFAULT_HOVER_OFFSET == 0 && DEFAULT_RELEASE_OVERSHOOT == 0
+                && SERVO_MS_PER_DEGREE_X10 == 17 && SERVO_DECEL_ZONE_DEG == 8, "test written for the default settings.h");
+  ServoController servos;
+  homeServos(servos);
+
+  // Plain travel: 12° at full speed (20.4 ms) + 8° -> 1° in the slow zone (13.6 * ln 8 = 28.3 ms)
+  CHECK_EQUAL(48, servos.estimatePressMs(0));
+  CHECK_EQUAL(48, servos.estimateReleaseMs(0));
+
+  // Hover 12°, press 20°: only the last 8°, all in the slow zone; overshoot 6°: 6° fast + 8° -> 6°
+  servos.setMotionProfile(1, 12, 20, 6);
+  CHECK_EQUAL(28, servos.estimatePressMs(1));
+  CHECK_EQUAL(14, servos.estimateReleaseMs(1));
+  uint16_t saved = 2 * servos.estimatePressMs(0) - servos.estimatePressMs(1) - servos.estimateReleaseMs(1);
+  CHECK_EQUAL(54, saved);
+
+  // Out of range profiles are refused
+  servos.setMotionProfile(2, 20, 20, 0);
+  CHECK_EQUAL(48, servos.estimatePressMs(2));
+
+  // Servo 1 on the bus: press, overshoot, hover
+  int16_t rest = initialAngles[1];
+  int8_t direction = sensRot[1];
+  servos.noteOn(1);
+  servos.update();
+  CHECK_EQUAL(referenceTicks(rest - 20 * direction), channelWidth(1));
+  SimHost::advanceMicros(100000);
+  servos.update();
+  uint64_t released = SimHost::now();
+  servos.noteOff(1);
+  servos.update();
+  CHECK_EQUAL(referenceTicks(rest - (12 - 6) * direction), channelWidth(1));
+  uint64_t settle = microsUntilWidth(servos, 1, referenceTicks(rest - 12 * direction), released);
+  CHECK(settle >= RELEASE_OVERSHOOT_MS * 1000UL && settle < (RELEASE_OVERSHOOT_MS + 2) * 1000UL);
+
+  // Released 10 ms after the press: still down until MIN_NOTE_HOLD_MS
+  uint64_t pressedAt = SimHost::now();
+  servos.noteOn(3);
+  servos.update();
+  uint16_t pressed = channelWidth(3);
+  SimHost::advanceMicros(10000);
+  servos.update();
+  servos.noteOff(3);
+  servos.update();
+  CHECK_EQUAL(pressed, channelWidth(3));
+  uint64_t hold = microsUntilWidth(servos, 3, referenceTicks(initialAngles[3]), pressedAt);
+  CHECK(hold >= MIN_NOTE_HOLD_MS * 1000UL && hold < (MIN_NOTE_HOLD_MS + 2) * 1000UL);
+
+  std::cout << "press/release ms: plain " << servos.estimatePressMs(0) << "/" << servos.estimateReleaseMs(0)
+            << ", hover 12 + overshoot 6: " << servos.estimatePressMs(1) << "/" << servos.estimateReleaseMs(1)
+            << ", saved " << saved << " ms per note\n";
+  return simTestResult("test_motion_profile");
+}
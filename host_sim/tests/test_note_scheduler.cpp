@@ -0,0 +1,118 @@
+/***********************************************************************************************
+----------------------------    test_note_scheduler   ----------------------------------------
+************************************************************************************************
+
+NoteScheduler plein (mode délai fixe, accord plus grand que SCHEDULER_CAPACITY)
+- un relâchement refusé par la file annule l'appui encore en attente de la même touche (sa
+  place sert au relâchement suivant) : une fois la file vidée, aucune touche ne reste enfoncée
+- cancelPress() ne retire que le dernier événement de la touche, et seulement un appui :
+  un appui plus ancien garde son relâchement
+- l'ordre appui/relâchement d'une touche est conservé pour des instants égaux
+
+************************************************************************************************/
+#include "SimHost.h"
+#include "SimTest.h"
+#include "NoteScheduler.h"
+
+static const unsigned long FIRE_TIME = 1000;
+
+// Same rule as the instrument: an overflowing release cancels the pending press of its key
+static void release(NoteScheduler& scheduler, uint8_t servo, bool pressed[]) {
+  if (scheduler.schedule(FIRE_TIME, servo, 0)) {
+    return;
+  }
+  if (!scheduler.cancelPress(servo) && !scheduler.hasPending(servo)) {
+    pressed[servo] = false; // Nothing queued for this key: released at once
+  }
+}
+
+static void drain(NoteScheduler& scheduler, bool pressed[]) {
+  ScheduledNote event;
+  while (scheduler.popDue(FIRE_TIME, event)) {
+    pressed[event.servo] = event.velocity > 0;
+  }
+}
+
+static void chordLargerThanQueue() {
+  const uint8_t chord = SCHEDULER_CAPACITY - 6;
+  NoteScheduler scheduler;
+  bool pressed[NUMBER_OF_NOTES] = {false};
+
+  for (uint8_t servo = 0; servo < chord; servo++) {
+    CHECK(scheduler.schedule(FIRE_TIME, servo, 100));
+  }
+  for (uint8_t servo = 0; servo < chord; servo++) {
+    release(scheduler, servo, pressed);
+  }
+
+  // 6 releases fit, then every refused release frees the slot of its press for the next one
+  CHECK_EQUAL(SCHEDULER_CAPACITY, scheduler.size());
+  CHECK_EQUAL(2, scheduler.getOverflowCount());
+  CHECK(!scheduler.hasPending(6));
+  CHECK(scheduler.hasPending(7));
+  CHECK(!scheduler.hasPending(8));
+  CHECK(scheduler.hasPending(9));
+
+  drain(scheduler, pressed);
+  for (uint8_t servo = 0; servo < chord; servo++) {
+    CHECK(!pressed[servo]);
+  }
+  CHECK_EQUAL(0, scheduler.size());
+}
+
+static void queueFullOfPresses() {
+  NoteScheduler scheduler;
+  bool pressed[NUMBER_OF_NOTES] = {false};
+
+  for (uint8_t servo = 0; servo < SCHEDULER_CAPACITY; servo++) {
+    CHECK(scheduler.schedule(FIRE_TIME, servo, 100));
+  }
+  CHECK(!scheduler.schedule(FIRE_TIME, SCHEDULER_CAPACITY, 100));
+
+  // Refused and queued releases alternate: half the presses cancelled, the others released
+  for (uint8_t servo = 0; servo < SCHEDULER_CAPACITY; servo++) {
+    release(scheduler, servo, pressed);
+  }
+  CHECK_EQUAL(SCHEDULER_CAPACITY, scheduler.size());
+  CHECK_EQUAL(1 + SCHEDULER_CAPACITY / 2, scheduler.getOverflowCount());
+  drain(scheduler, pressed);
+  for (uint8_t servo = 0; servo < SCHEDULER_CAPACITY; servo++) {
+    CHECK(!pressed[servo]);
+  }
+}
+
+static void cancelOnlyTheLastPress() {
+  NoteScheduler scheduler;
+
+  // Press, release, press again: only the second press can be cancelled
+  CHECK(scheduler.schedule(FIRE_TIME, 3, 100));
+  CHECK(scheduler.schedule(FIRE_TIME, 3, 0));
+  CHECK(scheduler.schedule(FIRE_TIME, 3, 80));
+  CHECK(scheduler.schedule(FIRE_TIME, 4, 90));
+  CHECK(scheduler.cancelPress(3));
+  CHECK_EQUAL(3, scheduler.size());
+
+  // The last event of key 3 is now its release
+  CHECK(!scheduler.cancelPress(3));
+  CHECK(!scheduler.cancelPress(5));
+  CHECK(!scheduler.hasPending(5));
+  CHECK(scheduler.hasPending(3));
+
+  ScheduledNote event;
+  CHECK(scheduler.popDue(FIRE_TIME, event));
+  CHECK_EQUAL(3, event.servo);
+  CHECK_EQUAL(100, event.velocity);
+  CHECK(scheduler.popDue(FIRE_TIME, event));
+  CHECK_EQUAL(3, event.servo);
+  CHECK_EQUAL(0, event.velocity);
+  CHECK(scheduler.popDue(FIRE_TIME, event));
+  CHECK_EQUAL(4, event.servo);
+  CHECK(!scheduler.popDue(FIRE_TIME, event));
+}
+
+int main() {
+  chordLargerThanQueue();
+  queueFullOfPresses();
+  cancelOnlyTheLastPress();
+  return simTestResult("test_note_scheduler");
+}
@@ -0,0 +1,76 @@
+/***********************************************************************************************
+----------------------------    test_scheduler_overflow   ----------------------------------------
+************************************************************************************************
+
+Accord staccato après un silence, plus d'événements que SCHEDULER_CAPACITY :
+- les appuis attendent l'ouverture de l'air (AIR_ANTICIPATION_MS), les relâchements 5 ms plus
+  tard attendent aussi, la file déborde
+- aucun relâchement ne passe devant l'appui encore en attente de sa touche : toutes les
+  touches finissent au repos, la valve se ferme après AIR_HANG_MS
+- accords de 4 à 24 notes, réglages par défaut de settings.h
+
+************************************************************************************************/
+#include <iostream>
+#include "SimTest.h"
+#include "ServoRig.h"
+#include "instrument.h"
+
+static int airAngle() {
+  int angle = -1;
+  for (const SimHost::ServoWrite& w : SimHost::servoLog()) {
+    if (w.pin == AIR_SERVO_PIN) {
+      angle = w.angle;
+    }
+  }
+  return angle;
+}
+
+static void runMillis(Instrument& instrument, ServoController& servos, uint16_t ms) {
+  for (uint16_t i = 0; i < ms; i++) {
+    SimHost::advanceMicros(1000);
+    instrument.update();
+    servos.update();
+  }
+}
+
+static void staccatoChord(Instrument& instrument, ServoController& servos, uint8_t notes,
+                          const uint16_t restWidth[]) {
+  for (uint8_t i = 0; i < notes; i++) {
+    instrument.noteOn(FIRST_MIDI_NOTE + i, 100);
+  }
+  runMillis(instrument, servos, 5);
+  for (uint8_t i = 0; i < notes; i++) {
+    instrument.noteOff(FIRST_MIDI_NOTE + i);
+  }
+  runMillis(instrument, servos, 2000);
+
+  for (uint8_t servo = 0; servo < notes; servo++) {
+    if (channelWidth(servo) != restWidth[servo]) {
+      std::cerr << "chord of " << (int)notes << ": servo " << (int)servo << " left pressed\n";
+    }
+    CHECK_EQUAL(restWidth[servo], channelWidth(servo));
+  }
+  CHECK_EQUAL(AIR_CLOSED_ANGLE, airAngle());
+}
+
+int main() {
+  static_assert(SCHEDULER_CAPACITY == 16 && NOTE_FIXED_DELAY_MS == 0 && AIR_ANTICIPATION_MS > 5
+                && NUMBER_OF_NOTES >= 24, "test written for the default settings.h");
+  ServoController servos;
+  homeServos(servos);
+  Instrument instrument(servos, 0);
+  CHECK(instrument.begin());
+
+  uint16_t restWidth[NUMBER_OF_NOTES];
+  for (uint8_t servo = 0; servo < NUMBER_OF_NOTES; servo++) {
+    restWidth[servo] = channelWidth(servo);
+  }
+
+  // 4 notes fit the queue, 10 make it overflow on the releases, 24 on the presses too
+  const uint8_t chords[] = {4, 10, 16, 24, 10};
+  for (uint8_t chord : chords) {
+    staccatoChord(instrument, servos, chord, restWidth);
+  }
+
+  return simTestResult("test_scheduler_overflow");
+}
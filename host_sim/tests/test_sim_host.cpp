@@ -0,0 +1,84 @@
+/***********************************************************************************************
+----------------------------    test_sim_host   ----------------------------------------
+************************************************************************************************
+
+Les mocks sur lesquels reposent toutes les mesures de la simulation
+- Wire : durée d'une transaction = (START + 9 bits par octet + STOP) au débit du bus,
+  horloge virtuelle avancée d'autant, adresse sans carte = NACK sans octet de données
+- PCA9685 : setPWM() décodé dans les registres LEDn, auto-incrément, changement horodaté
+- EEPROM : update()/put() n'écrivent que les octets qui changent
+
+************************************************************************************************/
+#include "SimHost.h"
+#include "SimTest.h"
+#include <Adafruit_PWMServoDriver.h>
+#include <EEPROM.h>
+
+int main() {
+  SimHost::addPca9685(0x40);
+  Adafruit_PWMServoDriver pca(0x40);
+  pca.begin();
+  CHECK(SimHost::pca9685(0x40)->mode1 & MODE1_AI);
+  CHECK(SimHost::pca9685(0x41) == nullptr);
+
+  // One channel write: register + 4 bytes = 6 bytes with the address, 56 bits at 100 kHz
+  SimHost::clearBusLog();
+  uint64_t start = SimHost::now();
+  pca.setPWM(3, 100, 400);
+  CHECK_EQUAL(1, SimHost::busLog().size());
+  const SimHost::BusTransaction& write = SimHost::busLog()[0];
+  CHECK_EQUAL(0x40, write.address);
+  CHECK(write.acknowledged);
+  CHECK_EQUAL(5, write.length);
+  CHECK_EQUAL(PCA9685_LED0_ON_L + 4 * 3, write.data[0]);
+  CHECK_EQUAL(560, write.durationMicros);
+  CHECK_EQUAL(560, SimHost::busBusyMicros());
+  CHECK_EQUAL(start + 560, SimHost::now());
+  CHECK_EQUAL(100, SimHost::pca9685(0x40)->on[3]);
+  CHECK_EQUAL(400, SimHost::pca9685(0x40)->off[3]);
+  CHECK_EQUAL(start + 560, SimHost::pca9685(0x40)->changedMicros[3]);
+
+  // Same value again: on the bus, but no channel change
+  int changes = 0;
+  SimHost::onChannelChange([&](uint8_t, uint8_t, uint16_t, uint16_t) { changes++; });
+  pca.setPWM(3, 100, 400);
+  CHECK_EQUAL(0, changes);
+  pca.setPWM(4, 0, 300);
+  CHECK(changes > 0); // Once per register byte that changes
+  CHECK_EQUAL(300, SimHost::pca9685(0x40)->off[4]);
+
+  // Burst of two channels through auto-increment: 9 data bytes, 92 bits at 400 kHz
+  Wire.setClock(400000);
+  SimHost::clearBusLog();
+  Wire.beginTransmission(0x40);
+  Wire.write(PCA9685_LED0_ON_L + 4 * 5);
+  const uint8_t burst[8] = {0x10, 0x00, 0x20, 0x01, 0x00, 0x02, 0x30, 0x03};
+  Wire.write(burst, sizeof(burst));
+  CHECK_EQUAL(0, Wire.endTransmission());
+  CHECK_EQUAL(9, SimHost::busLog()[0].length);
+  CHECK_EQUAL(230, SimHost::busLog()[0].durationMicros);
+  CHECK_EQUAL(0x10, SimHost::pca9685(0x40)->on[5]);
+  CHECK_EQUAL(0x120, SimHost::pca9685(0x40)->off[5]);
+  CHECK_EQUAL(0x200, SimHost::pca9685(0x40)->on[6]);
+  CHECK_EQUAL(0x330, SimHost::pca9685(0x40)->off[6]);
+
+  // No board: NACK after the address byte, 11 bits
+  Wire.beginTransmission(0x41);
+  Wire.write(0x06);
+  CHECK_EQUAL(2, Wire.endTransmission());
+  CHECK(!SimHost::busLog()[1].acknowledged);
+  CHECK_EQUAL(0, SimHost::busLog()[1].length);
+  CHECK_EQUAL(28, SimHost::busLog()[1].durationMicros);
+  Wire.setClock(100000);
+
+  // EEPROM: erased, put() of equal bytes is free
+  CHECK_EQUAL(0xFF, EEPROM.read(100));
+  uint16_t value = 0x12FF;
+  EEPROM.put(100, value);
+  CHECK_EQUAL(1, SimHost::eepromWrites());
+  EEPROM.put(100, value);
+  CHECK_EQUAL(1, SimHost::eepromWrites());
+  CHECK_EQUAL(0x12, SimHost::eeprom()[101]);
+
+  return simTestResult("test_sim_host");
+}
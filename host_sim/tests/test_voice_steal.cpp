@@ -0,0 +1,90 @@
+/***********************************************************************************************
+----------------------------    test_voice_steal   ----------------------------------------
+************************************************************************************************
+
+Vol de voix par le budget de courant (VOICE_STEAL_MODE 1) :
+- 12 touches en mouvement tiennent dans 8000 mA (12 x 650), la 13e vole la plus ancienne
+- la touche volée remonte dans la même trame que l'appui de la nouvelle, même appuyée il y a
+  moins de MIN_NOTE_HOLD_MS : son courant est déjà rendu au budget
+- un relâchement normal garde MIN_NOTE_HOLD_MS
+- un bourdon tenu plus de 65,5 s reste la voix la plus ancienne (âge sur 32 bits)
+
+************************************************************************************************/
+#include <iostream>
+#include "SimTest.h"
+#include "ServoRig.h"
+#include "instrument.h"
+
+static uint8_t pressedKeys() {
+  uint8_t pressed = 0;
+  for (uint8_t s = 0; s < NUMBER_OF_NOTES; s++) {
+    if (channelWidth(s) == referenceTicks(initialAngles[s] - ANGLE_NOTE_ON * sensRot[s])) {
+      pressed++;
+    }
+  }
+  return pressed;
+}
+
+static void runMillis(Instrument& instrument, ServoController& servos, uint16_t ms) {
+  for (uint16_t i = 0; i < ms; i++) {
+    SimHost::advanceMicros(1000);
+    instrument.update();
+    servos.update();
+  }
+}
+
+// Allocator alone, small budget: hold + hold + move > 1000 mA, the third key needs a steal
+static void droneStaysOldest() {
+  VoiceAllocator voices(1000);
+  CHECK_EQUAL(VOICE_ADMITTED, voices.allocate(0, 100, 100, 1000));     // Drone
+  CHECK_EQUAL(VOICE_ADMITTED, voices.allocate(1, 100, 100, 60000));
+  // 70 s later the drone is still the oldest, though its age no longer fits 16 bits
+  CHECK_EQUAL(0, voices.allocate(2, 100, 100, 71000));
+  voices.release(0);
+  CHECK_EQUAL(VOICE_ADMITTED, voices.allocate(2, 100, 100, 71000));
+  CHECK_EQUAL(1, voices.allocate(3, 100, 100, 71000 + 65536 + 50));
+}
+
+int main() {
+  droneStaysOldest();
+
+  static_assert(POWER_BUDGET_MA == 8000 && SERVO_MOVE_MA == 650 && VOICE_STEAL_MODE == 1
+                && INSTRUMENT_COUNT == 1 && DEFAULT_HOVER_OFFSET == 0, "test written for the default settings.h");
+  ServoController servos;
+  homeServos(servos);
+  Instrument instrument(servos, 0);
+  CHECK(instrument.begin());
+
+  // 13 notes at once: all fire together once the air is open
+  for (uint8_t k = 0; k < 13; k++) {
+    instrument.noteOn(FIRST_MIDI_NOTE + k, 100);
+  }
+  uint16_t waited = 0;
+  while (instrument.getVoiceStats().admittedNotes < 13 && waited < 500) {
+    runMillis(instrument, servos, 1);
+    waited++;
+  }
+  CHECK_EQUAL(13, instrument.getVoiceStats().admittedNotes);
+  CHECK_EQUAL(1, instrument.getVoiceStats().stolenNotes);
+  // Stolen key already back up, not held until MIN_NOTE_HOLD_MS
+  CHECK_EQUAL(12, pressedKeys());
+  runMillis(instrument, servos, MIN_NOTE_HOLD_MS + 10);
+  CHECK_EQUAL(12, pressedKeys());
+
+  // Ordinary release: at once when held long enough, else when MIN_NOTE_HOLD_MS is up
+  instrument.noteOff(FIRST_MIDI_NOTE + 12);
+  runMillis(instrument, servos, 1);
+  CHECK_EQUAL(11, pressedKeys());
+  instrument.noteOn(FIRST_MIDI_NOTE + 12, 100);
+  runMillis(instrument, servos, 1);
+  CHECK_EQUAL(12, pressedKeys());
+  instrument.noteOff(FIRST_MIDI_NOTE + 12);
+  runMillis(instrument, servos, MIN_NOTE_HOLD_MS / 2);
+  CHECK_EQUAL(12, pressedKeys());
+  runMillis(instrument, servos, MIN_NOTE_HOLD_MS);
+  CHECK_EQUAL(11, pressedKeys());
+
+  std::cout << "voice steal: " << (int)pressedKeys() << " keys pressed, "
+            << instrument.getVoiceStats().stolenNotes << " stolen" << std::endl;
+  return simTestResult("test_voice_steal");
+}